@@ -0,0 +1,75 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measures the time to encode one AAC frame of 1024 samples from L16, L20 and L24 at a range
+// of channel counts, which includes the conversion of the samples to planar float.
+//   node bench/aacEncode.js [numFrames]
+
+const codecadon = require('../index.js');
+
+const frameSamples = 1024;
+const sampleRate = 48000;
+const numFrames = +process.argv[2] || 5000;
+const numWarmup = 100;
+const logLevel = 1;
+
+function makeSrcBuf(encodingName, channels) {
+  let bytesPerSample = (+encodingName.slice(1) + 7) >> 3;
+  let buf = Buffer.alloc(frameSamples * channels * bytesPerSample);
+  for (let i = 0; i < buf.length; ++i)
+    buf[i] = (i * 7919) & 0xff;
+  return buf;
+}
+
+function run(encodingName, channels) {
+  return new Promise((resolve, reject) => {
+    let encoder = new codecadon.Encoder(() => {});
+    let srcTags = { format: 'audio', encodingName: encodingName, clockRate: sampleRate, channels: channels };
+    let dstTags = { format: 'audio', encodingName: 'AAC', clockRate: sampleRate, channels: channels };
+    let duration = Buffer.alloc(8);
+    duration.writeUIntBE(frameSamples, 0, 4);
+    duration.writeUIntBE(sampleRate, 4, 4);
+    let dstBufLen = encoder.setInfo(srcTags, dstTags, duration, { bitrate: 64000 * channels }, logLevel);
+
+    let srcBuf = makeSrcBuf(encodingName, channels);
+    let dstBuf = Buffer.alloc(dstBufLen);
+    let done = 0;
+    let start;
+    let doFrame = () => {
+      encoder.encode([srcBuf], dstBuf, err => {
+        if (err) return reject(err);
+        if (++done === numWarmup)
+          start = process.hrtime();
+        if (done === numWarmup + numFrames) {
+          let t = process.hrtime(start);
+          let usPerFrame = (t[0] * 1e6 + t[1] / 1e3) / numFrames;
+          encoder.quit(() => resolve({ name: `${encodingName} x${channels}`, usPerFrame: usPerFrame }));
+        } else
+          doFrame();
+      });
+    };
+    doFrame();
+  });
+}
+
+async function main() {
+  for (let encodingName of [ 'L16', 'L20', 'L24' ])
+    for (let channels of [ 1, 2, 6 ]) {
+      let result = await run(encodingName, channels);
+      console.log(`${result.name.padEnd(8)} ${result.usPerFrame.toFixed(1)} us per frame`);
+    }
+}
+
+main().catch(err => console.error(err));
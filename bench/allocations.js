@@ -0,0 +1,87 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Counts the new blocks the slab allocator and callback recycling make on the frame submission
+// path - process data, work params, shared pointer control blocks and frame callbacks - which
+// should be near zero once warm. Allocations made elsewhere, for example by V8, are not counted.
+//   node bench/allocations.js [numFrames]
+
+const codecadon = require('../index.js');
+
+const width = 1280;
+const height = 720;
+const numFrames = +process.argv[2] || 1000;
+const numWarmup = 50;
+const logLevel = 1;
+
+function makeTags(packing) {
+  return { format: 'video', width: width, height: height, packing: packing, interlace: 0 };
+}
+
+function newAllocs(processor) {
+  let allocs = processor.stats().allocs;
+  return allocs.slabNew + allocs.callbacksNew;
+}
+
+// a few frames in flight at once, as in a pipeline
+function run(name, processor, fn) {
+  const inFlight = 4;
+  return new Promise((resolve, reject) => {
+    let submitted = 0;
+    let done = 0;
+    let warmAllocs = 0;
+    let doFrame = () => {
+      fn(submitted++, err => {
+        if (err) return reject(err);
+        if (++done === numWarmup)
+          warmAllocs = newAllocs(processor);
+        if (done === numWarmup + numFrames) {
+          let perFrame = (newAllocs(processor) - warmAllocs) / numFrames;
+          processor.quit(() => resolve({ name: name, perFrame: perFrame }));
+        } else if (submitted < numWarmup + numFrames)
+          doFrame();
+      });
+    };
+    for (let i = 0; i < inFlight; ++i)
+      doFrame();
+  });
+}
+
+function benchPacker() {
+  let packer = new codecadon.Packer(() => {});
+  packer.setInfo(makeTags('pgroup'), makeTags('420P'), logLevel);
+  let srcBuf = codecadon.allocFrame('pgroup', width, height);
+  let dstBufs = [0, 1, 2, 3].map(() => codecadon.allocFrame('420P', width, height));
+  return run('Packer pgroup->420P', packer,
+    (n, cb) => packer.pack([srcBuf], dstBufs[n % 4], cb));
+}
+
+function benchStamper() {
+  let stamper = new codecadon.Stamper(() => {});
+  stamper.setInfo(makeTags('YUV422P10'), makeTags('YUV422P10'), logLevel);
+  let srcBufs = [ codecadon.allocFrame('YUV422P10', width, height), codecadon.allocFrame('YUV422P10', width, height) ];
+  let dstBufs = [0, 1, 2, 3].map(() => codecadon.allocFrame('YUV422P10', width, height));
+  return run('Stamper mix YUV422P10', stamper,
+    (n, cb) => stamper.mix(srcBufs, dstBufs[n % 4], { pressure: 0.5 }, cb));
+}
+
+async function main() {
+  for (let bench of [ benchPacker, benchStamper ]) {
+    let result = await bench();
+    console.log(`${result.name.padEnd(24)} ${result.perFrame.toFixed(3)} new slab and callback allocations per frame`);
+  }
+}
+
+main().catch(err => console.error(err));
@@ -0,0 +1,89 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measures Packer and Stamper throughput at 2160p with frame buffers allocated
+// from the heap, transparent huge pages and explicit (hugetlbfs) huge pages.
+// Explicit huge pages need a reserved pool, e.g. echo 512 > /proc/sys/vm/nr_hugepages
+//   node bench/hugePages.js [numFrames]
+
+const codecadon = require('../index.js');
+
+const width = 3840;
+const height = 2160;
+const numFrames = +process.argv[2] || 200;
+const logLevel = 1;
+
+function makeTags(packing) {
+  return { format: 'video', width: width, height: height, packing: packing, interlace: 0 };
+}
+
+// a ring of buffers so that each frame touches memory that is not cache resident
+function allocRing(format, count) {
+  let bufs = [];
+  for (let i = 0; i < count; ++i)
+    bufs.push(codecadon.allocFrame(format, width, height));
+  return bufs;
+}
+
+function run(name, processor, fn) {
+  return new Promise((resolve, reject) => {
+    let done = 0;
+    let start = process.hrtime();
+    let doFrame = n => {
+      fn(n, err => {
+        if (err) return reject(err);
+        if (++done === numFrames) {
+          let t = process.hrtime(start);
+          let secs = t[0] + t[1] / 1e9;
+          processor.quit(() => resolve({ name: name, fps: numFrames / secs }));
+        } else
+          doFrame(done);
+      });
+    };
+    doFrame(0);
+  });
+}
+
+function benchPacker() {
+  let packer = new codecadon.Packer(() => {});
+  packer.setInfo(makeTags('pgroup'), makeTags('420P'), logLevel);
+  let srcBufs = allocRing('pgroup', 4);
+  let dstBufs = allocRing('420P', 4);
+  return run('Packer pgroup->420P', packer,
+    (n, cb) => packer.pack([srcBufs[n % 4]], dstBufs[n % 4], cb));
+}
+
+function benchStamper() {
+  let stamper = new codecadon.Stamper(() => {});
+  stamper.setInfo(makeTags('YUV422P10'), makeTags('YUV422P10'), logLevel);
+  let srcBufsA = allocRing('YUV422P10', 4);
+  let srcBufsB = allocRing('YUV422P10', 4);
+  let dstBufs = allocRing('YUV422P10', 4);
+  return run('Stamper mix YUV422P10', stamper,
+    (n, cb) => stamper.mix([srcBufsA[n % 4], srcBufsB[n % 4]], dstBufs[n % 4], { pressure: 0.5 }, cb));
+}
+
+async function main() {
+  for (let mode of [ 'off', 'transparent', 'explicit' ]) {
+    codecadon.setHugePages(mode);
+    for (let bench of [ benchPacker, benchStamper ]) {
+      let result = await bench();
+      console.log(`${mode.padEnd(12)} ${result.name.padEnd(24)} ${result.fps.toFixed(1)} fps`);
+    }
+    console.log(`${mode.padEnd(12)} allocations ${JSON.stringify(codecadon.framePoolStats().hugePages)}`);
+  }
+}
+
+main().catch(err => console.error(err));
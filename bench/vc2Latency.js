@@ -0,0 +1,106 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Measures the latency of VC-2 encode and decode at 1080p50, from submitting each frame to its
+// callback, with one frame in flight at a time. Each should finish within the 20ms frame period.
+//   node bench/vc2Latency.js [numFrames] [threads]
+
+const codecadon = require('../index.js');
+
+const width = 1920;
+const height = 1080;
+const numFrames = +process.argv[2] || 250;
+const threads = +process.argv[3] || 0;
+const framePeriodMs = 1000 / 50;
+const logLevel = 1;
+
+const duration = Buffer.alloc(8);
+duration.writeUIntBE(1, 0, 4);
+duration.writeUIntBE(50, 4, 4);
+
+function makeTags(packing, encodingName) {
+  return { format: 'video', width: width, height: height, packing: packing, encodingName: encodingName, interlace: 0 };
+}
+
+// a luma ramp with flat chroma, so that each picture has detail to code
+function makeYUV422P10Buf() {
+  let buf = codecadon.allocFrame('YUV422P10', width, height);
+  let lumaBytes = width * height * 2;
+  for (let y = 0; y < height; ++y)
+    for (let x = 0; x < width; ++x)
+      buf.writeUInt16LE(64 + ((x + y) % 876), (y * width + x) * 2);
+  for (let off = lumaBytes; off < buf.length; off += 2)
+    buf.writeUInt16LE(512, off);
+  return buf;
+}
+
+// runs fn for each frame in turn, collecting the time from each call to its callback
+function run(processor, fn) {
+  return new Promise((resolve, reject) => {
+    let latencies = [];
+    let results = [];
+    let doFrame = n => {
+      let start = process.hrtime();
+      fn(n, (err, result) => {
+        if (err) return reject(err);
+        let t = process.hrtime(start);
+        latencies.push(t[0] * 1e3 + t[1] / 1e6);
+        results.push(result);
+        if (latencies.length === numFrames)
+          processor.quit(() => resolve({ latencies: latencies, results: results }));
+        else
+          doFrame(n + 1);
+      });
+    };
+    doFrame(0);
+  });
+}
+
+function report(name, latencies) {
+  let sorted = latencies.slice().sort((a, b) => a - b);
+  let mean = sorted.reduce((s, l) => s + l, 0) / sorted.length;
+  let p99 = sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * 0.99))];
+  let max = sorted[sorted.length - 1];
+  console.log(`${name.padEnd(8)} mean ${mean.toFixed(2)}ms  p99 ${p99.toFixed(2)}ms  max ${max.toFixed(2)}ms  ` +
+              `${(max < framePeriodMs) ? 'within' : 'OVER'} the ${framePeriodMs}ms frame period`);
+  return max < framePeriodMs;
+}
+
+async function main() {
+  let encodeTags = { bitrate: 500000000 };
+  if (threads) encodeTags.threads = threads;
+
+  let encoder = new codecadon.Encoder(() => {});
+  encoder.on('error', err => console.error(err));
+  let dstBufLen = encoder.setInfo(makeTags('YUV422P10', 'raw'), makeTags('vc2', 'vc2'), duration, encodeTags, logLevel);
+  let srcBuf = makeYUV422P10Buf();
+  // frames are encoded in turn, so the packet is copied out before its buffer is used again
+  let dstBuf = Buffer.alloc(dstBufLen);
+  let encoded = await run(encoder,
+    (n, cb) => encoder.encode([srcBuf], dstBuf, (err, packet) => cb(err, packet ? Buffer.from(packet) : null)));
+  let encodeOK = report('encode', encoded.latencies);
+
+  let decoder = new codecadon.Decoder(() => {});
+  decoder.on('error', err => console.error(err));
+  decoder.setInfo(makeTags('vc2', 'vc2'), makeTags('YUV422P10', 'raw'), logLevel);
+  let pictureBuf = codecadon.allocFrame('YUV422P10', width, height);
+  let decoded = await run(decoder,
+    (n, cb) => decoder.decode([encoded.results[n]], pictureBuf, cb));
+  let decodeOK = report('decode', decoded.latencies);
+
+  process.exitCode = (encodeOK && decodeOK) ? 0 : 1;
+}
+
+main().catch(err => { console.error(err); process.exitCode = 1; });
@@ -9,11 +9,16 @@
                    "src/ScaleConverter.cc",
                    "src/Decoder.cc",
                    "src/Encoder.cc",
+                   "src/AbrEncoder.cc",
                    "src/Stamper.cc",
                    "src/ScaleConverterFF.cc",
                    "src/DecoderFF.cc",
                    "src/EncoderFF.cc",
-                   "src/Packers.cc" ],
+                   "src/EncoderVC2.cc",
+                   "src/DecoderVC2.cc",
+                   "src/Packers.cc",
+                   "src/TaskScheduler.cc",
+                   "src/BufferPool.cc" ],
       "include_dirs": [ "<!(node -e \"require('nan')\")", "ffmpeg/include" ],
       'conditions': [
         ['OS=="linux"', {
@@ -34,7 +39,8 @@
                     "<@(module_root_dir)/build/Release/libavutil.so.55",
                     "<@(module_root_dir)/build/Release/libswscale.so.4",
                     "<@(module_root_dir)/build/Release/libopenh264.so.3",
-                    "<@(module_root_dir)/build/Release/libvpx.so.4"
+                    "<@(module_root_dir)/build/Release/libvpx.so.4",
+                    "-ldl"
                   ],
                   "ldflags": [
                     "-L<@(module_root_dir)/build/Release",
@@ -72,7 +78,8 @@
                    "<@(module_root_dir)/build/Release/libavutil.so.55",
                    "<@(module_root_dir)/build/Release/libswscale.so.4",
                    "<@(module_root_dir)/build/Release/libopenh264.so.1",
-                   "<@(module_root_dir)/build/Release/libvpx.so.3"
+                   "<@(module_root_dir)/build/Release/libvpx.so.3",
+                   "-ldl"
                  ],
                  "ldflags": [
                    "-L<@(module_root_dir)/build/Release",
@@ -156,6 +163,42 @@
           ]
         }]
       ],
+    },
+    {
+      "target_name": "testDriver",
+      "type": "loadable_module",
+      "sources": [ "test/driver/testDriver.cc" ],
+      "include_dirs": [ "<!(node -e \"require('nan')\")", "ffmpeg/include", "src" ],
+      "defines": [
+        "__STDC_CONSTANT_MACROS"
+      ],
+      "cflags_cc!": [
+        "-fno-rtti",
+        "-fno-exceptions"
+      ],
+      "cflags_cc": [
+        "-std=c++11",
+        "-fexceptions"
+      ],
+      "xcode_settings": {
+        "GCC_ENABLE_CPP_RTTI": "YES",
+        "MACOSX_DEPLOYMENT_TARGET": "10.7",
+        "OTHER_CPLUSPLUSFLAGS": [
+          "-std=c++11",
+          "-stdlib=libc++",
+          "-fexceptions"
+        ]
+      },
+      "configurations": {
+        "Release": {
+          "msvs_settings": {
+            "VCCLCompilerTool": {
+              "RuntimeTypeInfo": "true",
+              "ExceptionHandling": 1
+            }
+          }
+        }
+      }
     }
   ]
 }
@@ -22,8 +22,10 @@ SegfaultHandler.registerHandler('crash.log');
 const util = require('util');
 const EventEmitter = require('events');
 
-function Concater(cb) {
+function Concater(cb, workerOpts) {
   this.concaterAdon = new codecAdon.Concater(cb);
+  if (typeof workerOpts === 'object')
+    this.concaterAdon.setWorkerOptions(workerOpts);
   EventEmitter.call(this);
 }
 
@@ -50,6 +52,18 @@ Concater.prototype.concat = function(srcBufArray, dstBuf, cb) {
   }
 };
 
+Concater.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.concaterAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+Concater.prototype.stats = function() {
+  return this.concaterAdon.stats();
+};
+
 Concater.prototype.quit = function(cb) {
   try {
     this.concaterAdon.quit((err, resultBytes) => {
@@ -61,8 +75,10 @@ Concater.prototype.quit = function(cb) {
 };
 
 
-function Flipper(cb) {
+function Flipper(cb, workerOpts) {
   this.flipperAdon = new codecAdon.Flipper(cb);
+  if (typeof workerOpts === 'object')
+    this.flipperAdon.setWorkerOptions(workerOpts);
   EventEmitter.call(this);
 }
 
@@ -89,6 +105,18 @@ Flipper.prototype.flip = function(srcBufArray, dstBuf, cb) {
   }
 };
 
+Flipper.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.flipperAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+Flipper.prototype.stats = function() {
+  return this.flipperAdon.stats();
+};
+
 Flipper.prototype.quit = function(cb) {
   try {
     this.flipperAdon.quit((err, resultBytes) => {
@@ -100,8 +128,10 @@ Flipper.prototype.quit = function(cb) {
 };
 
 
-function Packer(cb) {
+function Packer(cb, workerOpts) {
   this.packerAdon = new codecAdon.Packer(cb);
+  if (typeof workerOpts === 'object')
+    this.packerAdon.setWorkerOptions(workerOpts);
   EventEmitter.call(this);
 }
 
@@ -128,6 +158,18 @@ Packer.prototype.pack = function(srcBufArray, dstBuf, cb) {
   }
 };
 
+Packer.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.packerAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+Packer.prototype.stats = function() {
+  return this.packerAdon.stats();
+};
+
 Packer.prototype.quit = function(cb) {
   try {
     this.packerAdon.quit((err, resultBytes) => {
@@ -139,8 +181,10 @@ Packer.prototype.quit = function(cb) {
 };
 
 
-function ScaleConverter(cb) {
+function ScaleConverter(cb, workerOpts) {
   this.scaleConverterAdon = new codecAdon.ScaleConverter(cb);
+  if (typeof workerOpts === 'object')
+    this.scaleConverterAdon.setWorkerOptions(workerOpts);
   EventEmitter.call(this);
 }
 
@@ -171,6 +215,18 @@ ScaleConverter.prototype.scaleConvert = function(srcBufArray, dstBuf, cb) {
   }
 };
 
+ScaleConverter.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.scaleConverterAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+ScaleConverter.prototype.stats = function() {
+  return this.scaleConverterAdon.stats();
+};
+
 ScaleConverter.prototype.quit = function(cb) {
   try {
     this.scaleConverterAdon.quit((err, resultBytes) => {
@@ -182,8 +238,10 @@ ScaleConverter.prototype.quit = function(cb) {
 };
 
 
-function Decoder (cb) {
+function Decoder (cb, workerOpts) {
   this.decoderAdon = new codecAdon.Decoder(cb);
+  if (typeof workerOpts === 'object')
+    this.decoderAdon.setWorkerOptions(workerOpts);
   EventEmitter.call(this);
 }
 
@@ -201,8 +259,20 @@ Decoder.prototype.setInfo = function(srcTags, dstTags, logLevel) {
 
 Decoder.prototype.decode = function(srcBufArray, dstBuf, cb) {
   try {
-    var numQueued = this.decoderAdon.decode(srcBufArray, dstBuf, (err, resultBytes) => {
-      cb(err, resultBytes?dstBuf.slice(0,resultBytes):null);
+    var numQueued = this.decoderAdon.decode(srcBufArray, dstBuf, (err, resultBytes, frameBufs) => {
+      let pictures = (resultBytes?[dstBuf.slice(0,resultBytes)]:[]).concat(frameBufs?frameBufs:[]);
+      cb(err, pictures.length?pictures[0]:null, pictures);
+    });
+    return numQueued;
+  } catch (err) {
+    cb(err);
+  }
+};
+
+Decoder.prototype.flush = function(cb) {
+  try {
+    var numQueued = this.decoderAdon.flush((err, resultBytes, frameBufs) => {
+      cb(err, frameBufs?frameBufs:[]);
     });
     return numQueued;
   } catch (err) {
@@ -210,6 +280,18 @@ Decoder.prototype.decode = function(srcBufArray, dstBuf, cb) {
   }
 };
 
+Decoder.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.decoderAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+Decoder.prototype.stats = function() {
+  return this.decoderAdon.stats();
+};
+
 Decoder.prototype.quit = function(cb) {
   try {
     this.decoderAdon.quit((err, resultBytes) => {
@@ -221,8 +303,10 @@ Decoder.prototype.quit = function(cb) {
 };
 
 
-function Encoder (cb) {
+function Encoder (cb, workerOpts) {
   this.encoderAdon = new codecAdon.Encoder(cb);
+  if (typeof workerOpts === 'object')
+    this.encoderAdon.setWorkerOptions(workerOpts);
   EventEmitter.call(this);
 }
 
@@ -231,6 +315,8 @@ util.inherits(Encoder, EventEmitter);
 Encoder.prototype.setInfo = function(srcTags, dstTags, duration, encodeTags, logLevel) {
   let debugLevel = (typeof logLevel === 'number')?logLevel:3;
   try {
+    this.gopOutput = (typeof encodeTags === 'object') && (encodeTags.output === 'gop');
+    this.externalOutput = (typeof encodeTags === 'object') && (encodeTags.output === 'external');
     return this.encoderAdon.setInfo(srcTags, dstTags, duration, encodeTags, debugLevel);
   } catch (err) {
     this.emit('error', err);
@@ -238,10 +324,41 @@ Encoder.prototype.setInfo = function(srcTags, dstTags, duration, encodeTags, log
   }
 };
 
+// the destination buffer is not used with external output, and may be null
+const noDstBuf = Buffer.alloc(0);
+
 Encoder.prototype.encode = function(srcBufArray, dstBuf, cb) {
   try {
-    var numQueued = this.encoderAdon.encode(srcBufArray, dstBuf, (err, resultBytes) => {
-      cb(err, resultBytes?dstBuf.slice(0,resultBytes):null);
+    if (this.externalOutput)
+      dstBuf = noDstBuf;
+    var numQueued = this.encoderAdon.encode(srcBufArray, dstBuf, (err, resultBytes, resultBufs, packetInfos) => {
+      if (this.gopOutput)
+        return cb(err, resultBufs?resultBufs:[], packetInfos?packetInfos:[]);
+      let packets = (resultBytes?[dstBuf.slice(0,resultBytes)]:[]).concat(resultBufs?resultBufs:[]);
+      packetInfos = packetInfos?packetInfos:[];
+      cb(err, packets.length?packets[0]:null, packetInfos.length?packetInfos[0]:null, packets, packetInfos);
+    });
+    return numQueued;
+  } catch (err) {
+    cb(err);
+  }
+};
+
+Encoder.prototype.flush = function(cb) {
+  try {
+    var numQueued = this.encoderAdon.flush((err, resultBytes, packets, packetInfos) => {
+      cb(err, packets?packets:[], packetInfos?packetInfos:[]);
+    });
+    return numQueued;
+  } catch (err) {
+    cb(err);
+  }
+};
+
+Encoder.prototype.reconfigure = function(encodeTags, cb) {
+  try {
+    var numQueued = this.encoderAdon.reconfigure(encodeTags, (err, resultBytes, packets, packetInfos) => {
+      cb(err, packets?packets:[], packetInfos?packetInfos:[]);
     });
     return numQueued;
   } catch (err) {
@@ -249,6 +366,22 @@ Encoder.prototype.encode = function(srcBufArray, dstBuf, cb) {
   }
 };
 
+Encoder.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.encoderAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+Encoder.prototype.stats = function() {
+  return this.encoderAdon.stats();
+};
+
+Encoder.prototype.firstPassStats = function() {
+  return this.encoderAdon.firstPassStats();
+};
+
 Encoder.prototype.quit = function(cb) {
   try {
     this.encoderAdon.quit((err, resultBytes) => {
@@ -260,8 +393,78 @@ Encoder.prototype.quit = function(cb) {
 };
 
 
-function Stamper(cb) {
+// Encodes each source frame at every rendition of an ABR ladder. Renditions are destination
+// tags with their encode parameters, for example { width: 640, height: 360, encodingName: 'h264', bitrate: 800000 },
+// and encodeTags gives defaults for parameters not set on a rendition.
+function AbrEncoder (cb, workerOpts) {
+  this.abrEncoderAdon = new codecAdon.AbrEncoder(cb);
+  if (typeof workerOpts === 'object')
+    this.abrEncoderAdon.setWorkerOptions(workerOpts);
+  EventEmitter.call(this);
+}
+
+util.inherits(AbrEncoder, EventEmitter);
+
+AbrEncoder.prototype.setInfo = function(srcTags, renditions, duration, encodeTags, logLevel) {
+  let debugLevel = (typeof logLevel === 'number')?logLevel:3;
+  try {
+    let renditionTags = renditions.map(r => Object.assign({ format: 'video' }, encodeTags, r));
+    return this.abrEncoderAdon.setInfo(srcTags, renditionTags, duration, debugLevel);
+  } catch (err) {
+    this.emit('error', err);
+    return 0;
+  }
+};
+
+AbrEncoder.prototype.encode = function(srcBufArray, cb) {
+  try {
+    var numQueued = this.abrEncoderAdon.encode(srcBufArray, (err, resultBytes, packets, packetInfos) => {
+      cb(err, packets?packets:[], packetInfos?packetInfos:[]);
+    });
+    return numQueued;
+  } catch (err) {
+    cb(err);
+  }
+};
+
+AbrEncoder.prototype.flush = function(cb) {
+  try {
+    var numQueued = this.abrEncoderAdon.flush((err, resultBytes, packets, packetInfos) => {
+      cb(err, packets?packets:[], packetInfos?packetInfos:[]);
+    });
+    return numQueued;
+  } catch (err) {
+    cb(err);
+  }
+};
+
+AbrEncoder.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.abrEncoderAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+AbrEncoder.prototype.stats = function() {
+  return this.abrEncoderAdon.stats();
+};
+
+AbrEncoder.prototype.quit = function(cb) {
+  try {
+    this.abrEncoderAdon.quit((err, resultBytes) => {
+      cb(err, resultBytes);
+    });
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+
+function Stamper(cb, workerOpts) {
   this.stamperAdon = new codecAdon.Stamper(cb);
+  if (typeof workerOpts === 'object')
+    this.stamperAdon.setWorkerOptions(workerOpts);
   EventEmitter.call(this);
 }
 
@@ -327,6 +530,18 @@ Stamper.prototype.stamp = function(srcBufArray, dstBuf, paramTags, cb) {
   }
 };
 
+Stamper.prototype.setWorkerOptions = function(workerOpts) {
+  try {
+    this.stamperAdon.setWorkerOptions(workerOpts);
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+Stamper.prototype.stats = function() {
+  return this.stamperAdon.stats();
+};
+
 Stamper.prototype.quit = function(cb) {
   try {
     this.stamperAdon.quit((err, resultBytes) => {
@@ -338,14 +553,66 @@ Stamper.prototype.quit = function(cb) {
 };
 
 
+// Pre-allocated destination buffers for one frame format. Buffers return to the pool
+// when released or, if not released, when they are garbage collected.
+function BufferPool(format, width, height, count, hasAlpha) {
+  this.bufferPoolAdon = new codecAdon.BufferPool(format, width, height, count, !!hasAlpha);
+}
+
+BufferPool.prototype.acquire = function() {
+  return this.bufferPoolAdon.acquire();
+};
+
+BufferPool.prototype.release = function(buf) {
+  this.bufferPoolAdon.release(buf);
+};
+
+BufferPool.prototype.stats = function() {
+  return this.bufferPoolAdon.stats();
+};
+
+
+// Shared pool of threads used by all functions to process slices of a frame in parallel.
+// Emits 'scale' events when autoscaling changes the number of active threads.
+function Scheduler() {
+  EventEmitter.call(this);
+}
+
+util.inherits(Scheduler, EventEmitter);
+
+Scheduler.prototype.setAutoscale = function(autoscaleOpts) {
+  try {
+    codecAdon.setAutoscale(autoscaleOpts, (evt) => this.emit('scale', evt));
+  } catch (err) {
+    this.emit('error', err);
+  }
+};
+
+Scheduler.prototype.stats = function() {
+  return codecAdon.schedulerStats();
+};
+
+
 var codecadon = {
+  scheduler : new Scheduler(),
+  framePoolStats : codecAdon.framePoolStats,
+  allocFrame : codecAdon.allocFrame,
+  setHugePages : codecAdon.setHugePages,
+  setMemoryBudget : codecAdon.setMemoryBudget,
+  memoryStats : codecAdon.memoryStats,
+  loadDriver : codecAdon.loadDriver,
+  drivers : codecAdon.drivers,
+  prewarm : codecAdon.prewarm,
+  contextPoolStats : codecAdon.contextPoolStats,
   Concater : Concater,
   Flipper : Flipper,
   Packer : Packer,
   ScaleConverter : ScaleConverter,
   Decoder : Decoder,
   Encoder : Encoder,
-  Stamper : Stamper
+  AbrEncoder : AbrEncoder,
+  Stamper : Stamper,
+  BufferPool : BufferPool
 };
 
 module.exports = codecadon;
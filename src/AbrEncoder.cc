@@ -0,0 +1,422 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <nan.h>
+#include "AbrEncoder.h"
+#include "Encoder.h"
+#include "MyWorker.h"
+#include "Timer.h"
+#include "Packers.h"
+#include "Memory.h"
+#include "FramePool.h"
+#include "Primitives.h"
+#include "ScaleConverterFF.h"
+#include "DriverRegistry.h"
+#include "EssenceInfo.h"
+#include "TaskScheduler.h"
+#include "Persist.h"
+
+#include <memory>
+#include <algorithm>
+
+using namespace v8;
+
+namespace streampunk {
+
+uint32_t beToLe32 (uint32_t be);
+
+struct tRenditionOutput {
+  std::vector<std::shared_ptr<Memory> > packets;
+  std::vector<tPacketInfo> packetInfos;
+};
+
+// The packets from every rendition for one source frame, or for the end of the stream, in
+// rendition order - each packet description records the rendition it belongs to
+class AbrResultProcessData : public iProcessData {
+public:
+  uint64_t numBytes() const { return 0; }
+  std::vector<std::shared_ptr<Memory> > resultBufs() const { return mPackets; }
+  Local<Value> resultInfo() const {
+    Local<Array> infoArray = Nan::New<Array>((int)mPacketInfos.size());
+    for (uint32_t i = 0; i < mPacketInfos.size(); ++i) {
+      Local<Object> info = Encoder::packetInfoObject(mPacketInfos[i]);
+      Nan::Set(info, Nan::New("rendition").ToLocalChecked(), Nan::New(mRenditions[i]));
+      Nan::Set(infoArray, i, info);
+    }
+    return infoArray;
+  }
+
+  uint32_t addOutput(uint32_t rendition, const tRenditionOutput &output) {
+    uint32_t numBytes = 0;
+    for (uint32_t i = 0; i < output.packets.size(); ++i) {
+      mPackets.push_back(output.packets[i]);
+      mPacketInfos.push_back(output.packetInfos[i]);
+      mRenditions.push_back(rendition);
+      numBytes += output.packetInfos[i].numBytes;
+    }
+    return numBytes;
+  }
+
+private:
+  std::vector<std::shared_ptr<Memory> > mPackets;
+  std::vector<tPacketInfo> mPacketInfos;
+  std::vector<uint32_t> mRenditions;
+};
+
+class AbrEncodeProcessData : public AbrResultProcessData {
+public:
+  AbrEncodeProcessData (Local<Object> srcBufObj)
+    : mPersistentSrcBuf(srcBufObj),
+      mSrcBuf((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj))
+    { }
+  ~AbrEncodeProcessData() {}
+
+  std::shared_ptr<Memory> srcBuf() { return share(mSrcBuf); }
+  uint64_t numBytes() const { return mSrcBuf.numBytes(); }
+
+private:
+  Persist mPersistentSrcBuf;
+  Memory mSrcBuf;
+};
+
+// describes the 420P picture that is scaled for, and encoded by, a rendition
+static std::shared_ptr<EssenceInfo> makePictureInfo(uint32_t width, uint32_t height, const EssenceInfo &srcInfo) {
+  Local<Object> tags = Nan::New<Object>();
+  Nan::Set(tags, Nan::New("format").ToLocalChecked(), Nan::New("video").ToLocalChecked());
+  Nan::Set(tags, Nan::New("width").ToLocalChecked(), Nan::New(width));
+  Nan::Set(tags, Nan::New("height").ToLocalChecked(), Nan::New(height));
+  Nan::Set(tags, Nan::New("sampling").ToLocalChecked(), Nan::New("YCbCr-4:2:0").ToLocalChecked());
+  Nan::Set(tags, Nan::New("depth").ToLocalChecked(), Nan::New(8));
+  Nan::Set(tags, Nan::New("colorimetry").ToLocalChecked(), Nan::New(srcInfo.colorimetry()).ToLocalChecked());
+  Nan::Set(tags, Nan::New("interlace").ToLocalChecked(), Nan::New(0 != srcInfo.interlace().compare("prog")));
+  Nan::Set(tags, Nan::New("packing").ToLocalChecked(), Nan::New("420P").ToLocalChecked());
+  return std::make_shared<EssenceInfo>(tags);
+}
+
+
+AbrEncoder::AbrEncoder(Nan::Callback *callback)
+  : mWorker(new MyWorker(callback)), mFrameNum(0), mSetInfoOK(false), mFlushed(false) {
+  AsyncQueueWorker(mWorker);
+}
+AbrEncoder::~AbrEncoder() {}
+
+// iProcess
+uint32_t AbrEncoder::processFrame (std::shared_ptr<iProcessData> processData) {
+  Timer t;
+  std::shared_ptr<AbrResultProcessData> rpd = std::dynamic_pointer_cast<AbrResultProcessData>(processData);
+  std::shared_ptr<AbrEncodeProcessData> epd = std::dynamic_pointer_cast<AbrEncodeProcessData>(processData);
+  uint32_t numRenditions = (uint32_t)mRenditions.size();
+  std::vector<tRenditionOutput> outputs(numRenditions);
+
+  try {
+    if (epd) {
+      // an unscaled rendition's encoder may keep the source beyond this call
+      std::shared_ptr<Memory> srcBuf = mWorker->holdRef(processData, epd->srcBuf().get());
+      if (mPacker) {
+        std::shared_ptr<Memory> convertBuf = FramePool::instance().acquire(getFormatBytes("420P", mSrcInfo->width(), mSrcInfo->height()));
+        if (!convertBuf)
+          throw std::runtime_error("Failed to allocate buffer for packer result");
+        mPacker->convert(srcBuf, convertBuf);
+        srcBuf = convertBuf;
+        printDebug(eDebug, "convert: %.2fms\n", t.delta());
+      }
+
+      std::vector<std::shared_ptr<Memory> > pictures(numRenditions);
+      scaleRenditions(srcBuf, pictures);
+      printDebug(eDebug, "scale: %.2fms\n", t.delta());
+
+      // each rendition has its own encoder so they can all run at once - the encoders may
+      // keep the pictures, which return to the frame pool when released. An empty destination
+      // has each packet handed out in a buffer of its own size, rather than pinning a frame
+      // sized buffer behind it until JS releases the packet
+      static const std::shared_ptr<Memory> noDstBuf = std::make_shared<Memory>((uint8_t *)NULL, 0);
+      uint32_t frameNum = mFrameNum++;
+      TaskScheduler::instance().parallelFor(0, numRenditions, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t r = begin; r < end; ++r) {
+          uint32_t dstBytes = 0;
+          mRenditions[r].encoder->encodeFrame(pictures[r], noDstBuf, frameNum, &dstBytes, outputs[r].packets, outputs[r].packetInfos);
+        }
+      });
+      printDebug(eDebug, "encode: %.2fms\n", t.delta());
+    } else {
+      TaskScheduler::instance().parallelFor(0, numRenditions, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t r = begin; r < end; ++r)
+          mRenditions[r].encoder->flush(outputs[r].packets, outputs[r].packetInfos);
+      });
+      printDebug(eDebug, "flush: %.2fms\n", t.delta());
+    }
+  } catch (std::exception& err) {
+    printDebug(eError, "AbrEncoder error: %s\n", err.what());
+    processData->setError(std::string("AbrEncoder ") + (epd ? "encode" : "flush") + " error: " + err.what());
+  }
+
+  uint32_t dstBytes = 0;
+  for (uint32_t r = 0; r < numRenditions; ++r)
+    dstBytes += rpd->addOutput(r, outputs[r]);
+  return dstBytes;
+}
+
+// private
+void AbrEncoder::scaleRenditions(std::shared_ptr<Memory> srcBuf, std::vector<std::shared_ptr<Memory> > &pictures) {
+  // each picture is made from one already made, so the largest are made first
+  for (auto r : mScaleOrder) {
+    const tRendition &rendition = mRenditions[r];
+    std::shared_ptr<Memory> fromBuf = (rendition.scaleFrom < 0) ? srcBuf : pictures[rendition.scaleFrom];
+    if (!rendition.scaler) {
+      pictures[r] = fromBuf;
+      continue;
+    }
+    pictures[r] = FramePool::instance().acquire(getFormatBytes("420P", rendition.pictureInfo->width(), rendition.pictureInfo->height()));
+    if (!pictures[r])
+      throw std::runtime_error("Failed to allocate buffer for scaled rendition");
+    rendition.scaler->scaleConvertFrame(fromBuf, pictures[r]);
+  }
+}
+
+void AbrEncoder::doSetInfo(Local<Object> srcTags, Local<Array> renditionTags, const Duration& duration) {
+  mSrcInfo = std::make_shared<EssenceInfo>(srcTags);
+  printDebug(eInfo, "AbrEncoder SrcInfo: %s\n", mSrcInfo->toString().c_str());
+
+  if (mSrcInfo->packing().compare("420P") && mSrcInfo->packing().compare("YUV422P10") &&
+      mSrcInfo->packing().compare("pgroup") && mSrcInfo->packing().compare("v210")) {
+    std::string err = std::string("Unsupported source format \'") + mSrcInfo->packing().c_str() + "\'";
+    return Nan::ThrowError(err.c_str());
+  }
+  if (mSrcInfo->width() % 2) {
+    std::string err = std::string("Width must be divisible by 2 - src ") + std::to_string(mSrcInfo->width());
+    return Nan::ThrowError(err.c_str());
+  }
+  if (0 == renditionTags->Length())
+    return Nan::ThrowError("AbrEncoder requires at least one rendition");
+
+  mPacker.reset();
+  if (mSrcInfo->packing().compare("420P"))
+    mPacker = std::make_shared<Packers>(mSrcInfo->width(), mSrcInfo->height(), mSrcInfo->packing(), "420P");
+
+  // the codec and scaler constructors report failure by throwing into JS
+  Nan::TryCatch try_catch;
+  mRenditions.clear();
+  for (uint32_t r = 0; r < renditionTags->Length(); ++r) {
+    if (!renditionTags->Get(r)->IsObject())
+      return Nan::ThrowError("AbrEncoder renditions must be objects");
+    Local<Object> tags = Local<Object>::Cast(renditionTags->Get(r));
+    std::shared_ptr<EssenceInfo> dstInfo = std::make_shared<EssenceInfo>(tags);
+    printDebug(eInfo, "AbrEncoder rendition %d: %s\n", r, dstInfo->toString().c_str());
+
+    if (!DriverRegistry::instance().hasEncoder(dstInfo->encodingName())) {
+      std::string err = std::string("Unsupported rendition codec type \'") + dstInfo->encodingName() + "\'";
+      return Nan::ThrowError(err.c_str());
+    }
+    if ((0 == dstInfo->width()) || (0 == dstInfo->height()) || (dstInfo->width() % 2) || (dstInfo->height() % 2)) {
+      std::string err = std::string("Rendition dimensions must be non-zero and divisible by 2 - received ") +
+        std::to_string(dstInfo->width()) + "x" + std::to_string(dstInfo->height());
+      return Nan::ThrowError(err.c_str());
+    }
+
+    tRendition rendition;
+    rendition.pictureInfo = makePictureInfo(dstInfo->width(), dstInfo->height(), *mSrcInfo);
+    rendition.scaleFrom = -1;
+    try {
+      rendition.encodeParams = std::make_shared<EncodeParams>(tags, true);
+      rendition.encoder = DriverRegistry::instance().createEncoder(rendition.pictureInfo, dstInfo, duration, rendition.encodeParams);
+    } catch (std::exception& err) {
+      return Nan::ThrowError(err.what());
+    }
+    if (try_catch.HasCaught()) {
+      try_catch.ReThrow();
+      return;
+    }
+    printDebug(eInfo, "AbrEncoder rendition %d settings: %s\n", r, rendition.encodeParams->toString().c_str());
+    mRenditions.push_back(rendition);
+  }
+
+  // build the scaling pyramid - each rendition is scaled from the smallest picture already made
+  // that covers it, or taken as is where that picture is the same size
+  mScaleOrder.clear();
+  for (uint32_t r = 0; r < mRenditions.size(); ++r)
+    mScaleOrder.push_back(r);
+  std::stable_sort(mScaleOrder.begin(), mScaleOrder.end(), [this](uint32_t a, uint32_t b) {
+    return mRenditions[a].pictureInfo->width() * mRenditions[a].pictureInfo->height() >
+           mRenditions[b].pictureInfo->width() * mRenditions[b].pictureInfo->height();
+  });
+
+  for (uint32_t i = 0; i < mScaleOrder.size(); ++i) {
+    tRendition &rendition = mRenditions[mScaleOrder[i]];
+    uint32_t width = rendition.pictureInfo->width();
+    uint32_t height = rendition.pictureInfo->height();
+    std::shared_ptr<EssenceInfo> fromInfo = makePictureInfo(mSrcInfo->width(), mSrcInfo->height(), *mSrcInfo);
+    for (uint32_t j = 0; j < i; ++j) {
+      const tRendition &candidate = mRenditions[mScaleOrder[j]];
+      if ((candidate.pictureInfo->width() >= width) && (candidate.pictureInfo->height() >= height) &&
+          (candidate.pictureInfo->width() * candidate.pictureInfo->height() <= fromInfo->width() * fromInfo->height())) {
+        rendition.scaleFrom = (int32_t)mScaleOrder[j];
+        fromInfo = candidate.pictureInfo;
+      }
+    }
+
+    if ((fromInfo->width() != width) || (fromInfo->height() != height))
+      rendition.scaler = std::make_shared<ScaleConverterFF>(fromInfo, rendition.pictureInfo, fXY(1.0, 1.0), fXY(0.0, 0.0), mDebugLevel);
+    if (try_catch.HasCaught()) {
+      try_catch.ReThrow();
+      return;
+    }
+    printDebug(eInfo, "AbrEncoder rendition %d: %dx%d %s %dx%d\n", mScaleOrder[i], width, height,
+      rendition.scaler ? "scaled from" : "taken from", fromInfo->width(), fromInfo->height());
+  }
+}
+
+NAN_METHOD(AbrEncoder::SetInfo) {
+  if (info.Length() != 4)
+    return Nan::ThrowError("AbrEncoder SetInfo expects 4 arguments");
+  if (!info[0]->IsObject())
+    return Nan::ThrowError("AbrEncoder SetInfo requires a valid source info object as the first parameter");
+  if (!info[1]->IsArray())
+    return Nan::ThrowError("AbrEncoder SetInfo requires a valid renditions array as the second parameter");
+  if (!info[2]->IsObject())
+    return Nan::ThrowError("AbrEncoder SetInfo requires a valid duration buffer as the third parameter");
+  if (!info[3]->IsNumber())
+    return Nan::ThrowError("AbrEncoder SetInfo requires a valid debug level as the fourth parameter");
+  Local<Object> srcTags = Local<Object>::Cast(info[0]);
+  Local<Array> renditionTags = Local<Array>::Cast(info[1]);
+  Local<Object> durObj = Local<Object>::Cast(info[2]);
+
+  AbrEncoder* obj = Nan::ObjectWrap::Unwrap<AbrEncoder>(info.Holder());
+  obj->setDebug((eDebugLevel)Nan::To<uint32_t>(info[3]).FromJust());
+
+  uint32_t *pDur = (uint32_t *)node::Buffer::Data(durObj);
+  uint32_t durNum = beToLe32(*pDur++);
+  uint32_t durDen = beToLe32(*pDur);
+  Duration duration(durNum, durDen);
+
+  Nan::TryCatch try_catch;
+  obj->doSetInfo(srcTags, renditionTags, duration);
+  if (try_catch.HasCaught()) {
+    obj->mSetInfoOK = false;
+    try_catch.ReThrow();
+    return;
+  }
+
+  obj->mSetInfoOK = true;
+  info.GetReturnValue().Set(Nan::New((uint32_t)obj->mRenditions.size()));
+}
+
+NAN_METHOD(AbrEncoder::Encode) {
+  if (info.Length() != 2)
+    return Nan::ThrowError("AbrEncoder Encode expects 2 arguments");
+  if (!info[0]->IsArray())
+    return Nan::ThrowError("AbrEncoder Encode requires a valid source buffer array as the first parameter");
+  if (!info[1]->IsFunction())
+    return Nan::ThrowError("AbrEncoder Encode requires a valid callback as the second parameter");
+
+  Local<Array> srcBufArray = Local<Array>::Cast(info[0]);
+  Local<Function> callback = Local<Function>::Cast(info[1]);
+
+  AbrEncoder* obj = Nan::ObjectWrap::Unwrap<AbrEncoder>(info.Holder());
+
+  if (!obj->mSetInfoOK)
+    return Nan::ThrowError("AbrEncoder Encode called with incorrect setup parameters");
+  if (obj->mFlushed)
+    return Nan::ThrowError("AbrEncoder Encode called after flush");
+
+  if ((1 != srcBufArray->Length()) || !srcBufArray->Get(0)->IsObject()) {
+    std::string err = std::string("AbrEncoder requires single source buffer - received ") + std::to_string(srcBufArray->Length());
+    return Nan::ThrowError(err.c_str());
+  }
+  Local<Object> srcBufObj = Local<Object>::Cast(srcBufArray->Get(0));
+
+  std::shared_ptr<iProcessData> epd = obj->mWorker->makeProcessData<AbrEncodeProcessData>(srcBufObj);
+  if (!obj->mWorker->doFrame(epd, obj, callback))
+    return;
+
+  info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
+}
+
+NAN_METHOD(AbrEncoder::Flush) {
+  if (info.Length() != 1)
+    return Nan::ThrowError("AbrEncoder Flush expects 1 argument");
+  if (!info[0]->IsFunction())
+    return Nan::ThrowError("AbrEncoder Flush requires a valid callback as the parameter");
+  Local<Function> callback = Local<Function>::Cast(info[0]);
+
+  AbrEncoder* obj = Nan::ObjectWrap::Unwrap<AbrEncoder>(info.Holder());
+
+  if (!obj->mSetInfoOK)
+    return Nan::ThrowError("AbrEncoder Flush called with incorrect setup parameters");
+
+  std::shared_ptr<iProcessData> fpd = obj->mWorker->makeProcessData<AbrResultProcessData>();
+  if (!obj->mWorker->doFrame(fpd, obj, callback))
+    return;
+  obj->mFlushed = true;
+
+  info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
+}
+
+NAN_METHOD(AbrEncoder::Quit) {
+  if (info.Length() != 1)
+    return Nan::ThrowError("AbrEncoder quit expects 1 argument");
+  if (!info[0]->IsFunction())
+    return Nan::ThrowError("AbrEncoder quit requires a valid callback as the parameter");
+  Nan::Callback *callback = new Nan::Callback(Local<Function>::Cast(info[0]));
+  AbrEncoder* obj = Nan::ObjectWrap::Unwrap<AbrEncoder>(info.Holder());
+
+  if (obj->mWorker != NULL)
+    obj->mWorker->quit(callback);
+
+  info.GetReturnValue().SetUndefined();
+}
+
+NAN_METHOD(AbrEncoder::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<AbrEncoder>(info.Holder())->mWorker->setOptions("AbrEncoder", info);
+}
+
+NAN_METHOD(AbrEncoder::Stats) {
+  AbrEncoder* obj = Nan::ObjectWrap::Unwrap<AbrEncoder>(info.Holder());
+  Local<Object> stats = obj->mWorker->stats();
+
+  Local<Array> renditionStats = Nan::New<Array>((int)obj->mRenditions.size());
+  for (uint32_t r = 0; r < obj->mRenditions.size(); ++r) {
+    const tRendition &rendition = obj->mRenditions[r];
+    Local<Object> rs = Nan::New<Object>();
+    Nan::Set(rs, Nan::New("width").ToLocalChecked(), Nan::New(rendition.pictureInfo->width()));
+    Nan::Set(rs, Nan::New("height").ToLocalChecked(), Nan::New(rendition.pictureInfo->height()));
+    Nan::Set(rs, Nan::New("scaleFrom").ToLocalChecked(), Nan::New(rendition.scaleFrom));
+    Nan::Set(rs, Nan::New("scaled").ToLocalChecked(), Nan::New((bool)rendition.scaler));
+    Local<Object> encodeStats = Nan::New<Object>();
+    rendition.encodeParams->addStats(encodeStats);
+    Nan::Set(rs, Nan::New("encode").ToLocalChecked(), encodeStats);
+    Nan::Set(renditionStats, r, rs);
+  }
+  Nan::Set(stats, Nan::New("renditions").ToLocalChecked(), renditionStats);
+  info.GetReturnValue().Set(stats);
+}
+
+NAN_MODULE_INIT(AbrEncoder::Init) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("AbrEncoder").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  SetPrototypeMethod(tpl, "setInfo", SetInfo);
+  SetPrototypeMethod(tpl, "encode", Encode);
+  SetPrototypeMethod(tpl, "flush", Flush);
+  SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
+
+  constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
+  Nan::Set(target, Nan::New("AbrEncoder").ToLocalChecked(),
+    Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+} // namespace streampunk
@@ -0,0 +1,103 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef ABRENCODER_H
+#define ABRENCODER_H
+
+#include "iDebug.h"
+#include "iProcess.h"
+#include <memory>
+#include <vector>
+
+namespace streampunk {
+
+class MyWorker;
+class Packers;
+class ScaleConverterFF;
+class iEncoderDriver;
+class EncodeParams;
+class EssenceInfo;
+class Duration;
+class Memory;
+
+// Encodes each source frame at every rendition of an ABR ladder. The source is unpacked to 420P
+// once, each rendition is scaled from the smallest larger picture already produced, and the
+// renditions are encoded in parallel.
+class AbrEncoder : public Nan::ObjectWrap, public iProcess, public iDebug {
+public:
+  static NAN_MODULE_INIT(Init);
+
+  // iProcess
+  uint32_t processFrame (std::shared_ptr<iProcessData> processData);
+
+private:
+  explicit AbrEncoder(Nan::Callback *callback);
+  ~AbrEncoder();
+
+  void doSetInfo(v8::Local<v8::Object> srcTags, v8::Local<v8::Array> renditionTags, const Duration& duration);
+
+  static NAN_METHOD(New) {
+    if (info.IsConstructCall()) {
+      if (!((info.Length() == 1) && (info[0]->IsFunction())))
+        return Nan::ThrowError("AbrEncoder constructor requires a valid callback as the parameter");
+      Nan::Callback *callback = new Nan::Callback(v8::Local<v8::Function>::Cast(info[0]));
+      AbrEncoder *obj = new AbrEncoder(callback);
+      obj->Wrap(info.This());
+      info.GetReturnValue().Set(info.This());
+    } else {
+      const int argc = 1;
+      v8::Local<v8::Value> argv[] = {info[0]};
+      v8::Local<v8::Function> cons = Nan::New(constructor());
+      info.GetReturnValue().Set(cons->NewInstance(Nan::GetCurrentContext(), argc, argv).ToLocalChecked());
+    }
+  }
+
+  static inline Nan::Persistent<v8::Function> & constructor() {
+    static Nan::Persistent<v8::Function> my_constructor;
+    return my_constructor;
+  }
+
+  static NAN_METHOD(SetInfo);
+  static NAN_METHOD(Encode);
+  static NAN_METHOD(Flush);
+  static NAN_METHOD(Quit);
+  static NAN_METHOD(SetWorkerOptions);
+  static NAN_METHOD(Stats);
+
+  struct tRendition {
+    std::shared_ptr<EssenceInfo> pictureInfo;
+    std::shared_ptr<EncodeParams> encodeParams;
+    std::shared_ptr<iEncoderDriver> encoder;
+    // scales from the 420P source when scaleFrom is negative, otherwise from another rendition
+    std::shared_ptr<ScaleConverterFF> scaler;
+    int32_t scaleFrom;
+  };
+
+  void scaleRenditions(std::shared_ptr<Memory> srcBuf, std::vector<std::shared_ptr<Memory> > &pictures);
+
+  MyWorker *mWorker;
+  uint32_t mFrameNum;
+  bool mSetInfoOK;
+  bool mFlushed;
+  std::shared_ptr<EssenceInfo> mSrcInfo;
+  std::shared_ptr<Packers> mPacker;
+  // renditions in the order given, and their indices in scaling order, largest first
+  std::vector<tRendition> mRenditions;
+  std::vector<uint32_t> mScaleOrder;
+};
+
+} // namespace streampunk
+
+#endif
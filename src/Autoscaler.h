@@ -0,0 +1,255 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef AUTOSCALER_H
+#define AUTOSCALER_H
+
+#include <nan.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "Params.h"
+#include "TaskScheduler.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace v8;
+
+namespace streampunk {
+
+class AutoscaleParams : public Params {
+public:
+  AutoscaleParams()
+    : mEnabled(false), mMinThreads(0), mMaxThreads(TaskScheduler::instance().numThreads()),
+      mHighWaitMs(10), mLowWaitMs(2), mMaxCpu(90), mIntervalMs(1000) {}
+  AutoscaleParams(Local<Object> tags)
+    : mEnabled(unpackBool(tags, "enabled", true)),
+      mMinThreads(unpackNum(tags, "min", 0)),
+      mMaxThreads(unpackNum(tags, "max", TaskScheduler::instance().numThreads())),
+      mHighWaitMs(unpackNum(tags, "highWaitMs", 10)),
+      mLowWaitMs(unpackNum(tags, "lowWaitMs", 2)),
+      mMaxCpu(unpackNum(tags, "maxCpu", 90)),
+      mIntervalMs(unpackNum(tags, "intervalMs", 1000)) {
+    uint32_t numThreads = TaskScheduler::instance().numThreads();
+    if (mMaxThreads > numThreads)
+      mMaxThreads = numThreads;
+    if (mMinThreads > mMaxThreads)
+      throw std::runtime_error(std::string("Autoscale min threads ") + std::to_string(mMinThreads) + " exceeds max threads " + std::to_string(mMaxThreads));
+    if (mLowWaitMs >= mHighWaitMs)
+      throw std::runtime_error("Autoscale lowWaitMs must be less than highWaitMs");
+    if ((0 == mMaxCpu) || (mMaxCpu > 100))
+      throw std::runtime_error(std::string("Autoscale maxCpu must be in the range 1-100 - received ") + std::to_string(mMaxCpu));
+  }
+
+  bool enabled() const  { return mEnabled; }
+  uint32_t minThreads() const  { return mMinThreads; }
+  uint32_t maxThreads() const  { return mMaxThreads; }
+  uint32_t highWaitMs() const  { return mHighWaitMs; }
+  uint32_t lowWaitMs() const  { return mLowWaitMs; }
+  uint32_t maxCpu() const  { return mMaxCpu; }
+  uint32_t intervalMs() const  { return mIntervalMs; }
+
+  void addStats(Local<Object> stats) const {
+    Nan::Set(stats, Nan::New("enabled").ToLocalChecked(), Nan::New(mEnabled));
+    Nan::Set(stats, Nan::New("min").ToLocalChecked(), Nan::New(mMinThreads));
+    Nan::Set(stats, Nan::New("max").ToLocalChecked(), Nan::New(mMaxThreads));
+    Nan::Set(stats, Nan::New("highWaitMs").ToLocalChecked(), Nan::New(mHighWaitMs));
+    Nan::Set(stats, Nan::New("lowWaitMs").ToLocalChecked(), Nan::New(mLowWaitMs));
+    Nan::Set(stats, Nan::New("maxCpu").ToLocalChecked(), Nan::New(mMaxCpu));
+    Nan::Set(stats, Nan::New("intervalMs").ToLocalChecked(), Nan::New(mIntervalMs));
+  }
+
+private:
+  bool mEnabled;
+  uint32_t mMinThreads;
+  uint32_t mMaxThreads;
+  uint32_t mHighWaitMs;
+  uint32_t mLowWaitMs;
+  uint32_t mMaxCpu;
+  uint32_t mIntervalMs;
+};
+
+// Adjusts the number of active task scheduler threads from the time frames wait in the
+// processor queues and the process CPU utilisation. Waits are recorded by the worker threads,
+// decisions are made on the JS thread as frame callbacks are delivered.
+class Autoscaler {
+public:
+  static Autoscaler &instance() {
+    // deliberately never destroyed, as for the scheduler it controls
+    static Autoscaler *autoscaler = new Autoscaler;
+    return *autoscaler;
+  }
+
+  void configure(const AutoscaleParams &params, Local<Function> eventFn) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mParams = params;
+    mEnabled = mParams.enabled();
+    mEventCallback.reset();
+    if (!eventFn.IsEmpty())
+      mEventCallback = std::make_shared<Nan::Callback>(eventFn);
+    mWaits.clear();
+    mLastEval = std::chrono::steady_clock::now();
+    mLastCpuSecs = cpuSecs();
+
+    TaskScheduler &scheduler = TaskScheduler::instance();
+    uint32_t active = scheduler.activeThreads();
+    if (!mParams.enabled())
+      active = scheduler.numThreads();
+    else if (active < mParams.minThreads())
+      active = mParams.minThreads();
+    else if (active > mParams.maxThreads())
+      active = mParams.maxThreads();
+    scheduler.setActiveThreads(active);
+  }
+
+  // called by a worker thread as it takes a frame from its queue
+  void recordWait(const void *worker, double waitMs) {
+    // checked without the lock so that workers do not contend when autoscaling is off
+    if (!mEnabled)
+      return;
+    std::lock_guard<std::mutex> lk(mMtx);
+    tWait &wait = mWaits[worker];
+    wait.totalMs += waitMs;
+    ++wait.count;
+  }
+
+  void removeWorker(const void *worker) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mWaits.erase(worker);
+  }
+
+  // called on the JS thread - notifies the registered function if the active thread count is changed
+  void evaluate(Nan::AsyncResource *asyncResource) {
+    if (!mEnabled)
+      return;
+    std::unique_lock<std::mutex> lk(mMtx);
+    if (!mParams.enabled())
+      return;
+    auto now = std::chrono::steady_clock::now();
+    double elapsedMs = std::chrono::duration<double, std::milli>(now - mLastEval).count();
+    if (elapsedMs < mParams.intervalMs())
+      return;
+
+    // the slowest processor determines whether more threads are needed
+    bool sampled = false;
+    double waitMs = 0.0;
+    for (auto& w : mWaits)
+      if (w.second.count) {
+        sampled = true;
+        if (w.second.totalMs / w.second.count > waitMs)
+          waitMs = w.second.totalMs / w.second.count;
+      }
+    mWaits.clear();
+
+    double curCpuSecs = cpuSecs();
+    double cpu = 100.0 * (curCpuSecs - mLastCpuSecs) * 1000.0 / elapsedMs / numCpus();
+    mLastCpuSecs = curCpuSecs;
+    mLastEval = now;
+    mLastCpu = cpu;
+    // an interval with no frames taken from any queue says nothing about the wait, so is not
+    // treated as idle
+    if (!sampled)
+      return;
+    mLastWaitMs = waitMs;
+
+    TaskScheduler &scheduler = TaskScheduler::instance();
+    uint32_t from = scheduler.activeThreads();
+    uint32_t to = from;
+    std::string reason;
+    if ((cpu > mParams.maxCpu()) && (from > mParams.minThreads())) {
+      to = from - 1;
+      reason = "cpu";
+    } else if ((waitMs > mParams.highWaitMs()) && (cpu < mParams.maxCpu()) && (from < mParams.maxThreads())) {
+      to = from + 1;
+      reason = "queueWait";
+    } else if ((waitMs < mParams.lowWaitMs()) && (from > mParams.minThreads())) {
+      to = from - 1;
+      reason = "idle";
+    }
+    if (to == from)
+      return;
+
+    scheduler.setActiveThreads(to);
+    ++mNumScales;
+    std::shared_ptr<Nan::Callback> eventCallback = mEventCallback;
+    lk.unlock();
+    if (!eventCallback)
+      return;
+
+    Local<Object> event = Nan::New<Object>();
+    Nan::Set(event, Nan::New("from").ToLocalChecked(), Nan::New(from));
+    Nan::Set(event, Nan::New("to").ToLocalChecked(), Nan::New(to));
+    Nan::Set(event, Nan::New("reason").ToLocalChecked(), Nan::New(reason).ToLocalChecked());
+    Nan::Set(event, Nan::New("queueWaitMs").ToLocalChecked(), Nan::New(waitMs));
+    Nan::Set(event, Nan::New("cpu").ToLocalChecked(), Nan::New(cpu));
+    Local<Value> argv[] = { event };
+    eventCallback->Call(1, argv, asyncResource);
+  }
+
+  void addStats(Local<Object> stats) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mParams.addStats(stats);
+    Nan::Set(stats, Nan::New("queueWaitMs").ToLocalChecked(), Nan::New(mLastWaitMs));
+    Nan::Set(stats, Nan::New("cpu").ToLocalChecked(), Nan::New(mLastCpu));
+    Nan::Set(stats, Nan::New("scales").ToLocalChecked(), Nan::New(mNumScales));
+  }
+
+private:
+  Autoscaler()
+    : mEnabled(false), mLastEval(std::chrono::steady_clock::now()), mLastCpuSecs(cpuSecs()),
+      mLastWaitMs(0.0), mLastCpu(0.0), mNumScales(0) {}
+
+  static double cpuSecs() {
+#ifndef _WIN32
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#else
+    // cpu utilisation is not measured on this platform so scaling follows queue wait only
+    return 0.0;
+#endif
+  }
+
+  static uint32_t numCpus() {
+    return std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  struct tWait {
+    tWait() : totalMs(0.0), count(0) {}
+    double totalMs;
+    uint32_t count;
+  };
+
+  std::mutex mMtx;
+  AutoscaleParams mParams;
+  std::atomic<bool> mEnabled;
+  std::shared_ptr<Nan::Callback> mEventCallback;
+  std::map<const void *, tWait> mWaits;
+  std::chrono::steady_clock::time_point mLastEval;
+  double mLastCpuSecs;
+  double mLastWaitMs;
+  double mLastCpu;
+  uint32_t mNumScales;
+};
+
+} // namespace streampunk
+
+#endif
@@ -0,0 +1,233 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <nan.h>
+#include "BufferPool.h"
+#include "Memory.h"
+#include "Packers.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace v8;
+
+namespace streampunk {
+
+// Owns the frame memory - shared by the pool object and every Buffer handed out, so the memory
+// outlives whichever of them is collected last
+class BufferPool::PoolState {
+public:
+  PoolState(uint32_t numBytes)
+    : mNumBytes(numBytes), mOutstanding(0), mPeak(0), mAcquired(0), mReleased(0), mCollected(0), mGrown(0) {}
+  ~PoolState() {
+    for (auto& s : mSlots)
+      frameFree(s.buf, s.mapBytes);
+  }
+
+  uint32_t numBytes() const  { return mNumBytes; }
+
+  // pre-faults the memory so the first frame written does not pay for it
+  bool addSlot() {
+    tSlot slot;
+    slot.buf = frameAlloc(mNumBytes, slot.mapBytes);
+    if (!slot.buf)
+      return false;
+    memset(slot.buf, 0, mNumBytes);
+    slot.generation = 0;
+    slot.inUse = false;
+    std::lock_guard<std::mutex> lk(mMtx);
+    mSlotIndex[slot.buf] = (uint32_t)mSlots.size();
+    mFreeSlots.push_back((uint32_t)mSlots.size());
+    mSlots.push_back(slot);
+    return true;
+  }
+
+  bool acquire(uint32_t &index, uint32_t &generation, uint8_t *&buf) {
+    std::unique_lock<std::mutex> lk(mMtx);
+    if (mFreeSlots.empty()) {
+      lk.unlock();
+      if (!addSlot())
+        return false;
+      lk.lock();
+      ++mGrown;
+    }
+
+    index = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    tSlot &slot = mSlots[index];
+    slot.inUse = true;
+    generation = slot.generation;
+    buf = slot.buf;
+    ++mAcquired;
+    if (++mOutstanding > mPeak)
+      mPeak = mOutstanding;
+    return true;
+  }
+
+  bool findSlot(const uint8_t *buf, uint32_t &index, uint32_t &generation) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    auto s = mSlotIndex.find(buf);
+    if ((mSlotIndex.end() == s) || !mSlots[s->second].inUse)
+      return false;
+    index = s->second;
+    generation = mSlots[index].generation;
+    return true;
+  }
+
+  // the generation stops a Buffer that was explicitly released from returning its slot again
+  // when it is later collected, by which time the slot may have been handed out again
+  void returnSlot(uint32_t index, uint32_t generation, bool collected) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    tSlot &slot = mSlots[index];
+    if (!slot.inUse || (slot.generation != generation))
+      return;
+    slot.inUse = false;
+    ++slot.generation;
+    mFreeSlots.push_back(index);
+    --mOutstanding;
+    if (collected)
+      ++mCollected;
+    else
+      ++mReleased;
+  }
+
+  void addStats(Local<Object> stats) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    Nan::Set(stats, Nan::New("size").ToLocalChecked(), Nan::New((uint32_t)mSlots.size()));
+    Nan::Set(stats, Nan::New("free").ToLocalChecked(), Nan::New((uint32_t)mFreeSlots.size()));
+    Nan::Set(stats, Nan::New("outstanding").ToLocalChecked(), Nan::New(mOutstanding));
+    Nan::Set(stats, Nan::New("peak").ToLocalChecked(), Nan::New(mPeak));
+    Nan::Set(stats, Nan::New("acquired").ToLocalChecked(), Nan::New((double)mAcquired));
+    Nan::Set(stats, Nan::New("released").ToLocalChecked(), Nan::New((double)mReleased));
+    Nan::Set(stats, Nan::New("collected").ToLocalChecked(), Nan::New((double)mCollected));
+    Nan::Set(stats, Nan::New("grown").ToLocalChecked(), Nan::New((double)mGrown));
+  }
+
+private:
+  struct tSlot {
+    uint8_t *buf;
+    size_t mapBytes;
+    uint32_t generation;
+    bool inUse;
+  };
+
+  const uint32_t mNumBytes;
+  std::mutex mMtx;
+  std::vector<tSlot> mSlots;
+  std::vector<uint32_t> mFreeSlots;
+  std::map<const uint8_t *, uint32_t> mSlotIndex;
+  uint32_t mOutstanding;
+  uint32_t mPeak;
+  uint64_t mAcquired;
+  uint64_t mReleased;
+  uint64_t mCollected;
+  uint64_t mGrown;
+};
+
+struct tBufferRef {
+  tBufferRef(std::shared_ptr<BufferPool::PoolState> state, uint32_t index, uint32_t generation)
+    : state(state), index(index), generation(generation) {}
+  std::shared_ptr<BufferPool::PoolState> state;
+  uint32_t index;
+  uint32_t generation;
+};
+
+static void collectBuffer(char *data, void *hint) {
+  tBufferRef *ref = (tBufferRef *)hint;
+  ref->state->returnSlot(ref->index, ref->generation, true);
+  delete ref;
+}
+
+BufferPool::BufferPool(const std::string& format, uint32_t width, uint32_t height, bool hasAlpha, uint32_t numBytes, uint32_t count)
+  : mFormat(format), mWidth(width), mHeight(height), mHasAlpha(hasAlpha), mState(std::make_shared<PoolState>(numBytes)) {
+  for (uint32_t i = 0; i < count; ++i)
+    if (!mState->addSlot())
+      break;
+}
+BufferPool::~BufferPool() {}
+
+uint32_t BufferPool::getNumBytes(const std::string& format, uint32_t width, uint32_t height, bool hasAlpha) {
+  return getFormatBytes(format, width, height, hasAlpha);
+}
+
+NAN_METHOD(BufferPool::Acquire) {
+  BufferPool* obj = Nan::ObjectWrap::Unwrap<BufferPool>(info.Holder());
+  uint32_t index = 0;
+  uint32_t generation = 0;
+  uint8_t *buf = NULL;
+  if (!obj->mState->acquire(index, generation, buf))
+    return Nan::ThrowError("BufferPool failed to allocate buffer");
+
+  tBufferRef *ref = new tBufferRef(obj->mState, index, generation);
+  info.GetReturnValue().Set(Nan::NewBuffer((char *)buf, obj->mState->numBytes(), collectBuffer, ref).ToLocalChecked());
+}
+
+// takes the memory away from a released Buffer, so that it reads as empty rather than aliasing a
+// slot that may already have been handed out again - the memory stays with the pool
+static void detachBuffer(Local<Object> bufObj) {
+  Local<ArrayBuffer> arrayBuffer = bufObj.As<Uint8Array>()->Buffer();
+#if (V8_MAJOR_VERSION > 7) || ((V8_MAJOR_VERSION == 7) && (V8_MINOR_VERSION >= 3))
+  if (arrayBuffer->IsDetachable())
+    arrayBuffer->Detach();
+#else
+  if (arrayBuffer->IsNeuterable())
+    arrayBuffer->Neuter();
+#endif
+}
+
+NAN_METHOD(BufferPool::Release) {
+  if ((info.Length() != 1) || !node::Buffer::HasInstance(info[0]))
+    return Nan::ThrowError("BufferPool release expects a buffer");
+
+  BufferPool* obj = Nan::ObjectWrap::Unwrap<BufferPool>(info.Holder());
+  Local<Object> bufObj = Local<Object>::Cast(info[0]);
+  uint32_t index = 0;
+  uint32_t generation = 0;
+  if (!obj->mState->findSlot((uint8_t *)node::Buffer::Data(bufObj), index, generation))
+    return Nan::ThrowError("BufferPool release called with a buffer that is not outstanding from this pool");
+  // the slot is returned first, so the free callback a detach may run finds it already returned
+  obj->mState->returnSlot(index, generation, false);
+  detachBuffer(bufObj);
+  info.GetReturnValue().SetUndefined();
+}
+
+NAN_METHOD(BufferPool::Stats) {
+  BufferPool* obj = Nan::ObjectWrap::Unwrap<BufferPool>(info.Holder());
+  Local<Object> stats = Nan::New<Object>();
+  Nan::Set(stats, Nan::New("format").ToLocalChecked(), Nan::New(obj->mFormat).ToLocalChecked());
+  Nan::Set(stats, Nan::New("width").ToLocalChecked(), Nan::New(obj->mWidth));
+  Nan::Set(stats, Nan::New("height").ToLocalChecked(), Nan::New(obj->mHeight));
+  Nan::Set(stats, Nan::New("bufferBytes").ToLocalChecked(), Nan::New(obj->mState->numBytes()));
+  obj->mState->addStats(stats);
+  info.GetReturnValue().Set(stats);
+}
+
+NAN_MODULE_INIT(BufferPool::Init) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  tpl->SetClassName(Nan::New("BufferPool").ToLocalChecked());
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  SetPrototypeMethod(tpl, "acquire", Acquire);
+  SetPrototypeMethod(tpl, "release", Release);
+  SetPrototypeMethod(tpl, "stats", Stats);
+
+  constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
+  Nan::Set(target, Nan::New("BufferPool").ToLocalChecked(),
+    Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+} // namespace streampunk
@@ -0,0 +1,83 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <nan.h>
+#include <memory>
+#include <string>
+
+namespace streampunk {
+
+// Hands out pre-faulted, aligned external Buffers of one frame format. A Buffer returns to the
+// pool when release() is called, which detaches its memory so it reads as empty, or failing
+// that when it is garbage collected.
+class BufferPool : public Nan::ObjectWrap {
+public:
+  static NAN_MODULE_INIT(Init);
+  class PoolState;
+
+private:
+  BufferPool(const std::string& format, uint32_t width, uint32_t height, bool hasAlpha, uint32_t numBytes, uint32_t count);
+  ~BufferPool();
+
+  static NAN_METHOD(New) {
+    if (info.IsConstructCall()) {
+      if ((info.Length() < 4) || !info[0]->IsString() || !info[1]->IsNumber() || !info[2]->IsNumber() || !info[3]->IsNumber())
+        return Nan::ThrowError("BufferPool constructor requires format, width, height and count parameters");
+      std::string format = *Nan::Utf8String(info[0]);
+      uint32_t width = Nan::To<uint32_t>(info[1]).FromJust();
+      uint32_t height = Nan::To<uint32_t>(info[2]).FromJust();
+      uint32_t count = Nan::To<uint32_t>(info[3]).FromJust();
+      bool hasAlpha = (info.Length() > 4) ? Nan::To<bool>(info[4]).FromJust() : false;
+      if (!width || !height)
+        return Nan::ThrowError("BufferPool requires non-zero width and height");
+      uint32_t numBytes = getNumBytes(format, width, height, hasAlpha);
+      if (!numBytes)
+        return; // unsupported format error already thrown
+
+      BufferPool *obj = new BufferPool(format, width, height, hasAlpha, numBytes, count);
+      obj->Wrap(info.This());
+      info.GetReturnValue().Set(info.This());
+    } else {
+      const int argc = 5;
+      v8::Local<v8::Value> argv[] = { info[0], info[1], info[2], info[3], info[4] };
+      v8::Local<v8::Function> cons = Nan::New(constructor());
+      info.GetReturnValue().Set(cons->NewInstance(Nan::GetCurrentContext(), argc, argv).ToLocalChecked());
+    }
+  }
+
+  static inline Nan::Persistent<v8::Function> & constructor() {
+    static Nan::Persistent<v8::Function> my_constructor;
+    return my_constructor;
+  }
+
+  static uint32_t getNumBytes(const std::string& format, uint32_t width, uint32_t height, bool hasAlpha);
+
+  static NAN_METHOD(Acquire);
+  static NAN_METHOD(Release);
+  static NAN_METHOD(Stats);
+
+  const std::string mFormat;
+  const uint32_t mWidth;
+  const uint32_t mHeight;
+  const bool mHasAlpha;
+  std::shared_ptr<PoolState> mState;
+};
+
+} // namespace streampunk
+
+#endif
@@ -30,9 +30,11 @@ namespace streampunk {
 
 class ConcatProcessData : public iProcessData {
 public:
-  ConcatProcessData (Local<Array> srcBufArray, Local<Object> dstBuf)
-    : mPersistentSrcBuf(new Persist(srcBufArray)), mPersistentDstBuf(new Persist(dstBuf)),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBuf), (uint32_t)node::Buffer::Length(dstBuf))), mSrcBytes(0) {
+  ConcatProcessData (Local<Array> srcBufArray, Local<Object> dstBuf, std::shared_ptr<Slab> slab)
+    : mPersistentSrcBuf(srcBufArray), mPersistentDstBuf(dstBuf),
+      mSrcBufVec(SlabAllocator<tBuf>(slab)),
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBuf), (uint32_t)node::Buffer::Length(dstBuf)), mSrcBytes(0) {
+    mSrcBufVec.reserve(srcBufArray->Length());
     for (uint32_t i = 0; i < srcBufArray->Length(); ++i) {
       Local<Object> bufferObj = Local<Object>::Cast(srcBufArray->Get(i));
       uint32_t bufLen = (uint32_t)node::Buffer::Length(bufferObj);
@@ -42,15 +44,16 @@ public:
   }
   ~ConcatProcessData() {}
   
-  tBufVec srcBufVec() const { return mSrcBufVec; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  const tBufVec &srcBufVec() const { return mSrcBufVec; }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
   uint32_t srcBytes() const { return mSrcBytes; }
+  uint64_t numBytes() const { return mSrcBytes + mDstBuf.numBytes(); }
 
 private:
-  std::unique_ptr<Persist> mPersistentSrcBuf;
-  std::unique_ptr<Persist> mPersistentDstBuf;
+  Persist mPersistentSrcBuf;
+  Persist mPersistentDstBuf;
   tBufVec mSrcBufVec;
-  std::shared_ptr<Memory> mDstBuf;
+  Memory mDstBuf;
   uint32_t mSrcBytes;
 };
 
@@ -66,7 +69,7 @@ uint32_t Concater::processFrame (std::shared_ptr<iProcessData> processData) {
   Timer t;
   std::shared_ptr<ConcatProcessData> cpd = std::dynamic_pointer_cast<ConcatProcessData>(processData);
 
-  tBufVec srcBufVec = cpd->srcBufVec();
+  const tBufVec &srcBufVec = cpd->srcBufVec();
   std::shared_ptr<Memory> dstBuf = cpd->dstBuf();
   uint32_t totalBytes = 0;
   uint32_t concatBufOffset = 0; 
@@ -173,13 +176,14 @@ NAN_METHOD(Concater::Concat) {
   if (!obj->mSetInfoOK)
     return Nan::ThrowError("Concater Concat called with incorrect setup parameters");
 
-  std::shared_ptr<ConcatProcessData> cpd = std::make_shared<ConcatProcessData>(srcBufArray, dstBuf);
+  std::shared_ptr<ConcatProcessData> cpd = obj->mWorker->makeProcessData<ConcatProcessData>(srcBufArray, dstBuf, obj->mWorker->slab());
   if (cpd->srcBytes() > cpd->dstBuf()->numBytes()) {
     std::string err = std::string("Destination buffer too small: ") + std::to_string(cpd->dstBuf()->numBytes()) + 
       ", required: " + std::to_string(cpd->srcBytes());
     return Nan::ThrowError(err.c_str());
   }
-  obj->mWorker->doFrame(cpd, obj, new Nan::Callback(callback));
+  if (!obj->mWorker->doFrame(cpd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -198,6 +202,14 @@ NAN_METHOD(Concater::Quit) {
   info.GetReturnValue().SetUndefined();
 }
 
+NAN_METHOD(Concater::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<Concater>(info.Holder())->mWorker->setOptions("Concater", info);
+}
+
+NAN_METHOD(Concater::Stats) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Concater>(info.Holder())->mWorker->stats());
+}
+
 NAN_MODULE_INIT(Concater::Init) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Concater").ToLocalChecked());
@@ -206,6 +218,8 @@ NAN_MODULE_INIT(Concater::Init) {
   SetPrototypeMethod(tpl, "setInfo", SetInfo);
   SetPrototypeMethod(tpl, "concat", Concat);
   SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Concater").ToLocalChecked(),
@@ -60,6 +60,8 @@ private:
   static NAN_METHOD(SetInfo);
   static NAN_METHOD(Concat);
   static NAN_METHOD(Quit);
+  static NAN_METHOD(SetWorkerOptions);
+  static NAN_METHOD(Stats);
 
   MyWorker *mWorker;
   bool mSetInfoOK;
@@ -0,0 +1,107 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef CONTEXTPOOL_H
+#define CONTEXTPOOL_H
+
+#include <nan.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <memory>
+
+using namespace v8;
+
+namespace streampunk {
+
+// Keeps codec and scaler contexts that are open and idle, keyed by the settings they were opened
+// with, so that a processor set up the same way as one before it can take a context rather than
+// open its own. Contexts are put in the pool by prewarm, or given back once reset by a processor
+// that has finished with them. Each key keeps a limited number, and any beyond that are released.
+template <class T>
+class ContextPool {
+public:
+  static ContextPool &instance() {
+    // deliberately never destroyed - contexts may be given back during process exit
+    static ContextPool *pool = new ContextPool;
+    return *pool;
+  }
+
+  // returns an empty pointer when there is no idle context for the key
+  std::shared_ptr<T> take(const std::string &key) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    auto it = mIdle.find(key);
+    if ((it == mIdle.end()) || it->second.empty()) {
+      ++mMisses;
+      return std::shared_ptr<T>();
+    }
+    std::shared_ptr<T> context = it->second.back();
+    it->second.pop_back();
+    ++mHits;
+    return context;
+  }
+
+  // returns false when the key already has as many as it keeps - the context is then released
+  // by the caller, outside the lock
+  bool give(const std::string &key, std::shared_ptr<T> context) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    std::vector<std::shared_ptr<T> > &idle = mIdle[key];
+    if (idle.size() >= mMaxIdle)
+      return false;
+    idle.push_back(context);
+    return true;
+  }
+
+  uint32_t numIdle(const std::string &key) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    auto it = mIdle.find(key);
+    return (it == mIdle.end()) ? 0 : (uint32_t)it->second.size();
+  }
+
+  uint32_t maxIdle() const { return mMaxIdle; }
+
+  // releases all idle contexts
+  void clear() {
+    std::map<std::string, std::vector<std::shared_ptr<T> > > idle;
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      idle.swap(mIdle);
+    }
+  }
+
+  void addStats(Local<Object> stats) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    uint32_t numIdle = 0;
+    for (auto& i : mIdle)
+      numIdle += (uint32_t)i.second.size();
+    Nan::Set(stats, Nan::New("hits").ToLocalChecked(), Nan::New((double)mHits));
+    Nan::Set(stats, Nan::New("misses").ToLocalChecked(), Nan::New((double)mMisses));
+    Nan::Set(stats, Nan::New("idle").ToLocalChecked(), Nan::New(numIdle));
+  }
+
+private:
+  ContextPool() : mMaxIdle(8), mHits(0), mMisses(0) {}
+
+  std::mutex mMtx;
+  const uint32_t mMaxIdle;
+  std::map<std::string, std::vector<std::shared_ptr<T> > > mIdle;
+  uint64_t mHits;
+  uint64_t mMisses;
+};
+
+} // namespace streampunk
+
+#endif
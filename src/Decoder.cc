@@ -18,9 +18,10 @@
 #include "MyWorker.h"
 #include "Timer.h"
 #include "Memory.h"
-#include "DecoderFactory.h"
+#include "DriverRegistry.h"
 #include "EssenceInfo.h"
 #include "Persist.h"
+#include "ContextPool.h"
 
 #include <memory>
 
@@ -31,26 +32,36 @@ namespace streampunk {
 class DecodeProcessData : public iProcessData {
 public:
   DecodeProcessData (Local<Object> srcBufObj, Local<Object> dstBufObj)
-    : mPersistentSrcBuf(new Persist(srcBufObj)),
-      mPersistentDstBuf(new Persist(dstBufObj)),
-      mSrcBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj))),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)))
+    : mPersistentSrcBuf(srcBufObj),
+      mPersistentDstBuf(dstBufObj),
+      mSrcBuf((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)),
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))
     { }
   ~DecodeProcessData() { }
   
-  std::shared_ptr<Memory> srcBuf() const { return mSrcBuf; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> srcBuf() { return share(mSrcBuf); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
+  std::vector<std::shared_ptr<Memory> > &frameBufs() { return mFrameBufs; }
+  std::vector<std::shared_ptr<Memory> > resultBufs() const { return mFrameBufs; }
+  uint64_t numBytes() const { return mSrcBuf.numBytes() + mDstBuf.numBytes(); }
 
 private:
-  std::unique_ptr<Persist> mPersistentSrcBuf;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::shared_ptr<Memory> mSrcBuf;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentSrcBuf;
+  Persist mPersistentDstBuf;
+  Memory mSrcBuf;
+  Memory mDstBuf;
+  std::vector<std::shared_ptr<Memory> > mFrameBufs;
+};
+
+// Queued by quit, behind the frames already submitted, to give the decoder back to the pool
+class DecodeReleaseProcessData : public iProcessData {
+public:
+  uint64_t numBytes() const { return 0; }
 };
 
 
 Decoder::Decoder(Nan::Callback *callback) 
-  : mWorker(new MyWorker(callback)), mFrameNum(0), mSetInfoOK(false) {
+  : mWorker(new MyWorker(callback)), mFrameNum(0), mSetInfoOK(false), mDriverReset(false), mWarmStart(false) {
   AsyncQueueWorker(mWorker);
 }
 Decoder::~Decoder() {}
@@ -58,28 +69,86 @@ Decoder::~Decoder() {}
 // iProcess
 uint32_t Decoder::processFrame (std::shared_ptr<iProcessData> processData) {
   Timer t;
+  uint32_t dstBytes = 0;
+  // a decoder that is reset can be taken by the next decoder set up the same way - the pool then
+  // holds the only reference to it, so it is never used by two decoders at once
+  if (std::dynamic_pointer_cast<DecodeReleaseProcessData>(processData)) {
+    if (mDriverReset)
+      ContextPool<tWarmDecoder>::instance().give(mWarmKey, std::make_shared<tWarmDecoder>(tWarmDecoder { mDecoderDriver, mDriverName }));
+    mDriverReset = false;
+    mDecoderDriver.reset();
+    return dstBytes;
+  }
+
+  std::shared_ptr<FlushProcessData> fpd = std::dynamic_pointer_cast<FlushProcessData>(processData);
+  if (fpd) {
+    try {
+      mDecoderDriver->flush(fpd->bufs());
+      mDriverReset = true;
+    } catch (std::exception& err) {
+      printDebug(eError, "Decoder flush error: %s\n", err.what());
+      fpd->setError(std::string("Decoder flush error: ") + err.what());
+    }
+    for (auto& buf : fpd->bufs())
+      dstBytes += buf->numBytes();
+    printDebug(eDebug, "flush : %.2fms, %d pictures\n", t.delta(), (int)fpd->bufs().size());
+    return dstBytes;
+  }
+
   std::shared_ptr<DecodeProcessData> dpd = std::dynamic_pointer_cast<DecodeProcessData>(processData);
 
   // do the decode
-  uint32_t dstBytes = 0;
-  mDecoderDriver->decodeFrame (dpd->srcBuf(), dpd->dstBuf(), mFrameNum++, &dstBytes);
+  mDriverReset = false;
+  try {
+    mDecoderDriver->decodeFrame (dpd->srcBuf(), dpd->dstBuf(), mFrameNum++, &dstBytes, dpd->frameBufs());
+  } catch (std::exception& err) {
+    printDebug(eError, "Decode error: %s\n", err.what());
+    processData->setError(std::string("Decode error: ") + err.what());
+  }
   printDebug(eDebug, "decode : %.2fms\n", t.delta());
 
   return dstBytes;
 }
 
+static std::string warmKey(const EssenceInfo &srcInfo, const EssenceInfo &dstInfo) {
+  return srcInfo.key() + "|" + dstInfo.key();
+}
+
+uint32_t Decoder::prewarm(Local<Object> srcTags, Local<Object> dstTags, uint32_t count) {
+  std::shared_ptr<EssenceInfo> srcInfo = std::make_shared<EssenceInfo>(srcTags);
+  std::shared_ptr<EssenceInfo> dstInfo = std::make_shared<EssenceInfo>(dstTags);
+  ContextPool<tWarmDecoder> &pool = ContextPool<tWarmDecoder>::instance();
+  std::string key = warmKey(*srcInfo, *dstInfo);
+  while (pool.numIdle(key) < std::min(count, pool.maxIdle())) {
+    std::shared_ptr<tWarmDecoder> warm = std::make_shared<tWarmDecoder>();
+    // drivers report setup errors as JS exceptions
+    Nan::TryCatch try_catch;
+    try {
+      warm->driver = DriverRegistry::instance().createDecoder(srcInfo, dstInfo, &warm->driverName);
+    } catch (std::exception& err) {
+      Nan::ThrowError(err.what());
+    }
+    if (try_catch.HasCaught()) {
+      try_catch.ReThrow();
+      break;
+    }
+    pool.give(key, warm);
+  }
+  return pool.numIdle(key);
+}
+
 void Decoder::doSetInfo(Local<Object> srcTags, Local<Object> dstTags) {
   mSrcVidInfo = std::make_shared<EssenceInfo>(srcTags); 
   printDebug(eInfo, "Decoder SrcVidInfo: %s\n", mSrcVidInfo->toString().c_str());
   mDstVidInfo = std::make_shared<EssenceInfo>(dstTags); 
   printDebug(eInfo, "Decoder DstVidInfo: %s\n", mDstVidInfo->toString().c_str());
 
-  if (mSrcVidInfo->encodingName().compare("h264") && mSrcVidInfo->encodingName().compare("vp8") && 
-      mSrcVidInfo->encodingName().compare("AVCi50") && mSrcVidInfo->encodingName().compare("AVCi100")) {
+  if (!DriverRegistry::instance().hasDecoder(mSrcVidInfo->encodingName())) {
     std::string err = std::string("Unsupported source encoding \'") + mSrcVidInfo->encodingName().c_str() + "\'";
     return Nan::ThrowError(err.c_str());
   }
-  if (mDstVidInfo->packing().compare("420P") && mDstVidInfo->packing().compare("UYVY10")) {
+  if (mDstVidInfo->packing().compare("420P") && mDstVidInfo->packing().compare("UYVY10") &&
+      mDstVidInfo->packing().compare("YUV422P10")) {
     std::string err = std::string("Unsupported packing type \'") + mDstVidInfo->packing() + "\'";
     Nan::ThrowError(err.c_str());
     return;
@@ -89,12 +158,24 @@ void Decoder::doSetInfo(Local<Object> srcTags, Local<Object> dstTags) {
     Nan::ThrowError(err.c_str());
   }
 
-  try {
-    mDecoderDriver = DecoderFactory::createDecoder(mSrcVidInfo, mDstVidInfo);
-  }
-  catch (std::exception& err) {
-    Nan::ThrowError(err.what());
+  // a decoder opened by prewarm, or given back by one set up the same way, is taken in place of
+  // opening one
+  mWarmKey = warmKey(*mSrcVidInfo, *mDstVidInfo);
+  std::shared_ptr<tWarmDecoder> warm = ContextPool<tWarmDecoder>::instance().take(mWarmKey);
+  mWarmStart = !!warm;
+  if (warm) {
+    mDecoderDriver = warm->driver;
+    mDriverName = warm->driverName;
+  } else {
+    try {
+      mDecoderDriver = DriverRegistry::instance().createDecoder(mSrcVidInfo, mDstVidInfo, &mDriverName);
+    }
+    catch (std::exception& err) {
+      return Nan::ThrowError(err.what());
+    }
   }
+  mDriverReset = true;
+  printDebug(eInfo, "Decoder driver: %s%s\n", mDriverName.c_str(), mWarmStart ? " (prewarmed)" : "");
 }
 
 NAN_METHOD(Decoder::SetInfo) {
@@ -149,8 +230,28 @@ NAN_METHOD(Decoder::Decode) {
   }
   Local<Object> srcBuf = Local<Object>::Cast(srcBufArray->Get(0));
 
-  std::shared_ptr<iProcessData> epd = std::make_shared<DecodeProcessData>(srcBuf, dstBuf);
-  obj->mWorker->doFrame(epd, obj, new Nan::Callback(callback));
+  std::shared_ptr<iProcessData> epd = obj->mWorker->makeProcessData<DecodeProcessData>(srcBuf, dstBuf);
+  if (!obj->mWorker->doFrame(epd, obj, callback))
+    return;
+
+  info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
+}
+
+NAN_METHOD(Decoder::Flush) {
+  if (info.Length() != 1)
+    return Nan::ThrowError("Decoder Flush expects 1 argument");
+  if (!info[0]->IsFunction())
+    return Nan::ThrowError("Decoder Flush requires a valid callback as the parameter");
+  Local<Function> callback = Local<Function>::Cast(info[0]);
+
+  Decoder* obj = Nan::ObjectWrap::Unwrap<Decoder>(info.Holder());
+
+  if (!obj->mSetInfoOK)
+    return Nan::ThrowError("Decoder flush called with incorrect setup parameters");
+
+  std::shared_ptr<iProcessData> fpd = obj->mWorker->makeProcessData<FlushProcessData>();
+  if (!obj->mWorker->doFrame(fpd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -163,12 +264,32 @@ NAN_METHOD(Decoder::Quit) {
   Nan::Callback *callback = new Nan::Callback(Local<Function>::Cast(info[0]));
   Decoder* obj = Nan::ObjectWrap::Unwrap<Decoder>(info.Holder());
 
+  if ((obj->mWorker != NULL) && obj->mSetInfoOK) {
+    // the release has nothing to report to its callback
+    Local<Function> noop = Nan::GetFunction(Nan::New<FunctionTemplate>()).ToLocalChecked();
+    obj->mWorker->doFrame(obj->mWorker->makeProcessData<DecodeReleaseProcessData>(), obj, noop);
+  }
   if (obj->mWorker != NULL)
     obj->mWorker->quit(callback);
 
   info.GetReturnValue().SetUndefined();
 }
 
+NAN_METHOD(Decoder::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<Decoder>(info.Holder())->mWorker->setOptions("Decoder", info);
+}
+
+NAN_METHOD(Decoder::Stats) {
+  Decoder* obj = Nan::ObjectWrap::Unwrap<Decoder>(info.Holder());
+  Local<Object> stats = obj->mWorker->stats();
+  // the driver itself is released by the worker on quit
+  if (obj->mSetInfoOK) {
+    Nan::Set(stats, Nan::New("driver").ToLocalChecked(), Nan::New(obj->mDriverName).ToLocalChecked());
+    Nan::Set(stats, Nan::New("warmStart").ToLocalChecked(), Nan::New(obj->mWarmStart));
+  }
+  info.GetReturnValue().Set(stats);
+}
+
 NAN_MODULE_INIT(Decoder::Init) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Decoder").ToLocalChecked());
@@ -176,7 +297,10 @@ NAN_MODULE_INIT(Decoder::Init) {
 
   SetPrototypeMethod(tpl, "setInfo", SetInfo);
   SetPrototypeMethod(tpl, "decode", Decode);
+  SetPrototypeMethod(tpl, "flush", Flush);
   SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Decoder").ToLocalChecked(),
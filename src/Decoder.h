@@ -19,6 +19,7 @@
 #include "iDebug.h"
 #include "iProcess.h"
 #include <memory>
+#include <atomic>
 
 namespace streampunk {
 
@@ -26,12 +27,22 @@ class MyWorker;
 class iDecoderDriver;
 class EssenceInfo;
 
+// a decoder opened by prewarm, or given back by a decoder that has finished with it
+struct tWarmDecoder {
+  std::shared_ptr<iDecoderDriver> driver;
+  std::string driverName;
+};
+
 class Decoder : public Nan::ObjectWrap, public iProcess, public iDebug {
 public:
   static NAN_MODULE_INIT(Init);
 
   // iProcess
   uint32_t processFrame (std::shared_ptr<iProcessData> processData);
+
+  // opens up to count decoders for a later setInfo with the same arguments to take, returning the
+  // number that are then idle - a JS error is thrown if one cannot be opened
+  static uint32_t prewarm(v8::Local<v8::Object> srcTags, v8::Local<v8::Object> dstTags, uint32_t count);
   
 private:
   explicit Decoder(Nan::Callback *callback);
@@ -62,7 +73,10 @@ private:
 
   static NAN_METHOD(SetInfo);
   static NAN_METHOD(Decode);
+  static NAN_METHOD(Flush);
   static NAN_METHOD(Quit);
+  static NAN_METHOD(SetWorkerOptions);
+  static NAN_METHOD(Stats);
 
   MyWorker *mWorker;
   uint32_t mFrameNum;
@@ -70,6 +84,12 @@ private:
   std::shared_ptr<EssenceInfo> mSrcVidInfo;
   std::shared_ptr<EssenceInfo> mDstVidInfo;
   std::shared_ptr<iDecoderDriver> mDecoderDriver;
+  std::string mDriverName;
+  // a decoder that is reset, having decoded nothing since it was opened or flushed, is given back
+  // to the pool under this key on quit - set by setInfo, then changed by the worker
+  std::string mWarmKey;
+  std::atomic<bool> mDriverReset;
+  bool mWarmStart;
 };
 
 } // namespace streampunk
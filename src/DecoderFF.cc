@@ -18,6 +18,8 @@
 #include "Memory.h"
 #include "Packers.h"
 #include "EssenceInfo.h"
+#include "FramePool.h"
+#include "FFmpegInit.h"
 
 extern "C" {
   #include <libavutil/opt.h>
@@ -25,14 +27,20 @@ extern "C" {
   #include <libavutil/imgutils.h>
 }
 
+// the send/receive API, which returns any number of pictures for each packet, is used when the
+// libavcodec build provides it - the bundled libavcodec 57.28 does not, so this path is only
+// compiled against a newer FFmpeg
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+#define DECODERFF_SEND_RECEIVE
+#endif
+
 namespace streampunk {
 
 DecoderFF::DecoderFF(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo)
   : mSrcEncoding(srcInfo->encodingName()), mDstPacking(dstInfo->packing()), mWidth(srcInfo->width()), mHeight(srcInfo->height()),
     mPixFmt((uint32_t)AV_PIX_FMT_YUV420P), mCodec(NULL), mContext(NULL), mFrame(NULL) {
 
-  avcodec_register_all();
-  av_log_set_level(AV_LOG_INFO);
+  initFFmpeg();
 
   AVCodecID codecID = AV_CODEC_ID_NONE;
   if (!mSrcEncoding.compare("h264"))
@@ -56,6 +64,9 @@ DecoderFF::DecoderFF(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<Essen
   mContext->width = mWidth;
   mContext->height = mHeight;
   mContext->refcounted_frames = 1;
+  mContext->opaque = this;
+  mContext->get_buffer2 = getBuffer;
+  mContext->thread_safe_callbacks = 1;
 
   if (avcodec_open2(mContext, mCodec, NULL) < 0) {
     Nan::ThrowError("Could not open codec");
@@ -75,34 +86,177 @@ DecoderFF::~DecoderFF() {
   av_free(mContext);
 }
 
+static void releaseFrameBuf(void *opaque, uint8_t *data) {
+  delete (std::shared_ptr<Memory> *)opaque;
+}
+
+// A decoded picture is exposed without a copy when its planes are contiguous packed 420P and the
+// decoder no longer holds it as a reference picture - JS may then write to it freely
+static bool isPacked420P(const AVFrame *frame) {
+  uint32_t lumaBytes = frame->width * frame->height;
+  uint32_t chromaBytes = lumaBytes / 4;
+  return (AV_PIX_FMT_YUV420P == frame->format) && frame->buf[0] && !frame->buf[1] &&
+         (frame->linesize[0] == frame->width) && (frame->linesize[1] == frame->width / 2) && (frame->linesize[2] == frame->width / 2) &&
+         (frame->data[0] >= frame->buf[0]->data) && (frame->data[1] == frame->data[0] + lumaBytes) && (frame->data[2] == frame->data[1] + chromaBytes) &&
+         (frame->data[2] + chromaBytes <= frame->buf[0]->data + frame->buf[0]->size);
+}
+
+// Reference and output pictures are allocated from the frame pool, laid out as 420P planes of the
+// coded size, which is the output size rounded up to whole 16 line macroblocks. Where the two
+// are the same the planes are packed and output can be handed out directly - otherwise, for
+// example 1080 line h264 which is coded as 1088 lines, the output is a cropped view of the planes
+// and is copied. The line pitches must also meet the decoder's alignment requirements, or
+// libavcodec allocates.
+int DecoderFF::getBuffer(AVCodecContext *context, AVFrame *frame, int flags) {
+  DecoderFF *decoder = (DecoderFF *)context->opaque;
+  int width = frame->width;
+  int height = frame->height;
+  int codedHeight = FFALIGN(decoder->mHeight, 16);
+  if ((AV_PIX_FMT_YUV420P != frame->format) || !(context->codec->capabilities & AV_CODEC_CAP_DR1) ||
+      ((uint32_t)width != decoder->mWidth) || (width % 16) || ((uint32_t)height < decoder->mHeight) || (height > codedHeight))
+    return avcodec_default_get_buffer2(context, frame, flags);
+
+  int alignedWidth = width;
+  int alignedHeight = height;
+  int linesizeAlign[AV_NUM_DATA_POINTERS];
+  avcodec_align_dimensions2(context, &alignedWidth, &alignedHeight, linesizeAlign);
+  if ((alignedWidth != width) || (width % linesizeAlign[0]) || ((width / 2) % linesizeAlign[1]) || ((width / 2) % linesizeAlign[2]))
+    return avcodec_default_get_buffer2(context, frame, flags);
+
+  // the decoder writes whole macroblocks, so each plane holds the coded size - some motion
+  // compensation reads run past the end of the aligned size, so pad the allocation
+  uint32_t lumaBytes = width * codedHeight;
+  uint32_t chromaBytes = lumaBytes / 4;
+  uint32_t padBytes = (alignedHeight > codedHeight ? alignedHeight - codedHeight : 0) * width + AV_INPUT_BUFFER_PADDING_SIZE;
+  std::shared_ptr<Memory> frameBuf = FramePool::instance().acquire(lumaBytes + chromaBytes * 2 + padBytes);
+  if (!frameBuf)
+    return AVERROR(ENOMEM);
+
+  std::shared_ptr<Memory> *opaque = new std::shared_ptr<Memory>(frameBuf);
+  frame->buf[0] = av_buffer_create(frameBuf->buf(), frameBuf->numBytes(), releaseFrameBuf, opaque, 0);
+  if (!frame->buf[0]) {
+    delete opaque;
+    return AVERROR(ENOMEM);
+  }
+
+  frame->data[0] = frameBuf->buf();
+  frame->data[1] = frame->data[0] + lumaBytes;
+  frame->data[2] = frame->data[1] + chromaBytes;
+  frame->linesize[0] = width;
+  frame->linesize[1] = width / 2;
+  frame->linesize[2] = width / 2;
+  frame->extended_data = frame->data;
+  return 0;
+}
+
 uint32_t DecoderFF::bytesReq() const {
   return mWidth * mHeight * 3 / 2;
 }
 
-void DecoderFF::decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, 
-                             uint32_t frameNum, uint32_t *pDstBytes) {
+void DecoderFF::decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                             std::vector<std::shared_ptr<Memory> > &frameBufs) {
+  *pDstBytes = 0;
   AVPacket pkt;
   av_init_packet(&pkt);
   pkt.data = srcBuf->buf();
   pkt.size = srcBuf->numBytes();
-  int got_output;
-  int bytesUsed = avcodec_decode_video2(mContext, mFrame, &got_output, &pkt);
 
-  if (bytesUsed <= 0) {
-    printf("Failed to decode\n");
-    *pDstBytes = 0;
+#ifdef DECODERFF_SEND_RECEIVE
+  if (avcodec_send_packet(mContext, &pkt) < 0)
+    throw std::runtime_error("DecoderFF failed to decode packet");
+  receiveFrames(dstBuf, pDstBytes, frameBufs);
+#else
+  // each call decodes at most one picture, so a packet holding more than one, for example with
+  // packed B-frames, is decoded in parts
+  while (pkt.size > 0) {
+    int got_output = 0;
+    int bytesUsed = avcodec_decode_video2(mContext, mFrame, &got_output, &pkt);
+    if (bytesUsed < 0)
+      throw std::runtime_error("DecoderFF failed to decode packet");
+    if (got_output)
+      outputFrame((*pDstBytes || !frameBufs.empty()) ? std::shared_ptr<Memory>() : dstBuf, pDstBytes, frameBufs);
+    av_frame_unref(mFrame);
+    if (!bytesUsed && !got_output)
+      break;
+    pkt.data += bytesUsed;
+    pkt.size -= bytesUsed;
   }
-  else {
-    uint32_t lumaBytes = mFrame->width * mFrame->height;
-    uint32_t chromaBytes = lumaBytes / 4;
-    memcpy(dstBuf->buf(), mFrame->data[0], lumaBytes);
-    memcpy(dstBuf->buf() + lumaBytes, mFrame->data[1], chromaBytes);
-    memcpy(dstBuf->buf() + lumaBytes + chromaBytes, mFrame->data[2], chromaBytes);
-    *pDstBytes = lumaBytes + chromaBytes * 2;
+#endif
+}
+
+void DecoderFF::flush (std::vector<std::shared_ptr<Memory> > &dstBufs) {
+  uint32_t dstBytes = 0;
+#ifdef DECODERFF_SEND_RECEIVE
+  if (avcodec_send_packet(mContext, NULL) >= 0)
+    receiveFrames(std::shared_ptr<Memory>(), &dstBytes, dstBufs);
+#else
+  // an empty packet asks the decoder for the next of the pictures it has held back
+  AVPacket pkt;
+  av_init_packet(&pkt);
+  pkt.data = NULL;
+  pkt.size = 0;
+  int got_output = 1;
+  while (got_output) {
+    if (avcodec_decode_video2(mContext, mFrame, &got_output, &pkt) < 0)
+      got_output = 0;
+    if (got_output)
+      outputFrame(std::shared_ptr<Memory>(), &dstBytes, dstBufs);
+    av_frame_unref(mFrame);
+  }
+#endif
+
+  // ready to decode a new stream
+  avcodec_flush_buffers(mContext);
+}
+
+// private
+#ifdef DECODERFF_SEND_RECEIVE
+// collects every picture the decoder has ready - there may be none, or several
+void DecoderFF::receiveFrames(std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes, std::vector<std::shared_ptr<Memory> > &frameBufs) {
+  while (0 == avcodec_receive_frame(mContext, mFrame)) {
+    outputFrame((*pDstBytes || !frameBufs.empty()) ? std::shared_ptr<Memory>() : dstBuf, pDstBytes, frameBufs);
+    av_frame_unref(mFrame);
+  }
+}
+#endif
+
+// A packed picture that is no longer a reference is handed out without a copy, otherwise it is
+// copied into dstBuf or, when there is none or it is too small, into a buffer from the frame pool
+void DecoderFF::outputFrame(std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes, std::vector<std::shared_ptr<Memory> > &frameBufs) {
+  uint32_t lumaBytes = mFrame->width * mFrame->height;
+  uint32_t chromaBytes = lumaBytes / 4;
+  // the picture is writable when this frame holds the only reference to it, so the decoder will
+  // not predict from it again
+  if (isPacked420P(mFrame) && av_buffer_is_writable(mFrame->buf[0])) {
+    // hold a reference to the picture until the memory exposing it is released
+    AVBufferRef *frameRef = av_buffer_ref(mFrame->buf[0]);
+    if (frameRef) {
+      frameBufs.push_back(std::shared_ptr<Memory>(new Memory(mFrame->data[0], lumaBytes + chromaBytes * 2), [frameRef](Memory *mem) { 
+        AVBufferRef *ref = frameRef;
+        av_buffer_unref(&ref);
+        delete mem;
+      }));
+      return;
+    }
   }
-  
-  av_packet_unref(&pkt);
-  av_frame_unref(mFrame);
+
+  // a picture whose coded size does not fit dstBuf, as when the stream differs from setInfo, is
+  // handed out in a buffer of its own rather than overrun it
+  uint32_t pictureBytes = lumaBytes + chromaBytes * 2;
+  bool toDstBuf = dstBuf && (dstBuf->numBytes() >= pictureBytes);
+  std::shared_ptr<Memory> copyBuf = toDstBuf ? dstBuf : FramePool::instance().acquire(pictureBytes);
+  if (!copyBuf)
+    throw std::runtime_error("Failed to allocate buffer for decoded picture");
+  uint8_t *dstPlane = copyBuf->buf();
+  av_image_copy_plane(dstPlane, mFrame->width, mFrame->data[0], mFrame->linesize[0], mFrame->width, mFrame->height);
+  dstPlane += lumaBytes;
+  av_image_copy_plane(dstPlane, mFrame->width / 2, mFrame->data[1], mFrame->linesize[1], mFrame->width / 2, mFrame->height / 2);
+  dstPlane += chromaBytes;
+  av_image_copy_plane(dstPlane, mFrame->width / 2, mFrame->data[2], mFrame->linesize[2], mFrame->width / 2, mFrame->height / 2);
+  if (toDstBuf)
+    *pDstBytes = pictureBytes;
+  else
+    frameBufs.push_back(copyBuf);
 }
 
 } // namespace streampunk
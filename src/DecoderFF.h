@@ -17,6 +17,7 @@
 #define DECODERFF_H
 
 #include <memory>
+#include <vector>
 #include "iCodecDriver.h"
 
 struct AVCodec;
@@ -37,9 +38,15 @@ public:
   uint32_t height() const { return mHeight; }
   uint32_t pixFmt() const { return mPixFmt; }
   
-  void decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes);
+  void decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                    std::vector<std::shared_ptr<Memory> > &frameBufs);
+  void flush (std::vector<std::shared_ptr<Memory> > &dstBufs);
 
 private:
+  static int getBuffer(AVCodecContext *context, AVFrame *frame, int flags);
+  void receiveFrames(std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes, std::vector<std::shared_ptr<Memory> > &frameBufs);
+  void outputFrame(std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes, std::vector<std::shared_ptr<Memory> > &frameBufs);
+
   std::string mSrcEncoding;
   std::string mDstPacking;
   const uint32_t mWidth;
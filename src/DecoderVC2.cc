@@ -0,0 +1,155 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <nan.h>
+#include "DecoderVC2.h"
+#include "Memory.h"
+#include "EssenceInfo.h"
+#include "FramePool.h"
+#include "FFmpegInit.h"
+#include <algorithm>
+#include <thread>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+  #include <libavutil/imgutils.h>
+}
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+#define DECODERVC2_SEND_RECEIVE
+#endif
+
+namespace streampunk {
+
+DecoderVC2::DecoderVC2(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo)
+  : mWidth(srcInfo->width()), mHeight(srcInfo->height()), mCodec(NULL), mContext(NULL), mFrame(NULL) {
+
+  initFFmpeg();
+
+  mCodec = avcodec_find_decoder(AV_CODEC_ID_DIRAC);
+  if (!mCodec) {
+    Nan::ThrowError("Decoder for format \'vc2\' not found");
+    return;
+  }
+
+  mContext = avcodec_alloc_context3(mCodec);
+  if (!mContext) {
+    Nan::ThrowError("Could not allocate video codec context");
+    return;
+  }
+
+  mContext->width = mWidth;
+  mContext->height = mHeight;
+  mContext->refcounted_frames = 1;
+  // low delay pictures are decoded a slice at a time across the threads
+  mContext->thread_count = std::min(16U, std::max(1U, std::thread::hardware_concurrency()));
+  mContext->thread_type = FF_THREAD_SLICE;
+
+  if (avcodec_open2(mContext, mCodec, NULL) < 0) {
+    Nan::ThrowError("Could not open codec");
+    return;
+  }
+
+  mFrame = av_frame_alloc();
+  if (!mFrame) {
+    Nan::ThrowError("Could not allocate video frame");
+    return;
+  }
+}
+
+DecoderVC2::~DecoderVC2() {
+  av_frame_free(&mFrame);
+  avcodec_close(mContext);
+  av_free(mContext);
+}
+
+void DecoderVC2::decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                              std::vector<std::shared_ptr<Memory> > &frameBufs) {
+  *pDstBytes = 0;
+  AVPacket pkt;
+  av_init_packet(&pkt);
+  pkt.data = srcBuf->buf();
+  pkt.size = srcBuf->numBytes();
+
+#ifdef DECODERVC2_SEND_RECEIVE
+  if (avcodec_send_packet(mContext, &pkt) < 0)
+    throw std::runtime_error("DecoderVC2 failed to decode");
+  while (0 == avcodec_receive_frame(mContext, mFrame)) {
+    outputFrame((*pDstBytes || !frameBufs.empty()) ? std::shared_ptr<Memory>() : dstBuf, pDstBytes, frameBufs);
+    av_frame_unref(mFrame);
+  }
+#else
+  int got_output = 0;
+  int bytesUsed = avcodec_decode_video2(mContext, mFrame, &got_output, &pkt);
+  if (bytesUsed < 0)
+    throw std::runtime_error("DecoderVC2 failed to decode");
+  if (got_output)
+    outputFrame(dstBuf, pDstBytes, frameBufs);
+  av_frame_unref(mFrame);
+#endif
+}
+
+void DecoderVC2::flush (std::vector<std::shared_ptr<Memory> > &dstBufs) {
+  // pictures are intra only but the decoder may still hold the last for output ordering
+  uint32_t dstBytes = 0;
+#ifdef DECODERVC2_SEND_RECEIVE
+  if (avcodec_send_packet(mContext, NULL) >= 0) {
+    while (0 == avcodec_receive_frame(mContext, mFrame)) {
+      outputFrame(std::shared_ptr<Memory>(), &dstBytes, dstBufs);
+      av_frame_unref(mFrame);
+    }
+  }
+#else
+  AVPacket pkt;
+  av_init_packet(&pkt);
+  pkt.data = NULL;
+  pkt.size = 0;
+  int got_output = 1;
+  while (got_output) {
+    if (avcodec_decode_video2(mContext, mFrame, &got_output, &pkt) < 0)
+      got_output = 0;
+    if (got_output)
+      outputFrame(std::shared_ptr<Memory>(), &dstBytes, dstBufs);
+    av_frame_unref(mFrame);
+  }
+#endif
+
+  // ready to decode a new stream
+  avcodec_flush_buffers(mContext);
+}
+
+// private
+void DecoderVC2::outputFrame(std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes, std::vector<std::shared_ptr<Memory> > &frameBufs) {
+  if ((AV_PIX_FMT_YUV422P10 != mFrame->format) || ((uint32_t)mFrame->width != mWidth) || ((uint32_t)mFrame->height != mHeight))
+    throw std::runtime_error("DecoderVC2 picture is not YUV422P10 at the configured size");
+
+  uint32_t lumaPitchBytes = mWidth * 2;
+  uint32_t chromaPitchBytes = mWidth;
+  std::shared_ptr<Memory> copyBuf = dstBuf ? dstBuf : FramePool::instance().acquire(bytesReq());
+  if (!copyBuf)
+    throw std::runtime_error("Failed to allocate buffer for decoded picture");
+  uint8_t *dstPlane = copyBuf->buf();
+  av_image_copy_plane(dstPlane, lumaPitchBytes, mFrame->data[0], mFrame->linesize[0], lumaPitchBytes, mHeight);
+  dstPlane += lumaPitchBytes * mHeight;
+  av_image_copy_plane(dstPlane, chromaPitchBytes, mFrame->data[1], mFrame->linesize[1], chromaPitchBytes, mHeight);
+  dstPlane += chromaPitchBytes * mHeight;
+  av_image_copy_plane(dstPlane, chromaPitchBytes, mFrame->data[2], mFrame->linesize[2], chromaPitchBytes, mHeight);
+  if (dstBuf)
+    *pDstBytes = bytesReq();
+  else
+    frameBufs.push_back(copyBuf);
+}
+
+} // namespace streampunk
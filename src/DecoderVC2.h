@@ -0,0 +1,57 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef DECODERVC2_H
+#define DECODERVC2_H
+
+#include <memory>
+#include <vector>
+#include "iCodecDriver.h"
+
+struct AVCodec;
+struct AVCodecContext;
+struct AVFrame;
+
+namespace streampunk {
+
+class Memory;
+class EssenceInfo;
+
+// VC-2 (SMPTE 2042) decoder, using libavcodec's dirac decoder with slice threading. Pictures are
+// output as YUV422P10.
+class DecoderVC2 : public iDecoderDriver {
+public:
+  DecoderVC2(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo);
+  ~DecoderVC2();
+
+  uint32_t bytesReq() const  { return mWidth * mHeight * 4; }
+
+  void decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                    std::vector<std::shared_ptr<Memory> > &frameBufs);
+  void flush (std::vector<std::shared_ptr<Memory> > &dstBufs);
+
+private:
+  void outputFrame(std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes, std::vector<std::shared_ptr<Memory> > &frameBufs);
+
+  const uint32_t mWidth;
+  const uint32_t mHeight;
+  AVCodec *mCodec;
+  AVCodecContext *mContext;
+  AVFrame *mFrame;
+};
+
+} // namespace streampunk
+
+#endif
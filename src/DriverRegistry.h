@@ -0,0 +1,288 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef DRIVERREGISTRY_H
+#define DRIVERREGISTRY_H
+
+#include <nan.h>
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include "iCodecDriver.h"
+#include "EssenceInfo.h"
+#include "EncodeParams.h"
+#include "EncoderFF.h"
+#include "DecoderFF.h"
+#include "EncoderVC2.h"
+#include "DecoderVC2.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace v8;
+
+namespace streampunk {
+
+class DriverRegistry;
+
+// A driver library exports these two functions, built against the same codecadon headers. The
+// version is checked before the library is asked to register its drivers.
+#define CODECADON_DRIVER_API_VERSION 2
+typedef uint32_t (*tDriverApiVersionFn)();
+typedef void (*tRegisterDriversFn)(DriverRegistry *registry);
+
+// Encoder and decoder drivers, registered by codec name. Where more than one driver is registered
+// for a codec, setInfo chooses the one with the highest priority that supports the formats, so a
+// tuned implementation registers with a higher priority than the FFmpeg drivers built in at zero.
+class DriverRegistry {
+public:
+  typedef std::function<std::shared_ptr<iEncoderDriver>(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo,
+                                                        const Duration& duration, std::shared_ptr<EncodeParams> encodeParams)> tCreateEncoderFn;
+  typedef std::function<std::shared_ptr<iDecoderDriver>(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo)> tCreateDecoderFn;
+  // returns false for formats the driver cannot handle - a driver without one supports all formats of its codec
+  typedef std::function<bool(const EssenceInfo &srcInfo, const EssenceInfo &dstInfo)> tSupportsFn;
+
+  static DriverRegistry &instance() {
+    // deliberately never destroyed, as loaded driver libraries are never unloaded
+    static DriverRegistry *registry = new DriverRegistry;
+    return *registry;
+  }
+
+  void registerEncoder(const std::string &name, const std::string &codec, int32_t priority,
+                       tCreateEncoderFn create, tSupportsFn supports = tSupportsFn()) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mEncoders.push_back(tEncoderEntry { tEntry { name, codec, priority, supports, mLoadingLibrary }, create });
+    std::stable_sort(mEncoders.begin(), mEncoders.end(), byPriority<tEncoderEntry>);
+  }
+
+  void registerDecoder(const std::string &name, const std::string &codec, int32_t priority,
+                       tCreateDecoderFn create, tSupportsFn supports = tSupportsFn()) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mDecoders.push_back(tDecoderEntry { tEntry { name, codec, priority, supports, mLoadingLibrary }, create });
+    std::stable_sort(mDecoders.begin(), mDecoders.end(), byPriority<tDecoderEntry>);
+  }
+
+  bool hasEncoder(const std::string &codec) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    return find(mEncoders, codec, NULL, NULL) != NULL;
+  }
+  bool hasDecoder(const std::string &codec) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    return find(mDecoders, codec, NULL, NULL) != NULL;
+  }
+
+  // encoders are chosen by destination encoding name and decoders by source encoding name -
+  // pDriverName is set to the name of the driver chosen
+  std::shared_ptr<iEncoderDriver> createEncoder(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo,
+                                                const Duration& duration, std::shared_ptr<EncodeParams> encodeParams,
+                                                std::string *pDriverName = NULL) {
+    tCreateEncoderFn create;
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      const tEncoderEntry *entry = find(mEncoders, dstInfo->encodingName(), srcInfo.get(), dstInfo.get());
+      if (!entry)
+        throw std::runtime_error(std::string("No encoder driver available for \'") + dstInfo->encodingName() + "\' with these formats");
+      create = entry->create;
+      if (pDriverName)
+        *pDriverName = entry->info.name;
+    }
+    return create(srcInfo, dstInfo, duration, encodeParams);
+  }
+
+  std::shared_ptr<iDecoderDriver> createDecoder(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo,
+                                                std::string *pDriverName = NULL) {
+    tCreateDecoderFn create;
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      const tDecoderEntry *entry = find(mDecoders, srcInfo->encodingName(), srcInfo.get(), dstInfo.get());
+      if (!entry)
+        throw std::runtime_error(std::string("No decoder driver available for \'") + srcInfo->encodingName() + "\' with these formats");
+      create = entry->create;
+      if (pDriverName)
+        *pDriverName = entry->info.name;
+    }
+    return create(srcInfo, dstInfo);
+  }
+
+  // loads a driver library, which stays loaded for the life of the process, returning the number
+  // of drivers it registered. A library that fails to load is unloaded again, along with any
+  // drivers it registered before failing
+  uint32_t loadLibrary(const std::string &path) {
+    std::lock_guard<std::mutex> loadLk(mLoadMtx);
+    if (std::find(mLibraries.begin(), mLibraries.end(), path) != mLibraries.end())
+      throw std::runtime_error(std::string("Driver library \'") + path + "\' is already loaded");
+#ifdef _WIN32
+    HMODULE handle = LoadLibraryA(path.c_str());
+    if (!handle)
+      throw std::runtime_error(std::string("Failed to load driver library \'") + path + "\'");
+    tDriverApiVersionFn versionFn = (tDriverApiVersionFn)GetProcAddress(handle, "codecadonDriverApiVersion");
+    tRegisterDriversFn registerFn = (tRegisterDriversFn)GetProcAddress(handle, "codecadonRegisterDrivers");
+#else
+    void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+      throw std::runtime_error(std::string("Failed to load driver library: ") + dlerror());
+    tDriverApiVersionFn versionFn = (tDriverApiVersionFn)dlsym(handle, "codecadonDriverApiVersion");
+    tRegisterDriversFn registerFn = (tRegisterDriversFn)dlsym(handle, "codecadonRegisterDrivers");
+#endif
+    if (!versionFn || !registerFn) {
+      closeLibrary(handle);
+      throw std::runtime_error(std::string("Driver library \'") + path + "\' does not export the codecadon driver functions");
+    }
+    uint32_t apiVersion = versionFn();
+    if (CODECADON_DRIVER_API_VERSION != apiVersion) {
+      closeLibrary(handle);
+      throw std::runtime_error(std::string("Driver library \'") + path + "\' was built for driver API version " +
+                               std::to_string(apiVersion) + ", expected " + std::to_string(CODECADON_DRIVER_API_VERSION));
+    }
+
+    // registration locks for each driver, so the library being loaded is recorded separately
+    size_t numDrivers = numRegistered();
+    setLoadingLibrary(path);
+    try {
+      registerFn(this);
+    } catch (...) {
+      setLoadingLibrary("");
+      // the create functions of its drivers are code in the library, so they go before it does
+      unregisterLibrary(path);
+      closeLibrary(handle);
+      throw;
+    }
+    setLoadingLibrary("");
+    mLibraries.push_back(path);
+    return (uint32_t)(numRegistered() - numDrivers);
+  }
+
+  void addDrivers(Local<Array> drivers) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    uint32_t i = 0;
+    for (auto& e : mEncoders)
+      Nan::Set(drivers, i++, driverObject(e.info, "encoder"));
+    for (auto& d : mDecoders)
+      Nan::Set(drivers, i++, driverObject(d.info, "decoder"));
+  }
+
+private:
+  struct tEntry {
+    std::string name;
+    std::string codec;
+    int32_t priority;
+    tSupportsFn supports;
+    std::string library;
+  };
+  struct tEncoderEntry {
+    tEntry info;
+    tCreateEncoderFn create;
+  };
+  struct tDecoderEntry {
+    tEntry info;
+    tCreateDecoderFn create;
+  };
+
+  DriverRegistry() {
+    // the built in drivers, over FFmpeg
+    tCreateEncoderFn createEncoderFF = [](std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo,
+                                          const Duration& duration, std::shared_ptr<EncodeParams> encodeParams) {
+      return std::make_shared<EncoderFF>(srcInfo, dstInfo, duration, encodeParams);
+    };
+    tCreateDecoderFn createDecoderFF = [](std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo) {
+      return std::make_shared<DecoderFF>(srcInfo, dstInfo);
+    };
+    registerEncoder("ffmpeg", "h264", 0, createEncoderFF);
+    registerEncoder("ffmpeg", "vp8", 0, createEncoderFF);
+    registerEncoder("ffmpeg", "AAC", 0, createEncoderFF);
+    // the FFmpeg decoders take 420P or UYVY10 destinations, leaving YUV422P10 to the VC-2 driver
+    tSupportsFn supportsDecoderFF = [](const EssenceInfo &srcInfo, const EssenceInfo &dstInfo) {
+      return (0 == dstInfo.packing().compare("420P")) || (0 == dstInfo.packing().compare("UYVY10"));
+    };
+    registerDecoder("ffmpeg", "h264", 0, createDecoderFF, supportsDecoderFF);
+    registerDecoder("ffmpeg", "vp8", 0, createDecoderFF, supportsDecoderFF);
+
+    // VC-2 pictures are YUV422P10 in and out
+    registerEncoder("ffmpeg-vc2", "vc2", 0,
+      [](std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo, const Duration& duration, std::shared_ptr<EncodeParams> encodeParams) {
+        return std::make_shared<EncoderVC2>(srcInfo, dstInfo, duration, encodeParams);
+      });
+    registerDecoder("ffmpeg-vc2", "vc2", 0,
+      [](std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo) {
+        return std::make_shared<DecoderVC2>(srcInfo, dstInfo);
+      },
+      [](const EssenceInfo &srcInfo, const EssenceInfo &dstInfo) { return 0 == dstInfo.packing().compare("YUV422P10"); });
+  }
+
+  template <class T>
+  static bool byPriority(const T &a, const T &b) { return a.info.priority > b.info.priority; }
+
+  // the highest priority entry for the codec that supports the formats, if they are given
+  template <class T>
+  static const T *find(const std::vector<T> &entries, const std::string &codec, const EssenceInfo *srcInfo, const EssenceInfo *dstInfo) {
+    for (auto& e : entries)
+      if (!e.info.codec.compare(codec) && (!srcInfo || !e.info.supports || e.info.supports(*srcInfo, *dstInfo)))
+        return &e;
+    return NULL;
+  }
+
+  size_t numRegistered() {
+    std::lock_guard<std::mutex> lk(mMtx);
+    return mEncoders.size() + mDecoders.size();
+  }
+
+  void unregisterLibrary(const std::string &path) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mEncoders.erase(std::remove_if(mEncoders.begin(), mEncoders.end(),
+                                   [&path](const tEncoderEntry &e) { return !e.info.library.compare(path); }), mEncoders.end());
+    mDecoders.erase(std::remove_if(mDecoders.begin(), mDecoders.end(),
+                                   [&path](const tDecoderEntry &d) { return !d.info.library.compare(path); }), mDecoders.end());
+  }
+
+#ifdef _WIN32
+  static void closeLibrary(HMODULE handle) { FreeLibrary(handle); }
+#else
+  static void closeLibrary(void *handle) { dlclose(handle); }
+#endif
+
+  void setLoadingLibrary(const std::string &path) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mLoadingLibrary = path;
+  }
+
+  static Local<Object> driverObject(const tEntry &entry, const char *type) {
+    Local<Object> driver = Nan::New<Object>();
+    Nan::Set(driver, Nan::New("name").ToLocalChecked(), Nan::New(entry.name).ToLocalChecked());
+    Nan::Set(driver, Nan::New("type").ToLocalChecked(), Nan::New(type).ToLocalChecked());
+    Nan::Set(driver, Nan::New("codec").ToLocalChecked(), Nan::New(entry.codec).ToLocalChecked());
+    Nan::Set(driver, Nan::New("priority").ToLocalChecked(), Nan::New(entry.priority));
+    if (!entry.library.empty())
+      Nan::Set(driver, Nan::New("library").ToLocalChecked(), Nan::New(entry.library).ToLocalChecked());
+    return driver;
+  }
+
+  std::mutex mMtx;
+  std::mutex mLoadMtx;
+  std::vector<tEncoderEntry> mEncoders;
+  std::vector<tDecoderEntry> mDecoders;
+  std::string mLoadingLibrary;
+  std::vector<std::string> mLibraries;
+};
+
+} // namespace streampunk
+
+#endif
@@ -18,6 +18,9 @@
 
 #include <nan.h>
 #include <sstream>
+#include <stdexcept>
+#include <mutex>
+#include <atomic>
 #include "Params.h"
 
 using namespace v8;
@@ -29,26 +32,155 @@ public:
   EncodeParams(Local<Object> tags, bool isVideo)
     : mIsVideo(isVideo),
       mBitrate(unpackNum(tags, "bitrate", mIsVideo?5000000:128000)),
-      mGopFrames(unpackNum(tags, "gopFrames", mIsVideo?90:0))
-  {}
+      mGopFrames(unpackNum(tags, "gopFrames", mIsVideo?90:0)),
+      mThreads(unpackNum(tags, "threads", 0)),
+      mThreadType(unpackStr(tags, "threadType", "auto")),
+      mProfile(unpackStr(tags, "profile", "baseline")),
+      mSliceMode(unpackStr(tags, "sliceMode", "auto")),
+      mSlices(unpackNum(tags, "slices", 0)),
+      mDeadline(unpackStr(tags, "deadline", "")),
+      mCpuUsed(unpackNum(tags, "cpuUsed", 1)),
+      mOutput(unpackStr(tags, "output", "packet")),
+      mMode(unpackStr(tags, "mode", "live")),
+      mPass(unpackNum(tags, "pass", 0)),
+      mPassStats(unpackStr(tags, "passStats", "")),
+      mEffectiveThreads(0)
+  {
+    if (mThreadType.compare("auto") && mThreadType.compare("frame") && mThreadType.compare("slice"))
+      throw std::runtime_error(std::string("Encode threadType must be auto, frame or slice - received \'") + mThreadType + "\'");
+    if (mSliceMode.compare("auto") && mSliceMode.compare("fixed") && mSliceMode.compare("rowmb") && mSliceMode.compare("dyn"))
+      throw std::runtime_error(std::string("Encode sliceMode must be auto, fixed, rowmb or dyn - received \'") + mSliceMode + "\'");
+    if (!mDeadline.empty() && mDeadline.compare("best") && mDeadline.compare("good") && mDeadline.compare("realtime"))
+      throw std::runtime_error(std::string("Encode deadline must be best, good or realtime - received \'") + mDeadline + "\'");
+    if (mCpuUsed > 16)
+      throw std::runtime_error(std::string("Encode cpuUsed must be in the range 0-16 - received ") + std::to_string(mCpuUsed));
+    if (mOutput.compare("packet") && mOutput.compare("gop") && mOutput.compare("external"))
+      throw std::runtime_error(std::string("Encode output must be packet, gop or external - received '") + mOutput + "'");
+    if (!mIsVideo && !mOutput.compare("gop"))
+      throw std::runtime_error("Encode output gop is only supported for video");
+    if (mMode.compare("live") && mMode.compare("file"))
+      throw std::runtime_error(std::string("Encode mode must be live or file - received '") + mMode + "'");
+    if (!mIsVideo && !mMode.compare("file"))
+      throw std::runtime_error("Encode mode file is only supported for video");
+    if (mPass > 2)
+      throw std::runtime_error(std::string("Encode pass must be 0, 1 or 2 - received ") + std::to_string(mPass));
+    if (mPass && mMode.compare("file"))
+      throw std::runtime_error("Encode pass requires mode file");
+    if ((2 == mPass) && mPassStats.empty())
+      throw std::runtime_error("Encode pass 2 requires the passStats from pass 1");
+  }
   ~EncodeParams() {}
 
   uint32_t bitrate() const  { return mBitrate; }
   uint32_t gopFrames() const  { return mGopFrames; }
+  // threads of zero is one per core
+  uint32_t threads() const  { return mThreads; }
+  std::string threadType() const  { return mThreadType; }
+  // h264 options, passed to openh264
+  std::string profile() const  { return mProfile; }
+  std::string sliceMode() const  { return mSliceMode; }
+  uint32_t slices() const  { return mSlices; }
+  // vp8 speed options, passed to libvpx - an empty deadline leaves the library default
+  std::string deadline() const  { return mDeadline; }
+  uint32_t cpuUsed() const  { return mCpuUsed; }
+  // packets are returned one at a time in the destination buffer, aggregated into a buffer per GOP,
+  // or each in a buffer of its own from the encoder
+  std::string output() const  { return mOutput; }
+  // live encodes for latency, file looks ahead for size where the encoder supports it, with
+  // optional two-pass rate control - pass is 0 for a single pass, and passStats is the
+  // analysis from pass 1 when running pass 2
+  std::string mode() const  { return mMode; }
+  uint32_t pass() const  { return mPass; }
+  std::string passStats() const  { return mPassStats; }
+
+  // a new bitrate and GOP length for the running encoder, either of which may be left out, in
+  // which case it is kUnchanged. The tags are read on the JS thread, and the settings changed by
+  // the worker once the encoder has taken them
+  static const uint32_t kUnchanged = UINT32_MAX;
+  void unpackRate(Local<Object> tags, uint32_t *pBitrate, uint32_t *pGopFrames) {
+    *pBitrate = unpackNum(tags, "bitrate", kUnchanged);
+    *pGopFrames = unpackNum(tags, "gopFrames", kUnchanged);
+  }
+  void setRate(uint32_t bitrate, uint32_t gopFrames) {
+    mBitrate = bitrate;
+    mGopFrames = gopFrames;
+  }
+
+  // the settings in use once the encoder is open, which may differ from those requested
+  void setEffective(uint32_t threads, const std::string& threadType) {
+    mEffectiveThreads = threads;
+    mEffectiveThreadType = threadType;
+  }
+
+  // the analysis from pass 1, set by the encoder as it is flushed
+  void setFirstPassStats(const std::string& stats) {
+    std::lock_guard<std::mutex> lk(mPassMtx);
+    mFirstPassStats = stats;
+  }
+  std::string firstPassStats() const {
+    std::lock_guard<std::mutex> lk(mPassMtx);
+    return mFirstPassStats;
+  }
 
   std::string toString() const  { 
     std::stringstream ss;
-    if (mIsVideo)
-      ss << "Video encode, bitrate " << mBitrate << ", GOP frames " << mGopFrames;
+    if (mIsVideo) {
+      ss << "Video encode, bitrate " << bitrate() << ", GOP frames " << gopFrames();
+      ss << ", threads " << mThreads << " (" << mThreadType << ")";
+      ss << ", profile " << mProfile << ", slice mode " << mSliceMode << ", slices " << mSlices;
+      if (!mDeadline.empty())
+        ss << ", deadline " << mDeadline << ", cpu used " << mCpuUsed;
+      ss << ", output " << mOutput << ", mode " << mMode;
+      if (mPass)
+        ss << ", pass " << mPass;
+      if (!mEffectiveThreadType.empty())
+        ss << ", running " << mEffectiveThreads << " threads (" << mEffectiveThreadType << ")";
+    }
     else 
-      ss << "Audio encode, bitrate " << mBitrate;
+      ss << "Audio encode, bitrate " << bitrate() << ", output " << mOutput;
     return ss.str();
   }
 
+  void addStats(Local<Object> stats) const {
+    Nan::Set(stats, Nan::New("bitrate").ToLocalChecked(), Nan::New(bitrate()));
+    Nan::Set(stats, Nan::New("output").ToLocalChecked(), Nan::New(mOutput).ToLocalChecked());
+    if (!mIsVideo)
+      return;
+    Nan::Set(stats, Nan::New("gopFrames").ToLocalChecked(), Nan::New(gopFrames()));
+    Nan::Set(stats, Nan::New("threads").ToLocalChecked(), Nan::New(mEffectiveThreads));
+    Nan::Set(stats, Nan::New("threadType").ToLocalChecked(), Nan::New(mEffectiveThreadType).ToLocalChecked());
+    Nan::Set(stats, Nan::New("profile").ToLocalChecked(), Nan::New(mProfile).ToLocalChecked());
+    Nan::Set(stats, Nan::New("sliceMode").ToLocalChecked(), Nan::New(mSliceMode).ToLocalChecked());
+    Nan::Set(stats, Nan::New("slices").ToLocalChecked(), Nan::New(mSlices));
+    Nan::Set(stats, Nan::New("mode").ToLocalChecked(), Nan::New(mMode).ToLocalChecked());
+    if (mPass)
+      Nan::Set(stats, Nan::New("pass").ToLocalChecked(), Nan::New(mPass));
+    if (!mDeadline.empty()) {
+      Nan::Set(stats, Nan::New("deadline").ToLocalChecked(), Nan::New(mDeadline).ToLocalChecked());
+      Nan::Set(stats, Nan::New("cpuUsed").ToLocalChecked(), Nan::New(mCpuUsed));
+    }
+  }
+
 private:
   bool mIsVideo;
-  uint32_t mBitrate;
-  uint32_t mGopFrames;
+  // changed by the worker while stats are read on the JS thread
+  std::atomic<uint32_t> mBitrate;
+  std::atomic<uint32_t> mGopFrames;
+  uint32_t mThreads;
+  std::string mThreadType;
+  std::string mProfile;
+  std::string mSliceMode;
+  uint32_t mSlices;
+  std::string mDeadline;
+  uint32_t mCpuUsed;
+  std::string mOutput;
+  std::string mMode;
+  uint32_t mPass;
+  std::string mPassStats;
+  uint32_t mEffectiveThreads;
+  std::string mEffectiveThreadType;
+  mutable std::mutex mPassMtx;
+  std::string mFirstPassStats;
 };
 
 } // namespace streampunk
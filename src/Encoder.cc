@@ -19,9 +19,14 @@
 #include "Timer.h"
 #include "Packers.h"
 #include "Memory.h"
-#include "EncoderFactory.h"
+#include "FramePool.h"
+#include "DriverRegistry.h"
+#include "iCodecDriver.h"
 #include "EssenceInfo.h"
 #include "Persist.h"
+#include "GopAggregator.h"
+#include "RateBuffer.h"
+#include "ContextPool.h"
 
 #include <memory>
 
@@ -34,32 +39,109 @@ uint32_t beToLe32 (uint32_t be) {
   return (pB[0] << 24) | (pB[1] << 16) | (pB[2] << 8) | pB[3];
 }
 
+Local<Object> Encoder::packetInfoObject(const tPacketInfo &packetInfo) {
+  Local<Object> info = Nan::New<Object>();
+  Nan::Set(info, Nan::New("bytes").ToLocalChecked(), Nan::New(packetInfo.numBytes));
+  Nan::Set(info, Nan::New("offset").ToLocalChecked(), Nan::New(packetInfo.offset));
+  Nan::Set(info, Nan::New("pts").ToLocalChecked(), Nan::New((double)packetInfo.pts));
+  Nan::Set(info, Nan::New("dts").ToLocalChecked(), Nan::New((double)packetInfo.dts));
+  Nan::Set(info, Nan::New("duration").ToLocalChecked(), Nan::New((double)packetInfo.duration));
+  Nan::Set(info, Nan::New("key").ToLocalChecked(), Nan::New(packetInfo.keyFrame));
+  if (packetInfo.numSamples)
+    Nan::Set(info, Nan::New("samples").ToLocalChecked(), Nan::New(packetInfo.numSamples));
+  else
+    Nan::Set(info, Nan::New("pictureType").ToLocalChecked(), Nan::New(std::string(1, packetInfo.pictureType)).ToLocalChecked());
+  if (packetInfo.qp >= 0)
+    Nan::Set(info, Nan::New("qp").ToLocalChecked(), Nan::New(packetInfo.qp));
+  if (packetInfo.fullness >= 0.0f)
+    Nan::Set(info, Nan::New("fullness").ToLocalChecked(), Nan::New((double)packetInfo.fullness));
+  return info;
+}
+
+Local<Array> Encoder::packetInfoArray(const std::vector<tPacketInfo> &packetInfos) {
+  Local<Array> infoArray = Nan::New<Array>((int)packetInfos.size());
+  for (uint32_t i = 0; i < packetInfos.size(); ++i)
+    Nan::Set(infoArray, i, packetInfoObject(packetInfos[i]));
+  return infoArray;
+}
+
+Local<Array> Encoder::packetInfoArray(const std::vector<tPacketInfo> &packetInfos, const std::vector<uint32_t> &gopSizes) {
+  if (gopSizes.empty())
+    return packetInfoArray(packetInfos);
+  Local<Array> gopArray = Nan::New<Array>((int)gopSizes.size());
+  uint32_t p = 0;
+  for (uint32_t g = 0; g < gopSizes.size(); ++g) {
+    Local<Array> infoArray = Nan::New<Array>((int)gopSizes[g]);
+    for (uint32_t i = 0; i < gopSizes[g]; ++i)
+      Nan::Set(infoArray, i, packetInfoObject(packetInfos[p++]));
+    Nan::Set(gopArray, g, infoArray);
+  }
+  return gopArray;
+}
+
 class EncodeProcessData : public iProcessData {
 public:
   EncodeProcessData (Local<Object> srcBufObj, Local<Object> dstBufObj, std::shared_ptr<Memory> convertDstBuf)
-    : mPersistentSrcBuf(new Persist(srcBufObj)),
-      mPersistentDstBuf(new Persist(dstBufObj)),
-      mSrcBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj))), 
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))), 
+    : mPersistentSrcBuf(srcBufObj),
+      mPersistentDstBuf(dstBufObj),
+      mSrcBuf((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)), 
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)), 
       mConvertDstBuf(convertDstBuf)
     { }
   ~EncodeProcessData() {}
   
-  std::shared_ptr<Memory> srcBuf() const { return mSrcBuf; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> srcBuf() { return share(mSrcBuf); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
   std::shared_ptr<Memory> convertDstBuf() const { return mConvertDstBuf; }
+  std::vector<std::shared_ptr<Memory> > &packets() { return mPackets; }
+  std::vector<tPacketInfo> &packetInfos() { return mPacketInfos; }
+  std::vector<uint32_t> &gopSizes() { return mGopSizes; }
+  uint64_t numBytes() const { return mSrcBuf.numBytes() + mDstBuf.numBytes() + memoryBytes(mConvertDstBuf); }
+  // packets that were not written into the destination buffer, or closed GOPs
+  std::vector<std::shared_ptr<Memory> > resultBufs() const { return mPackets; }
+  Local<Value> resultInfo() const { return Encoder::packetInfoArray(mPacketInfos, mGopSizes); }
 
 private:
-  std::unique_ptr<Persist> mPersistentSrcBuf;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::shared_ptr<Memory> mSrcBuf;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentSrcBuf;
+  Persist mPersistentDstBuf;
+  Memory mSrcBuf;
+  Memory mDstBuf;
   std::shared_ptr<Memory> mConvertDstBuf;
+  std::vector<std::shared_ptr<Memory> > mPackets;
+  std::vector<tPacketInfo> mPacketInfos;
+  std::vector<uint32_t> mGopSizes;
+};
+
+class EncodeFlushProcessData : public FlushProcessData {
+public:
+  std::vector<tPacketInfo> &packetInfos() { return mPacketInfos; }
+  std::vector<uint32_t> &gopSizes() { return mGopSizes; }
+  Local<Value> resultInfo() const { return Encoder::packetInfoArray(mPacketInfos, mGopSizes); }
+
+private:
+  std::vector<tPacketInfo> mPacketInfos;
+  std::vector<uint32_t> mGopSizes;
+};
+
+// queued between frames, returning any packets drained by an encoder that has to restart - a
+// setting left out of the request is EncodeParams::kUnchanged
+class EncodeReconfigureProcessData : public EncodeFlushProcessData {
+public:
+  EncodeReconfigureProcessData(uint32_t bitrate, uint32_t gopFrames)
+    : mBitrate(bitrate), mGopFrames(gopFrames) {}
+
+  uint32_t bitrate() const { return mBitrate; }
+  uint32_t gopFrames() const { return mGopFrames; }
+
+private:
+  const uint32_t mBitrate;
+  const uint32_t mGopFrames;
 };
 
 
 Encoder::Encoder(Nan::Callback *callback) 
-  : mWorker(new MyWorker(callback)), mFrameNum(0), mSetInfoOK(false) {
+  : mWorker(new MyWorker(callback)), mFrameNum(0), mSetInfoOK(false), mFlushed(false),
+    mExternalOutput(false), mWarmStart(false), mFrameSeconds(0.0), mReconfigures(0), mRestarts(0) {
   AsyncQueueWorker(mWorker);
 }
 Encoder::~Encoder() {}
@@ -67,35 +149,144 @@ Encoder::~Encoder() {}
 // iProcess
 uint32_t Encoder::processFrame (std::shared_ptr<iProcessData> processData) {
   Timer t;
+  uint32_t dstBytes = 0;
+  std::shared_ptr<EncodeReconfigureProcessData> rpd = std::dynamic_pointer_cast<EncodeReconfigureProcessData>(processData);
+  if (rpd) {
+    // the settings change only once the encoder has taken them, so a failed request leaves them as they were
+    uint32_t bitrate = (EncodeParams::kUnchanged == rpd->bitrate()) ? mEncodeParams->bitrate() : rpd->bitrate();
+    uint32_t gopFrames = (EncodeParams::kUnchanged == rpd->gopFrames()) ? mEncodeParams->gopFrames() : rpd->gopFrames();
+    try {
+      bool restarted = mEncoderDriver->reconfigure(bitrate, gopFrames, rpd->bufs(), rpd->packetInfos());
+      ++(restarted ? mRestarts : mReconfigures);
+      mEncodeParams->setRate(bitrate, gopFrames);
+      // packets drained by a restart were encoded at the previous rate
+      addRateInfo(rpd->packetInfos());
+      mRateBuffer->setBitrate(bitrate);
+      if (mGopAggregator)
+        mGopAggregator->collect(NULL, 0, rpd->bufs(), rpd->packetInfos(), rpd->gopSizes(), false);
+    } catch (std::exception& err) {
+      printDebug(eError, "Encoder reconfigure error: %s\n", err.what());
+      rpd->setError(std::string("Encoder reconfigure error: ") + err.what());
+    }
+    for (auto& buf : rpd->bufs())
+      dstBytes += buf->numBytes();
+    printDebug(eDebug, "reconfigure: %.2fms, bitrate %d, GOP frames %d\n", t.delta(), bitrate, gopFrames);
+    return dstBytes;
+  }
+
+  std::shared_ptr<EncodeFlushProcessData> fpd = std::dynamic_pointer_cast<EncodeFlushProcessData>(processData);
+  if (fpd) {
+    try {
+      mEncoderDriver->flush(fpd->bufs(), fpd->packetInfos());
+      addRateInfo(fpd->packetInfos());
+      if (mGopAggregator)
+        mGopAggregator->collect(NULL, 0, fpd->bufs(), fpd->packetInfos(), fpd->gopSizes(), true);
+    } catch (std::exception& err) {
+      printDebug(eError, "Encoder flush error: %s\n", err.what());
+      fpd->setError(std::string("Encoder flush error: ") + err.what());
+    }
+    for (auto& buf : fpd->bufs())
+      dstBytes += buf->numBytes();
+    printDebug(eDebug, "flush: %.2fms, %d packets\n", t.delta(), (int)fpd->bufs().size());
+    return dstBytes;
+  }
+
   std::shared_ptr<EncodeProcessData> epd = std::dynamic_pointer_cast<EncodeProcessData>(processData);
 
   // do the encode
-  uint32_t dstBytes = 0;
-  std::shared_ptr<Memory> encodeSrcBuf = epd->srcBuf();
+  Memory *encodeSrc = epd->srcBuf().get();
   if (mPacker) {
     mPacker->convert(epd->srcBuf(), epd->convertDstBuf());
-    encodeSrcBuf = epd->convertDstBuf();
+    encodeSrc = epd->convertDstBuf().get();
     printDebug(eDebug, "convert: %.2fms\n", t.delta());
   }
+  // the encoder may keep the source beyond this call - the reference keeps the source buffers
+  // alive until it is released
+  std::shared_ptr<Memory> encodeSrcBuf = mWorker->holdRef(processData, encodeSrc);
+  // an empty destination leaves the encoder to hand out every packet in its own buffer
+  static const std::shared_ptr<Memory> noDstBuf = std::make_shared<Memory>((uint8_t *)NULL, 0);
+  std::shared_ptr<Memory> dstBuf = mExternalOutput ? noDstBuf : epd->dstBuf();
 
   try {
-    mEncoderDriver->encodeFrame (encodeSrcBuf, epd->dstBuf(), mFrameNum++, &dstBytes);
+    mEncoderDriver->encodeFrame (encodeSrcBuf, dstBuf, mFrameNum++, &dstBytes, epd->packets(), epd->packetInfos());
+    addRateInfo(epd->packetInfos());
+    if (mGopAggregator) {
+      mGopAggregator->collect(epd->dstBuf()->buf(), dstBytes, epd->packets(), epd->packetInfos(), epd->gopSizes(), false);
+      dstBytes = 0;
+    }
   } catch (std::exception& err) {
     printDebug(eError, "Encode error: %s\n", err.what());
+    processData->setError(std::string("Encode error: ") + err.what());
   }
   printDebug(eDebug, "encode: %.2fms\n", t.delta());
 
   return dstBytes;
 }
 
+// each video packet holds a frame, and an audio packet the samples it reports
+void Encoder::addRateInfo(std::vector<tPacketInfo> &packetInfos) {
+  for (auto& p : packetInfos) {
+    double seconds = p.numSamples ? (double)p.numSamples / mSrcInfo->clockRate() : mFrameSeconds;
+    p.fullness = mRateBuffer->add(p.numBytes, seconds);
+  }
+}
+
+// encode parameters are keyed as set, before the encoder is opened - a second pass is never
+// prewarmed, as its analysis belongs to one source
+static std::string warmKey(const EssenceInfo &srcInfo, const EssenceInfo &dstInfo, const Duration& duration,
+                           const EncodeParams &encodeParams) {
+  return srcInfo.key() + "|" + dstInfo.key() + "|" + duration.toString() + "|" + encodeParams.toString();
+}
+
+uint32_t Encoder::prewarm(Local<Object> srcTags, Local<Object> dstTags, const Duration& duration,
+                          Local<Object> encodeTags, uint32_t count) {
+  std::shared_ptr<EssenceInfo> srcInfo = std::make_shared<EssenceInfo>(srcTags);
+  std::shared_ptr<EssenceInfo> dstInfo = std::make_shared<EssenceInfo>(dstTags);
+  std::shared_ptr<EncodeParams> keyParams;
+  try {
+    keyParams = std::make_shared<EncodeParams>(encodeTags, srcInfo->isVideo());
+  } catch (std::exception& err) {
+    Nan::ThrowError(err.what());
+    return 0;
+  }
+  if (2 == keyParams->pass()) {
+    Nan::ThrowError("Encoder prewarm cannot open the second pass of a two-pass encode");
+    return 0;
+  }
+
+  ContextPool<tWarmEncoder> &pool = ContextPool<tWarmEncoder>::instance();
+  std::string key = warmKey(*srcInfo, *dstInfo, duration, *keyParams);
+  while (pool.numIdle(key) < std::min(count, pool.maxIdle())) {
+    std::shared_ptr<tWarmEncoder> warm = std::make_shared<tWarmEncoder>();
+    // drivers report setup errors as JS exceptions
+    Nan::TryCatch try_catch;
+    try {
+      warm->params = std::make_shared<EncodeParams>(encodeTags, srcInfo->isVideo());
+      warm->driver = DriverRegistry::instance().createEncoder(srcInfo, dstInfo, duration, warm->params, &warm->driverName);
+    } catch (std::exception& err) {
+      Nan::ThrowError(err.what());
+    }
+    if (try_catch.HasCaught()) {
+      try_catch.ReThrow();
+      break;
+    }
+    pool.give(key, warm);
+  }
+  return pool.numIdle(key);
+}
+
 void Encoder::doSetInfo(Local<Object> srcTags, Local<Object> dstTags, const Duration& duration,
                         Local<Object> encodeTags) {
   mSrcInfo = std::make_shared<EssenceInfo>(srcTags); 
   printDebug(eInfo, "Encoder SrcInfo: %s\n", mSrcInfo->toString().c_str());
   mDstInfo = std::make_shared<EssenceInfo>(dstTags); 
   printDebug(eInfo, "Encoder DstInfo: %s\n", mDstInfo->toString().c_str());
-  std::shared_ptr<EncodeParams> encodeParams = std::make_shared<EncodeParams>(encodeTags, mSrcInfo->isVideo()); 
-  printDebug(eInfo, "Encode Params: %s\n", encodeParams->toString().c_str());
+  try {
+    mEncodeParams = std::make_shared<EncodeParams>(encodeTags, mSrcInfo->isVideo()); 
+  } catch (std::exception& err) {
+    return Nan::ThrowError(err.what());
+  }
+  printDebug(eInfo, "Encode Params: %s\n", mEncodeParams->toString().c_str());
 
   if (mSrcInfo->isVideo()) {
     if (mSrcInfo->packing().compare("420P") && mSrcInfo->packing().compare("YUV422P10") && 
@@ -103,9 +294,8 @@ void Encoder::doSetInfo(Local<Object> srcTags, Local<Object> dstTags, const Dura
       std::string err = std::string("Unsupported source format \'") + mSrcInfo->packing().c_str() + "\'";
       return Nan::ThrowError(err.c_str());
     }
-    if (mDstInfo->packing().compare("h264") && mDstInfo->packing().compare("vp8") && 
-        mDstInfo->packing().compare("AVCi50") && mDstInfo->packing().compare("AVCi100")) {
-      std::string err = std::string("Unsupported codec type \'") + mDstInfo->packing() + "\'";
+    if (!DriverRegistry::instance().hasEncoder(mDstInfo->encodingName())) {
+      std::string err = std::string("Unsupported codec type \'") + mDstInfo->encodingName() + "\'";
       Nan::ThrowError(err.c_str());
       return;
     }
@@ -121,20 +311,37 @@ void Encoder::doSetInfo(Local<Object> srcTags, Local<Object> dstTags, const Dura
     }
   }
   else {
-    if (mDstInfo->encodingName().compare("AAC")) {
+    if (!DriverRegistry::instance().hasEncoder(mDstInfo->encodingName())) {
       std::string err = std::string("Unsupported audio codec type \'") + mDstInfo->encodingName() + "\'";
       Nan::ThrowError(err.c_str());
       return;
     }
   }
 
-  try {
-    mEncoderDriver = EncoderFactory::createEncoder(mSrcInfo, mDstInfo, duration, encodeParams);
-  } catch (std::exception& err) {
-    return Nan::ThrowError(err.what());
+  // an encoder opened by prewarm with the same settings is taken in place of opening one
+  std::shared_ptr<tWarmEncoder> warm;
+  if (2 != mEncodeParams->pass())
+    warm = ContextPool<tWarmEncoder>::instance().take(warmKey(*mSrcInfo, *mDstInfo, duration, *mEncodeParams));
+  mWarmStart = !!warm;
+  if (warm) {
+    mEncodeParams = warm->params;
+    mEncoderDriver = warm->driver;
+    mDriverName = warm->driverName;
+  } else {
+    try {
+      mEncoderDriver = DriverRegistry::instance().createEncoder(mSrcInfo, mDstInfo, duration, mEncodeParams, &mDriverName);
+    } catch (std::exception& err) {
+      return Nan::ThrowError(err.what());
+    }
   }
+  printDebug(eInfo, "Encoder driver: %s%s\n", mDriverName.c_str(), mWarmStart ? " (prewarmed)" : "");
+  printDebug(eInfo, "Encode Settings: %s\n", mEncodeParams->toString().c_str());
   if (mSrcInfo->isVideo() && mEncoderDriver->packingRequired().compare(mSrcInfo->packing()))
     mPacker = std::make_shared<Packers>(mSrcInfo->width(), mSrcInfo->height(), mSrcInfo->packing(), mEncoderDriver->packingRequired());
+  mGopAggregator = mEncodeParams->output().compare("gop") ? std::shared_ptr<GopAggregator>() : std::make_shared<GopAggregator>();
+  mExternalOutput = !mEncodeParams->output().compare("external");
+  mRateBuffer = std::make_shared<RateBuffer>(mEncodeParams->bitrate());
+  mFrameSeconds = (double)duration.numerator() / duration.denominator();
 }
 
 NAN_METHOD(Encoder::SetInfo) {
@@ -172,7 +379,8 @@ NAN_METHOD(Encoder::SetInfo) {
   }
 
   obj->mSetInfoOK = true;
-  info.GetReturnValue().Set(Nan::New(obj->mEncoderDriver->bytesReq()));
+  // no destination buffer is needed when packets are handed out in buffers of their own
+  info.GetReturnValue().Set(Nan::New(obj->mExternalOutput ? 0 : obj->mEncoderDriver->bytesReq()));
 }
 
 NAN_METHOD(Encoder::Encode) {
@@ -193,6 +401,8 @@ NAN_METHOD(Encoder::Encode) {
 
   if (!obj->mSetInfoOK)
     return Nan::ThrowError("Encoder Encode called with incorrect setup parameters");
+  if (obj->mFlushed)
+    return Nan::ThrowError("Encoder Encode called after flush");
 
   if (1 != srcBufArray->Length()) {
     std::string err = std::string("Encoder requires single source buffer - received ") + std::to_string(srcBufArray->Length());
@@ -200,10 +410,68 @@ NAN_METHOD(Encoder::Encode) {
   }
   Local<Object> srcBufObj = Local<Object>::Cast(srcBufArray->Get(0));
   std::shared_ptr<Memory> convertDstBuf;
-  if (obj->mPacker)
-    convertDstBuf = Memory::makeNew(getFormatBytes(obj->mEncoderDriver->packingRequired(), obj->mSrcInfo->width(), obj->mSrcInfo->height()));
-  std::shared_ptr<iProcessData> epd = std::make_shared<EncodeProcessData>(srcBufObj, dstBufObj, convertDstBuf);
-  obj->mWorker->doFrame(epd, obj, new Nan::Callback(callback));
+  if (obj->mPacker) {
+    convertDstBuf = FramePool::instance().acquire(getFormatBytes(obj->mEncoderDriver->packingRequired(), obj->mSrcInfo->width(), obj->mSrcInfo->height()));
+    if (!convertDstBuf)
+      return Nan::ThrowError("Failed to allocate buffer for encoder conversion");
+    numaBind(convertDstBuf->buf(), convertDstBuf->numBytes(), obj->mWorker->numaNode());
+  }
+  std::shared_ptr<iProcessData> epd = obj->mWorker->makeProcessData<EncodeProcessData>(srcBufObj, dstBufObj, convertDstBuf);
+  if (!obj->mWorker->doFrame(epd, obj, callback))
+    return;
+
+  info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
+}
+
+NAN_METHOD(Encoder::Flush) {
+  if (info.Length() != 1)
+    return Nan::ThrowError("Encoder Flush expects 1 argument");
+  if (!info[0]->IsFunction())
+    return Nan::ThrowError("Encoder Flush requires a valid callback as the parameter");
+  Local<Function> callback = Local<Function>::Cast(info[0]);
+
+  Encoder* obj = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+
+  if (!obj->mSetInfoOK)
+    return Nan::ThrowError("Encoder Flush called with incorrect setup parameters");
+
+  // libavcodec encoders cannot continue once drained
+  std::shared_ptr<iProcessData> fpd = obj->mWorker->makeProcessData<EncodeFlushProcessData>();
+  if (!obj->mWorker->doFrame(fpd, obj, callback))
+    return;
+  obj->mFlushed = true;
+
+  info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
+}
+
+NAN_METHOD(Encoder::Reconfigure) {
+  if (info.Length() != 2)
+    return Nan::ThrowError("Encoder Reconfigure expects 2 arguments");
+  if (!info[0]->IsObject())
+    return Nan::ThrowError("Encoder Reconfigure requires a valid params object as the first parameter");
+  if (!info[1]->IsFunction())
+    return Nan::ThrowError("Encoder Reconfigure requires a valid callback as the second parameter");
+  Local<Object> encodeTags = Local<Object>::Cast(info[0]);
+  Local<Function> callback = Local<Function>::Cast(info[1]);
+
+  Encoder* obj = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+
+  if (!obj->mSetInfoOK)
+    return Nan::ThrowError("Encoder Reconfigure called with incorrect setup parameters");
+  if (obj->mFlushed)
+    return Nan::ThrowError("Encoder Reconfigure called after flush");
+
+  uint32_t bitrate, gopFrames;
+  try {
+    obj->mEncodeParams->unpackRate(encodeTags, &bitrate, &gopFrames);
+  } catch (std::exception& err) {
+    return Nan::ThrowError(err.what());
+  }
+
+  // applied on the worker thread between the frames queued before and after it
+  std::shared_ptr<iProcessData> rpd = obj->mWorker->makeProcessData<EncodeReconfigureProcessData>(bitrate, gopFrames);
+  if (!obj->mWorker->doFrame(rpd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -222,6 +490,38 @@ NAN_METHOD(Encoder::Quit) {
   info.GetReturnValue().SetUndefined();
 }
 
+NAN_METHOD(Encoder::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<Encoder>(info.Holder())->mWorker->setOptions("Encoder", info);
+}
+
+NAN_METHOD(Encoder::Stats) {
+  Encoder* obj = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+  Local<Object> stats = obj->mWorker->stats();
+  if (obj->mEncodeParams) {
+    Local<Object> encodeStats = Nan::New<Object>();
+    obj->mEncodeParams->addStats(encodeStats);
+    Nan::Set(stats, Nan::New("encode").ToLocalChecked(), encodeStats);
+  }
+  if (obj->mEncoderDriver) {
+    Nan::Set(stats, Nan::New("driver").ToLocalChecked(), Nan::New(obj->mDriverName).ToLocalChecked());
+    Nan::Set(stats, Nan::New("reconfigures").ToLocalChecked(), Nan::New((uint32_t)obj->mReconfigures));
+    Nan::Set(stats, Nan::New("restarts").ToLocalChecked(), Nan::New((uint32_t)obj->mRestarts));
+    Nan::Set(stats, Nan::New("warmStart").ToLocalChecked(), Nan::New(obj->mWarmStart));
+  }
+  info.GetReturnValue().Set(stats);
+}
+
+// the analysis from the first pass of a two-pass encode, to be passed to the second as passStats -
+// undefined until the first pass has been flushed
+NAN_METHOD(Encoder::FirstPassStats) {
+  Encoder* obj = Nan::ObjectWrap::Unwrap<Encoder>(info.Holder());
+  std::string stats = obj->mEncodeParams ? obj->mEncodeParams->firstPassStats() : std::string();
+  if (stats.empty())
+    info.GetReturnValue().SetUndefined();
+  else
+    info.GetReturnValue().Set(Nan::New(stats).ToLocalChecked());
+}
+
 NAN_MODULE_INIT(Encoder::Init) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Encoder").ToLocalChecked());
@@ -229,7 +529,12 @@ NAN_MODULE_INIT(Encoder::Init) {
 
   SetPrototypeMethod(tpl, "setInfo", SetInfo);
   SetPrototypeMethod(tpl, "encode", Encode);
+  SetPrototypeMethod(tpl, "flush", Flush);
+  SetPrototypeMethod(tpl, "reconfigure", Reconfigure);
   SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
+  SetPrototypeMethod(tpl, "firstPassStats", FirstPassStats);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Encoder").ToLocalChecked(),
@@ -18,7 +18,9 @@
 
 #include "iDebug.h"
 #include "iProcess.h"
+#include "iCodecDriver.h"
 #include <memory>
+#include <atomic>
 
 namespace streampunk {
 
@@ -27,6 +29,16 @@ class Packers;
 class iEncoderDriver;
 class Duration;
 class EssenceInfo;
+class EncodeParams;
+class GopAggregator;
+class RateBuffer;
+
+// an encoder opened by prewarm, with the encode parameters that it holds
+struct tWarmEncoder {
+  std::shared_ptr<iEncoderDriver> driver;
+  std::shared_ptr<EncodeParams> params;
+  std::string driverName;
+};
 
 class Encoder : public Nan::ObjectWrap, public iProcess, public iDebug {
 public:
@@ -34,6 +46,17 @@ public:
 
   // iProcess
   uint32_t processFrame (std::shared_ptr<iProcessData> processData);
+
+  // describes an encoded packet to JS
+  static v8::Local<v8::Object> packetInfoObject(const tPacketInfo &packetInfo);
+  static v8::Local<v8::Array> packetInfoArray(const std::vector<tPacketInfo> &packetInfos);
+  // packet descriptions grouped by GOP, when gopSizes is not empty
+  static v8::Local<v8::Array> packetInfoArray(const std::vector<tPacketInfo> &packetInfos, const std::vector<uint32_t> &gopSizes);
+
+  // opens up to count encoders for a later setInfo with the same arguments to take, returning the
+  // number that are then idle - a JS error is thrown if one cannot be opened
+  static uint32_t prewarm(v8::Local<v8::Object> srcTags, v8::Local<v8::Object> dstTags, const Duration& duration,
+                          v8::Local<v8::Object> encodeTags, uint32_t count);
   
 private:
   explicit Encoder(Nan::Callback *callback);
@@ -41,6 +64,7 @@ private:
 
   void doSetInfo(v8::Local<v8::Object> srcTags, v8::Local<v8::Object> dstTags, const Duration& duration,
                  v8::Local<v8::Object> encodeTags);
+  void addRateInfo(std::vector<tPacketInfo> &packetInfos);
 
   static NAN_METHOD(New) {
     if (info.IsConstructCall()) {
@@ -65,15 +89,33 @@ private:
 
   static NAN_METHOD(SetInfo);
   static NAN_METHOD(Encode);
+  static NAN_METHOD(Flush);
+  static NAN_METHOD(Reconfigure);
   static NAN_METHOD(Quit);
+  static NAN_METHOD(SetWorkerOptions);
+  static NAN_METHOD(Stats);
+  static NAN_METHOD(FirstPassStats);
 
   MyWorker *mWorker;
   uint32_t mFrameNum;
   bool mSetInfoOK;
+  bool mFlushed;
   std::shared_ptr<EssenceInfo> mSrcInfo;
   std::shared_ptr<EssenceInfo> mDstInfo;
+  std::shared_ptr<EncodeParams> mEncodeParams;
   std::shared_ptr<Packers> mPacker;
   std::shared_ptr<iEncoderDriver> mEncoderDriver;
+  std::string mDriverName;
+  std::shared_ptr<GopAggregator> mGopAggregator;
+  // packets are handed out in the encoder's own buffers rather than copied to the destination
+  bool mExternalOutput;
+  // whether the encoder was taken from those opened by prewarm
+  bool mWarmStart;
+  std::shared_ptr<RateBuffer> mRateBuffer;
+  double mFrameSeconds;
+  // reconfigurations taken by the running encoder, and those that restarted it
+  std::atomic<uint32_t> mReconfigures;
+  std::atomic<uint32_t> mRestarts;
 };
 
 } // namespace streampunk
@@ -18,14 +18,26 @@
 #include "Memory.h"
 #include "EssenceInfo.h"
 #include "EncodeParams.h"
+#include "PcmConvert.h"
+#include "FFmpegInit.h"
 #include <array>
+#include <algorithm>
+#include <thread>
 
 extern "C" {
   #include <libavutil/opt.h>
   #include <libavcodec/avcodec.h>
   #include <libavutil/imgutils.h>
+  #include <libavutil/intreadwrite.h>
 }
 
+// the send/receive API, which returns any number of packets for each frame, is used when the
+// libavcodec build provides it - the bundled libavcodec 57.28 does not, so this path is only
+// compiled against a newer FFmpeg
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+#define ENCODERFF_SEND_RECEIVE
+#endif
+
 namespace streampunk {
 
 uint32_t getFreqCode(uint32_t sample_rate) {
@@ -52,35 +64,17 @@ void fillAdtsHeader(uint8_t *buf, uint32_t freqCode, uint32_t chanCode, uint32_t
   buf[6] = 0xFC;
 }
 
-bool checkGopStart(uint8_t *encBuf) {
-  bool result = false;
-  uint32_t startCode = 0x01000000;
-  uint8_t *const encPtr = encBuf;
-  uint8_t *bufPtr = encBuf;
-  while (bufPtr - encPtr < 48) {
-    if (0==memcmp(bufPtr, &startCode, 4)) {
-      if (0x1 == (bufPtr[4] & 0x1F)) // pframe
-        break;
-      else if (0x5 == (bufPtr[4] & 0x1F)) { // iframe
-        result = true;
-        break;
-      }
-      bufPtr += 4;
-    }
-    else
-      ++bufPtr;
-  }
-
-  return result;
+static void releaseSrcBuf(void *opaque, uint8_t *data) {
+  delete (std::shared_ptr<Memory> *)opaque;
 }
 
 EncoderFF::EncoderFF(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo, const Duration& duration,
                      std::shared_ptr<EncodeParams> encodeParams)
   : mIsVideo(srcInfo->isVideo()), mEncoding(dstInfo->encodingName()), mBytesReq(0),
-    mCodec(NULL), mContext(NULL), mFrame(NULL), mFreqCode(3), mBitsPerSample(16), mGopBuf_HWM(0) {
+    mCodec(NULL), mContext(NULL), mFrame(NULL), mFreqCode(3), mBitsPerSample(16), mSamples(NULL),
+    mFifoSamples(0), mSampleBytes(0), mNextPts(0), mEncodeParams(encodeParams) {
 
-  avcodec_register_all();
-  av_log_set_level(AV_LOG_INFO);
+  initFFmpeg();
 
   AVCodecID codecID = AV_CODEC_ID_NONE;
   if (mIsVideo) {
@@ -115,14 +109,66 @@ EncoderFF::EncoderFF(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<Essen
     mContext->max_b_frames = 1;
     mContext->pix_fmt = AV_PIX_FMT_YUV420P;
 
-    av_opt_set(mContext->priv_data, "slice_mode", "auto", AV_OPT_SEARCH_CHILDREN);
-    //av_opt_set(mContext->priv_data, "max_nal_size", "1500", AV_OPT_SEARCH_CHILDREN);
-    //av_opt_set(mContext->priv_data, "loopfilter", "1", AV_OPT_SEARCH_CHILDREN);
-    av_opt_set(mContext->priv_data, "profile", "baseline", AV_OPT_SEARCH_CHILDREN);
-    //av_opt_set(mContext->priv_data, "allow_skip_frames", "true", AV_OPT_SEARCH_CHILDREN);
-    //av_opt_set(mContext->priv_data, "cabac", "1", AV_OPT_SEARCH_CHILDREN);
+    // libopenh264 and libvpx thread internally from thread_count, which they take as is, so
+    // the one per core default is resolved here
+    mContext->thread_count = encodeParams->threads() ? encodeParams->threads() : std::min(16U, std::max(1U, std::thread::hardware_concurrency()));
+    if (!encodeParams->threadType().compare("frame"))
+      mContext->thread_type = FF_THREAD_FRAME;
+    else if (!encodeParams->threadType().compare("slice"))
+      mContext->thread_type = FF_THREAD_SLICE;
+    else
+      mContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+    if (AV_CODEC_ID_H264 == codecID) {
+      mContext->slices = encodeParams->slices();
+      // each is set only where the wrapper has it - libx264 has a profile but no slice mode - and
+      // a value the wrapper has but rejects is an error
+      const std::array<std::pair<const char *, std::string>, 2> h264Opts = {{
+        { "slice_mode", encodeParams->sliceMode() }, { "profile", encodeParams->profile() } }};
+      for (auto& opt : h264Opts) {
+        if (!av_opt_find(mContext->priv_data, opt.first, NULL, 0, 0))
+          continue;
+        if (av_opt_set(mContext->priv_data, opt.first, opt.second.c_str(), AV_OPT_SEARCH_CHILDREN) < 0) {
+          std::string err = std::string("Encoder '") + mCodec->name + "' could not set " + opt.first + " '" + opt.second + "'";
+          Nan::ThrowError(err.c_str());
+          return;
+        }
+      }
+      //av_opt_set(mContext->priv_data, "max_nal_size", "1500", AV_OPT_SEARCH_CHILDREN);
+      //av_opt_set(mContext->priv_data, "loopfilter", "1", AV_OPT_SEARCH_CHILDREN);
+      //av_opt_set(mContext->priv_data, "allow_skip_frames", "true", AV_OPT_SEARCH_CHILDREN);
+      //av_opt_set(mContext->priv_data, "cabac", "1", AV_OPT_SEARCH_CHILDREN);
+    } else if (!encodeParams->deadline().empty()) {
+      av_opt_set(mContext->priv_data, "deadline", encodeParams->deadline().c_str(), AV_OPT_SEARCH_CHILDREN);
+      av_opt_set_int(mContext->priv_data, "cpu-used", encodeParams->cpuUsed(), AV_OPT_SEARCH_CHILDREN);
+    }
+
+    // file encodes hold frames back so that rate control can look ahead - libvpx also uses them
+    // for alternate reference frames - trading latency for size at the same quality
+    if (!encodeParams->mode().compare("file")) {
+      if (av_opt_find(mContext->priv_data, "lag-in-frames", NULL, 0, 0)) {
+        av_opt_set_int(mContext->priv_data, "lag-in-frames", 25, AV_OPT_SEARCH_CHILDREN);
+        av_opt_set_int(mContext->priv_data, "auto-alt-ref", 1, AV_OPT_SEARCH_CHILDREN);
+      } else if (av_opt_find(mContext->priv_data, "rc-lookahead", NULL, 0, 0)) {
+        av_opt_set_int(mContext->priv_data, "rc-lookahead", 40, AV_OPT_SEARCH_CHILDREN);
+      } else {
+        std::string err = std::string("Encoder '") + mCodec->name + "' does not support file mode";
+        Nan::ThrowError(err.c_str());
+        return;
+      }
 
-    mBytesReq = srcInfo->width() * srcInfo->height(); // todo: how should this be calculated ??
+      // the first pass only analyses the frames - the second pass encodes them using that analysis
+      if (1 == encodeParams->pass())
+        mContext->flags |= AV_CODEC_FLAG_PASS1;
+      else if (2 == encodeParams->pass()) {
+        mStatsIn = encodeParams->passStats();
+        mContext->flags |= AV_CODEC_FLAG_PASS2;
+        mContext->stats_in = &mStatsIn[0];
+      }
+    }
+
+    // a destination buffer of this size holds most packets - a larger one is handed out separately
+    mBytesReq = srcInfo->width() * srcInfo->height();
   } else {
     if (srcInfo->encodingName().compare("L16") && 
         srcInfo->encodingName().compare("L20") && 
@@ -136,11 +182,13 @@ EncoderFF::EncoderFF(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<Essen
     mContext->channels = srcInfo->channels();
     mContext->channel_layout = av_get_default_channel_layout(mContext->channels);
     mContext->profile = FF_PROFILE_AAC_LOW;
-    mContext->time_base = { (int)duration.numerator(), (int)duration.denominator() };
+    // sources are re-framed, so timestamps count samples rather than source frames
+    mContext->time_base = { 1, (int)mContext->sample_rate };
 
-    mBytesReq = (uint32_t)mContext->bit_rate / 8; // todo: how should this be calculated ??
+    mBytesReq = (uint32_t)mContext->bit_rate / 8;
     mFreqCode = getFreqCode(mContext->sample_rate);
     mBitsPerSample = std::stoi(srcInfo->encodingName().c_str()+1);
+    mSampleBytes = mContext->channels * ((mBitsPerSample + 7) / 8);
   }
 
   if (avcodec_open2(mContext, mCodec, NULL) < 0) {
@@ -148,15 +196,42 @@ EncoderFF::EncoderFF(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<Essen
     return;
   }
 
+  // frame or slice threading is only active for libavcodec's own encoders - the library encoders
+  // thread internally
+  if (mIsVideo) {
+    std::string threadType = (mContext->active_thread_type & FF_THREAD_FRAME) ? "frame" :
+                             (mContext->active_thread_type & FF_THREAD_SLICE) ? "slice" : "internal";
+    encodeParams->setEffective(mContext->thread_count, threadType);
+  }
+
   mFrame = av_frame_alloc();
   if (!mFrame) {
     Nan::ThrowError("Could not allocate video frame");
     return;
   } 
+
+  // the frame size is known once the codec is open
+  if (!mIsVideo) {
+    mFrame->nb_samples = mContext->frame_size;
+    mFrame->format = mContext->sample_fmt;
+    mFrame->channel_layout = mContext->channel_layout;
+    mFrame->sample_rate = mContext->sample_rate; 
+
+    int bufferSize = av_samples_get_buffer_size(NULL, mContext->channels, mContext->frame_size, mContext->sample_fmt, 0);
+    mSamples = (float *)av_malloc(bufferSize);
+    if (!mSamples || (avcodec_fill_audio_frame(mFrame, mContext->channels, mContext->sample_fmt,
+                                               (const uint8_t*)mSamples, bufferSize, 0) < 0)) {
+      Nan::ThrowError("Could not set up audio frame");
+      return;
+    }
+    mPcmConvert = std::make_shared<PcmConvert>(mBitsPerSample);
+    mFifo.resize(mContext->frame_size * mSampleBytes);
+  }
 }
 
 EncoderFF::~EncoderFF() {
   av_frame_free(&mFrame);
+  av_freep(&mSamples);
   avcodec_close(mContext);
   av_free(mContext);
 }
@@ -165,16 +240,196 @@ std::string EncoderFF::packingRequired() const {
   return "420P";
 }
 
-void EncoderFF::encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, 
-                             uint32_t frameNum, uint32_t *pDstBytes) {
+void EncoderFF::encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                             std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  *pDstBytes = 0;
   if (mIsVideo)
-    encodeVideo(srcBuf, dstBuf, frameNum, pDstBytes);
+    encodeVideo(srcBuf, dstBuf, frameNum, pDstBytes, dstBufs, packetInfos);
   else
-    encodeAudio(srcBuf, dstBuf, frameNum, pDstBytes);
+    encodeAudio(srcBuf, dstBuf, frameNum, pDstBytes, dstBufs, packetInfos);
+}
+
+void EncoderFF::flush (std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  uint32_t dstBytes = 0;
+
+  // the last audio samples are encoded as a short frame where the encoder allows it, otherwise
+  // they are padded out with silence
+  if (mFifoSamples) {
+    uint32_t numSamples = mFifoSamples;
+    if (!(mCodec->capabilities & AV_CODEC_CAP_SMALL_LAST_FRAME)) {
+      memset(&mFifo[mFifoSamples * mSampleBytes], 0, (mContext->frame_size - mFifoSamples) * mSampleBytes);
+      numSamples = mContext->frame_size;
+    }
+    mFifoSamples = 0;
+    encodeSamples(&mFifo[0], numSamples, std::shared_ptr<Memory>(), &dstBytes, dstBufs, packetInfos);
+  }
+
+  // encoders without a delay return every packet from the call that encoded its frame
+  if (mCodec->capabilities & AV_CODEC_CAP_DELAY)
+    encodePackets(NULL, std::shared_ptr<Memory>(), &dstBytes, dstBufs, packetInfos);
+
+  // the first pass analysis is complete once the encoder is drained
+  if ((mContext->flags & AV_CODEC_FLAG_PASS1) && mContext->stats_out)
+    mEncodeParams->setFirstPassStats(mContext->stats_out);
+}
+
+bool EncoderFF::reconfigure (uint32_t bitrate, uint32_t gopFrames,
+                             std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  if (reconfigureInPlace(bitrate, gopFrames)) {
+    mContext->bit_rate = bitrate;
+    if (mIsVideo)
+      mContext->gop_size = gopFrames;
+    return false;
+  }
+
+  // a restart would split the analysis of a two-pass encode
+  if (mContext->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2))
+    throw std::runtime_error("EncoderFF cannot reconfigure a two-pass encode");
+
+  // the packets held back are drained, and the encoder is replaced with one opened from a copy of
+  // its settings, so the stream continues from a key frame without a new setInfo
+  uint32_t dstBytes = 0;
+  if (mCodec->capabilities & AV_CODEC_CAP_DELAY)
+    encodePackets(NULL, std::shared_ptr<Memory>(), &dstBytes, dstBufs, packetInfos);
+
+  AVCodecContext *context = avcodec_alloc_context3(mCodec);
+  if (!context || (avcodec_copy_context(context, mContext) < 0)) {
+    avcodec_free_context(&context);
+    throw std::runtime_error("EncoderFF could not copy codec context");
+  }
+  context->bit_rate = bitrate;
+  if (mIsVideo)
+    context->gop_size = gopFrames;
+  if (avcodec_open2(context, mCodec, NULL) < 0) {
+    avcodec_free_context(&context);
+    throw std::runtime_error("EncoderFF could not reopen codec");
+  }
+
+  avcodec_close(mContext);
+  av_free(mContext);
+  mContext = context;
+  return true;
+}
+
+#ifdef ENCODERFF_SEND_RECEIVE
+// submits a frame, or the end of stream when frame is NULL, then collects every packet the
+// encoder has ready - there may be none, or several
+void EncoderFF::encodePackets(const AVFrame *frame, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                              std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  if (avcodec_send_frame(mContext, frame) < 0)
+    throw std::runtime_error(frame ? "EncoderFF failed to send frame" : "EncoderFF failed to flush encoder");
+
+  while (true) {
+    AVPacket *pkt = av_packet_alloc();
+    if (!pkt)
+      throw std::runtime_error("EncoderFF could not allocate packet");
+    int ret = avcodec_receive_packet(mContext, pkt);
+    if (ret < 0) {
+      av_packet_free(&pkt);
+      if ((AVERROR(EAGAIN) == ret) || (AVERROR_EOF == ret))
+        break;
+      throw std::runtime_error("EncoderFF failed to receive packet");
+    }
+    outputPacket(pkt, dstBuf, pDstBytes, dstBufs, packetInfos);
+  }
+}
+#else
+// libavcodec before 57.37 returns at most one packet for each call, so the end of stream is drained
+// by submitting NULL frames until no packet is returned. As for the send/receive API, libavcodec
+// allocates each packet at the size it codes, so the destination buffer does not limit its size
+void EncoderFF::encodePackets(const AVFrame *frame, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                              std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  do {
+    AVPacket *pkt = av_packet_alloc();
+    if (!pkt)
+      throw std::runtime_error("EncoderFF could not allocate packet");
+    if (!encodePacket(pkt, frame)) {
+      av_packet_free(&pkt);
+      break;
+    }
+    outputPacket(pkt, dstBuf, pDstBytes, dstBufs, packetInfos);
+  } while (!frame);
+}
+
+bool EncoderFF::encodePacket(AVPacket *pkt, const AVFrame *frame) {
+  int got_output = 0;
+  int ret = mIsVideo ? avcodec_encode_video2(mContext, pkt, frame, &got_output) :
+                       avcodec_encode_audio2(mContext, pkt, frame, &got_output);
+  if (ret < 0)
+    throw std::runtime_error(frame ? "EncoderFF failed to encode frame" : "EncoderFF failed to flush encoder");
+  return 0 != got_output;
+}
+#endif
+
+// Takes ownership of a packet allocated by libavcodec. The first packet from a call is copied into
+// dstBuf when it fits - any others are handed out as they are, audio with the ADTS header added.
+void EncoderFF::outputPacket(AVPacket *pkt, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                             std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  uint32_t headerBytes = mIsVideo ? 0 : kAdtsHeaderBytes;
+  uint32_t numBytes = pkt->size + headerBytes;
+  tPacketInfo packetInfo;
+  setPacketInfo(pkt, numBytes, &packetInfo);
+  bool firstPacket = !*pDstBytes && dstBufs.empty();
+
+  if (dstBuf && firstPacket && (numBytes <= dstBuf->numBytes())) {
+    if (headerBytes)
+      fillAdtsHeader(dstBuf->buf(), mFreqCode, mContext->channels, numBytes);
+    memcpy(dstBuf->buf() + headerBytes, pkt->data, pkt->size);
+    *pDstBytes = numBytes;
+    av_packet_free(&pkt);
+  } else if (!headerBytes) {
+    dstBufs.push_back(std::shared_ptr<Memory>(new Memory(pkt->data, pkt->size), [pkt](Memory *mem) {
+      AVPacket *p = pkt;
+      av_packet_free(&p);
+      delete mem;
+    }));
+  } else {
+    std::shared_ptr<Memory> packetBuf = Memory::makeNew(numBytes);
+    fillAdtsHeader(packetBuf->buf(), mFreqCode, mContext->channels, numBytes);
+    memcpy(packetBuf->buf() + headerBytes, pkt->data, pkt->size);
+    dstBufs.push_back(packetBuf);
+    av_packet_free(&pkt);
+  }
+  packetInfos.push_back(packetInfo);
+}
+
+// Returns true when the running encoder has taken the new settings. libavcodec's AAC encoder reads
+// the bitrate for every frame, and the libx264 wrapper reconfigures x264 for a new bitrate before
+// the next frame, but not for a new GOP length. The openh264 and libvpx wrappers read their rate
+// control settings only when opened, so they, and anything else, need a restart
+bool EncoderFF::reconfigureInPlace(uint32_t bitrate, uint32_t gopFrames) {
+  bool gopChanged = mIsVideo && ((int)gopFrames != mContext->gop_size);
+  if (!strcmp(mCodec->name, "aac"))
+    return true;
+  if (!strcmp(mCodec->name, "libx264"))
+    return !gopChanged;
+  return false;
+}
+
+void EncoderFF::setPacketInfo(const AVPacket *pkt, uint32_t numBytes, tPacketInfo *pInfo) const {
+  pInfo->numBytes = numBytes;
+  pInfo->pts = pkt->pts;
+  pInfo->dts = pkt->dts;
+  pInfo->duration = pkt->duration;
+  pInfo->keyFrame = 0 != (pkt->flags & AV_PKT_FLAG_KEY);
+  if (mIsVideo) {
+    // picture type is exported in the quality stats by encoders that support it - otherwise it
+    // follows from the key flag, as neither openh264 (baseline) nor libvpx (vp8) codes B-frames
+    int sideDataSize = 0;
+    uint8_t *stats = av_packet_get_side_data((AVPacket *)pkt, AV_PKT_DATA_QUALITY_STATS, &sideDataSize);
+    if (stats && (sideDataSize >= 5) && (AV_PICTURE_TYPE_NONE != stats[4]))
+      pInfo->pictureType = av_get_picture_type_char((AVPictureType)stats[4]);
+    else
+      pInfo->pictureType = pInfo->keyFrame ? 'I' : 'P';
+    // the quality is the frame's lambda, which converts back to a QP
+    if (stats && (sideDataSize >= 4))
+      pInfo->qp = (int32_t)((AV_RL32(stats) + FF_QP2LAMBDA / 2) / FF_QP2LAMBDA);
+  } else
+    pInfo->numSamples = pkt->duration ? (uint32_t)pkt->duration : mContext->frame_size;
 }
 
-void EncoderFF::encodeVideo(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf,
-                            uint32_t frameNum, uint32_t *pDstBytes) {
+void EncoderFF::encodeVideo(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                            std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
 
   // setup source frame data
   mFrame->format = mContext->pix_fmt;
@@ -190,95 +445,64 @@ void EncoderFF::encodeVideo(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memo
   mFrame->data[1] = (uint8_t *)(srcBuf->buf() + planeBytes);
   mFrame->data[2] = (uint8_t *)(srcBuf->buf() + planeBytes + planeBytes / 4);
 
+  // a reference counted source lets an encoder that keeps frames for lookahead or B-frames
+  // hold a reference rather than copy - the source is released when the last reference goes
+  std::shared_ptr<Memory> *opaque = new std::shared_ptr<Memory>(srcBuf);
+  mFrame->buf[0] = av_buffer_create(srcBuf->buf(), srcBuf->numBytes(), releaseSrcBuf, opaque, AV_BUFFER_FLAG_READONLY);
+  if (!mFrame->buf[0]) {
+    delete opaque;
+    throw std::runtime_error("EncoderFF could not reference source frame");
+  }
+
   mFrame->pts = frameNum;
 
-  AVPacket pkt;
-  av_init_packet(&pkt);
-  pkt.data = dstBuf->buf();
-  pkt.size = bytesReq();  
-  //pkt.data = NULL;
-  //pkt.size = 0;
-
-  int got_output;
-  avcodec_encode_video2(mContext, &pkt, mFrame, &got_output);
-  *pDstBytes = got_output ? pkt.size : 0;
-
-  // if (got_output && (0==mEncoding.compare("h264"))) {
-  //   *pDstBytes = 0;
-  //   if (checkGopStart(pkt.data)) {
-  //     *pDstBytes = mGopBuf_HWM;
-  //     if (mGopBuf) // copy previous full gop into current dstBuf
-  //       memcpy(dstBuf->buf(), mGopBuf->buf(), mGopBuf_HWM);
-
-  //     // copy this encode result into new buffer
-  //     mGopBuf = Memory::makeNew(mBytesReq);
-  //     memcpy(mGopBuf->buf(), pkt.data, pkt.size);
-  //     mGopBuf_HWM = pkt.size;
-  //   } else if (mGopBuf) {
-  //     memcpy(mGopBuf->buf() + mGopBuf_HWM, pkt.data, pkt.size);
-  //     mGopBuf_HWM += pkt.size;
-  //   }
-  // }
-
-  av_packet_unref(&pkt);
+  try {
+    encodePackets(mFrame, dstBuf, pDstBytes, dstBufs, packetInfos);
+  } catch (...) {
+    av_frame_unref(mFrame);
+    throw;
+  }
   av_frame_unref(mFrame);
 }
 
-void EncoderFF::encodeAudio(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf,
-                            uint32_t frameNum, uint32_t *pDstBytes) {
-
-  mFrame->nb_samples = mContext->frame_size;
-  mFrame->format = mContext->sample_fmt;
-  mFrame->channel_layout = mContext->channel_layout;
-  mFrame->sample_rate = mContext->sample_rate; 
-
-  uint32_t buffer_size = av_samples_get_buffer_size(NULL, mContext->channels, mContext->frame_size, mContext->sample_fmt, 0);
-  float *samples = (float *)av_malloc(buffer_size);
-  if (avcodec_fill_audio_frame(mFrame, mContext->channels, mContext->sample_fmt,
-                               (const uint8_t*)samples, buffer_size, 0) < 0) {
-    throw std::runtime_error("EncoderFF could not set up audio frame");
-  }
-
-  mFrame->pts = frameNum;
-
-  // convert from S16/S20/S24 format to FLTP
-  uint8_t *buf = srcBuf->buf();
-  uint32_t numSamples = mFrame->nb_samples;
-  uint32_t numChannels = mContext->channels;
-  uint32_t bytesPerSample = (mBitsPerSample+7)/8;
-
-  float maxValue = powf(2.0f, float(mBitsPerSample - 1)) - 1.0f;
-  for (uint32_t i = 0; i < numSamples; ++i) {
-    for (uint32_t c = 0; c < numChannels; ++c) {
-      int32_t sample = 0;
-      for (uint32_t b = 0; b < bytesPerSample; ++b) {
-        uint8_t ubyte = buf[(i * numChannels + c) * bytesPerSample + b];
-        if ((0==b) && (ubyte&0x80)) // sign bit
-          sample = 0xFFFFFFFF;
-        sample = (sample << 8) | ubyte; // interleaved channels, big endian
+void EncoderFF::encodeAudio(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                            std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  if (srcBuf->numBytes() % mSampleBytes)
+    throw std::runtime_error("EncoderFF audio source is not a whole number of samples");
+
+  // sources may hold any number of samples - whole encoder frames are converted straight from the
+  // source, and the rest collected in the FIFO until it fills or is flushed
+  const uint8_t *src = srcBuf->buf();
+  uint32_t srcSamples = srcBuf->numBytes() / mSampleBytes;
+  uint32_t frameSamples = mContext->frame_size;
+  while (srcSamples) {
+    uint32_t numSamples = frameSamples;
+    if (!mFifoSamples && (srcSamples >= frameSamples))
+      encodeSamples(src, frameSamples, dstBuf, pDstBytes, dstBufs, packetInfos);
+    else {
+      numSamples = std::min(srcSamples, frameSamples - mFifoSamples);
+      memcpy(&mFifo[mFifoSamples * mSampleBytes], src, numSamples * mSampleBytes);
+      mFifoSamples += numSamples;
+      if (frameSamples == mFifoSamples) {
+        mFifoSamples = 0;
+        encodeSamples(&mFifo[0], frameSamples, dstBuf, pDstBytes, dstBufs, packetInfos);
       }
-      samples[i + c * numSamples] = (float)sample / maxValue; // channel sequential
     }
+    src += numSamples * mSampleBytes;
+    srcSamples -= numSamples;
   }
+}
 
-  uint32_t adtsHeaderSize = 7;
-
-  AVPacket pkt;
-  av_init_packet(&pkt);
-  pkt.data = dstBuf->buf() + adtsHeaderSize;
-  pkt.size = dstBuf->numBytes() - adtsHeaderSize;
-
-  int got_output;
-  avcodec_encode_audio2(mContext, &pkt, mFrame, &got_output);
-  uint32_t encSize = got_output ? pkt.size : 0;
-  uint32_t frameSize = encSize + adtsHeaderSize;
-
-  fillAdtsHeader(dstBuf->buf(), mFreqCode, mContext->channels, frameSize);
-  *pDstBytes = frameSize;
+void EncoderFF::encodeSamples(const uint8_t *src, uint32_t numSamples, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                              std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  // convert from S16/S20/S24 format to FLTP - the frame points at the samples buffer, which is not
+  // reference counted, so an encoder that holds the frame takes a copy
+  mPcmConvert->toPlanarFloat(src, mSamples, numSamples, mContext->channels, mContext->frame_size);
+  mFrame->nb_samples = numSamples;
+  mFrame->pts = mNextPts;
+  mNextPts += numSamples;
 
-  av_freep(&samples);
-  av_packet_unref(&pkt);
-  av_frame_unref(mFrame);
+  encodePackets(mFrame, dstBuf, pDstBytes, dstBufs, packetInfos);
 }
 
 } // namespace streampunk
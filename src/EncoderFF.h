@@ -17,11 +17,13 @@
 #define ENCODERFF_H
 
 #include <memory>
+#include <vector>
 #include "iCodecDriver.h"
 
 struct AVCodec;
 struct AVCodecContext;
 struct AVFrame;
+struct AVPacket;
 
 namespace streampunk {
 
@@ -29,6 +31,7 @@ class Memory;
 class Duration;
 class EssenceInfo;
 class EncodeParams;
+class PcmConvert;
 class EncoderFF : public iEncoderDriver {
 public:
   EncoderFF(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo, const Duration& duration,
@@ -38,7 +41,11 @@ public:
   uint32_t bytesReq() const  { return mBytesReq; }
   std::string packingRequired() const;
 
-  void encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes);
+  void encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  void flush (std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  bool reconfigure (uint32_t bitrate, uint32_t gopFrames,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
 
 private:
   const bool mIsVideo;
@@ -49,11 +56,34 @@ private:
   AVFrame *mFrame;
   uint32_t mFreqCode;
   uint32_t mBitsPerSample;
-  std::shared_ptr<Memory> mGopBuf;
-  uint32_t mGopBuf_HWM;
+  // audio frames are converted into the same samples buffer each time
+  float *mSamples;
+  std::shared_ptr<PcmConvert> mPcmConvert;
+  // source samples that do not yet make up a whole encoder frame, interleaved as received
+  std::vector<uint8_t> mFifo;
+  uint32_t mFifoSamples;
+  uint32_t mSampleBytes;
+  int64_t mNextPts;
+  // the first pass analysis is returned through the encode parameters, and the second pass reads
+  // it from a copy that lives as long as the codec
+  std::shared_ptr<EncodeParams> mEncodeParams;
+  std::string mStatsIn;
 
-  void encodeVideo(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes);
-  void encodeAudio(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes);
+  static const uint32_t kAdtsHeaderBytes = 7;
+
+  void encodeVideo(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                   std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  void encodeAudio(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                   std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  void encodeSamples(const uint8_t *src, uint32_t numSamples, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                     std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  void encodePackets(const AVFrame *frame, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                     std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  bool encodePacket(AVPacket *pkt, const AVFrame *frame);
+  void outputPacket(AVPacket *pkt, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  void setPacketInfo(const AVPacket *pkt, uint32_t numBytes, tPacketInfo *pInfo) const;
+  bool reconfigureInPlace(uint32_t bitrate, uint32_t gopFrames);
 };
 
 
@@ -0,0 +1,232 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <nan.h>
+#include "EncoderVC2.h"
+#include "Memory.h"
+#include "EssenceInfo.h"
+#include "EncodeParams.h"
+#include "FFmpegInit.h"
+#include <algorithm>
+#include <thread>
+
+extern "C" {
+  #include <libavutil/opt.h>
+  #include <libavcodec/avcodec.h>
+}
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+#define ENCODERVC2_SEND_RECEIVE
+#endif
+
+namespace streampunk {
+
+static void releaseSrcBuf(void *opaque, uint8_t *data) {
+  delete (std::shared_ptr<Memory> *)opaque;
+}
+
+EncoderVC2::EncoderVC2(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo, const Duration& duration,
+                       std::shared_ptr<EncodeParams> encodeParams)
+  : mBytesReq(0), mCodec(NULL), mContext(NULL), mFrame(NULL) {
+
+  initFFmpeg();
+
+  mCodec = avcodec_find_encoder_by_name("vc2");
+  if (!mCodec) {
+    Nan::ThrowError("Encoder for format \'vc2\' not found");
+    return;
+  }
+
+  mContext = avcodec_alloc_context3(mCodec);
+  if (!mContext) {
+    Nan::ThrowError("Could not allocate av codec context");
+    return;
+  }
+
+  bool interlaced = 0 != srcInfo->interlace().compare("prog");
+  mContext->bit_rate = encodeParams->bitrate();
+  mContext->width = srcInfo->width();
+  mContext->height = srcInfo->height();
+  mContext->time_base = { (int)duration.numerator(), (int)duration.denominator() };
+  mContext->pix_fmt = AV_PIX_FMT_YUV422P10;
+  mContext->field_order = interlaced ? AV_FIELD_TT : AV_FIELD_PROGRESSIVE;
+  bool bt709 = 0 == srcInfo->colorimetry().compare("BT709-2");
+  mContext->color_primaries = bt709 ? AVCOL_PRI_BT709 : AVCOL_PRI_BT470BG;
+  mContext->color_trc = bt709 ? AVCOL_TRC_BT709 : AVCOL_TRC_SMPTE170M;
+  mContext->colorspace = bt709 ? AVCOL_SPC_BT709 : AVCOL_SPC_BT470BG;
+
+  // the slices of a picture are coded independently, so the latency of a frame falls with the
+  // number of threads - the encoder supports slice threading only
+  mContext->thread_count = encodeParams->threads() ? encodeParams->threads() : std::min(16U, std::max(1U, std::thread::hardware_concurrency()));
+  mContext->thread_type = FF_THREAD_SLICE;
+
+  if (avcodec_open2(mContext, mCodec, NULL) < 0) {
+    Nan::ThrowError("Could not open codec");
+    return;
+  }
+  encodeParams->setEffective(mContext->thread_count, (mContext->active_thread_type & FF_THREAD_SLICE) ? "slice" : "none");
+
+  mBytesReq = pictureBytes();
+
+  mFrame = av_frame_alloc();
+  if (!mFrame) {
+    Nan::ThrowError("Could not allocate video frame");
+    return;
+  }
+}
+
+EncoderVC2::~EncoderVC2() {
+  av_frame_free(&mFrame);
+  avcodec_close(mContext);
+  av_free(mContext);
+}
+
+void EncoderVC2::encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                              std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  *pDstBytes = 0;
+
+  // YUV422P10 planes, 16 bits per sample
+  mFrame->format = mContext->pix_fmt;
+  mFrame->width  = mContext->width;
+  mFrame->height = mContext->height;
+  mFrame->linesize[0] = mFrame->width * 2;
+  mFrame->linesize[1] = mFrame->width;
+  mFrame->linesize[2] = mFrame->width;
+
+  uint32_t lumaBytes = mFrame->linesize[0] * mFrame->height;
+  uint32_t chromaBytes = mFrame->linesize[1] * mFrame->height;
+  mFrame->data[0] = srcBuf->buf();
+  mFrame->data[1] = srcBuf->buf() + lumaBytes;
+  mFrame->data[2] = srcBuf->buf() + lumaBytes + chromaBytes;
+
+  std::shared_ptr<Memory> *opaque = new std::shared_ptr<Memory>(srcBuf);
+  mFrame->buf[0] = av_buffer_create(srcBuf->buf(), srcBuf->numBytes(), releaseSrcBuf, opaque, AV_BUFFER_FLAG_READONLY);
+  if (!mFrame->buf[0]) {
+    delete opaque;
+    throw std::runtime_error("EncoderVC2 could not reference source frame");
+  }
+  mFrame->pts = frameNum;
+
+#ifdef ENCODERVC2_SEND_RECEIVE
+  int ret = avcodec_send_frame(mContext, mFrame);
+  av_frame_unref(mFrame);
+  if (ret < 0)
+    throw std::runtime_error("EncoderVC2 failed to send frame");
+  while (true) {
+    AVPacket *pkt = av_packet_alloc();
+    if (!pkt)
+      throw std::runtime_error("EncoderVC2 could not allocate packet");
+    ret = avcodec_receive_packet(mContext, pkt);
+    if (ret < 0) {
+      av_packet_free(&pkt);
+      if ((AVERROR(EAGAIN) == ret) || (AVERROR_EOF == ret))
+        break;
+      throw std::runtime_error("EncoderVC2 failed to receive packet");
+    }
+    outputPacket(pkt, dstBuf, pDstBytes, dstBufs, packetInfos);
+  }
+#else
+  // a picture larger than dstBuf, after the bitrate is raised by reconfigure, is coded into a
+  // packet that is handed out separately
+  if (dstBuf->numBytes() < mBytesReq) {
+    AVPacket *pkt = av_packet_alloc();
+    if (!pkt) {
+      av_frame_unref(mFrame);
+      throw std::runtime_error("EncoderVC2 could not allocate packet");
+    }
+    int got_output = 0;
+    int ret = avcodec_encode_video2(mContext, pkt, mFrame, &got_output);
+    av_frame_unref(mFrame);
+    if (ret < 0) {
+      av_packet_free(&pkt);
+      throw std::runtime_error("EncoderVC2 failed to encode frame");
+    }
+    if (got_output)
+      outputPacket(pkt, std::shared_ptr<Memory>(), pDstBytes, dstBufs, packetInfos);
+    else
+      av_packet_free(&pkt);
+    return;
+  }
+
+  // the picture is coded directly into dstBuf, which bytesReq sizes for the largest picture
+  AVPacket pkt;
+  av_init_packet(&pkt);
+  pkt.data = dstBuf->buf();
+  pkt.size = dstBuf->numBytes();
+  int got_output = 0;
+  int ret = avcodec_encode_video2(mContext, &pkt, mFrame, &got_output);
+  av_frame_unref(mFrame);
+  if (ret < 0)
+    throw std::runtime_error("EncoderVC2 failed to encode frame");
+  if (got_output) {
+    tPacketInfo packetInfo;
+    packetInfo.numBytes = pkt.size;
+    packetInfo.pts = pkt.pts;
+    packetInfo.dts = pkt.dts;
+    packetInfo.duration = pkt.duration;
+    packetInfo.keyFrame = true;
+    packetInfo.pictureType = 'I';
+    packetInfos.push_back(packetInfo);
+    *pDstBytes = pkt.size;
+  }
+  av_packet_unref(&pkt);
+#endif
+}
+
+void EncoderVC2::flush (std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  // intra only, so no packets are held back
+}
+
+bool EncoderVC2::reconfigure (uint32_t bitrate, uint32_t gopFrames,
+                              std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  // the encoder sizes each picture from the bitrate as it is coded, and every picture is intra
+  mContext->bit_rate = bitrate;
+  mBytesReq = pictureBytes();
+  return false;
+}
+
+// private
+// the encoder sizes each picture to the bitrate, with each field coded to that size when interlaced,
+// plus the sequence header and parse info
+uint32_t EncoderVC2::pictureBytes() const {
+  uint64_t frameBytes = (uint64_t)mContext->bit_rate * mContext->time_base.num / mContext->time_base.den / 8;
+  return (uint32_t)(frameBytes << ((AV_FIELD_PROGRESSIVE != mContext->field_order) ? 1 : 0)) + 65536;
+}
+
+void EncoderVC2::outputPacket(AVPacket *pkt, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                              std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+  tPacketInfo packetInfo;
+  packetInfo.numBytes = pkt->size;
+  packetInfo.pts = pkt->pts;
+  packetInfo.dts = pkt->dts;
+  packetInfo.duration = pkt->duration;
+  packetInfo.keyFrame = true;
+  packetInfo.pictureType = 'I';
+
+  if (dstBuf && !*pDstBytes && dstBufs.empty() && ((uint32_t)pkt->size <= dstBuf->numBytes())) {
+    memcpy(dstBuf->buf(), pkt->data, pkt->size);
+    *pDstBytes = pkt->size;
+    av_packet_free(&pkt);
+  } else {
+    dstBufs.push_back(std::shared_ptr<Memory>(new Memory(pkt->data, pkt->size), [pkt](Memory *mem) {
+      AVPacket *p = pkt;
+      av_packet_free(&p);
+      delete mem;
+    }));
+  }
+  packetInfos.push_back(packetInfo);
+}
+
+} // namespace streampunk
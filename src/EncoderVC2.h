@@ -0,0 +1,66 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef ENCODERVC2_H
+#define ENCODERVC2_H
+
+#include <memory>
+#include <vector>
+#include "iCodecDriver.h"
+
+struct AVCodec;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+namespace streampunk {
+
+class Memory;
+class Duration;
+class EssenceInfo;
+class EncodeParams;
+
+// VC-2 (SMPTE 2042) low delay intra encoder, using libavcodec's native vc2 encoder. It takes
+// YUV422P10 as it is and encodes the slices of each picture across threads, so every frame
+// returns its packet from the call that encoded it.
+class EncoderVC2 : public iEncoderDriver {
+public:
+  EncoderVC2(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo, const Duration& duration,
+             std::shared_ptr<EncodeParams> encodeParams);
+  ~EncoderVC2();
+
+  uint32_t bytesReq() const  { return mBytesReq; }
+  std::string packingRequired() const  { return "YUV422P10"; }
+
+  void encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  void flush (std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+  bool reconfigure (uint32_t bitrate, uint32_t gopFrames,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+
+private:
+  uint32_t mBytesReq;
+  AVCodec *mCodec;
+  AVCodecContext *mContext;
+  AVFrame *mFrame;
+
+  uint32_t pictureBytes() const;
+  void outputPacket(AVPacket *pkt, std::shared_ptr<Memory> dstBuf, uint32_t *pDstBytes,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos);
+};
+
+} // namespace streampunk
+
+#endif
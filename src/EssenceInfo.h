@@ -83,6 +83,14 @@ public:
     return ss.str();
   }
 
+  // every setting, to match processors that are set up the same way
+  std::string key() const  {
+    std::stringstream ss;
+    ss << mFormat << "," << mEncodingName << "," << mClockRate << "," << mWidth << "x" << mHeight << "," << mSampling << "," <<
+          mDepth << "," << mColorimetry << "," << mInterlace << "," << mPacking << "," << mHasAlpha << "," << mChannels;
+    return ss.str();
+  }
+
 private:
   bool mIsVideo;
   std::string mFormat;
@@ -13,26 +13,26 @@
   limitations under the License.
 */
 
-#ifndef DECODERFACTORY_H
-#define DECODERFACTORY_H
+#ifndef FFMPEGINIT_H
+#define FFMPEGINIT_H
 
-#include <memory>
-#include "EssenceInfo.h"
-#include "DecoderFF.h"
+#include <mutex>
+
+extern "C" {
+  #include <libavcodec/avcodec.h>
+}
 
 namespace streampunk {
 
-class DecoderFactory {
-public:
-  static std::shared_ptr<iDecoderDriver> createDecoder(std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo) {
-    if ((0 == srcInfo->encodingName().compare("AVCi50")) || (0 == srcInfo->encodingName().compare("AVCi100"))) {
-      throw std::runtime_error("No implementation of AVCi decoder available");
-    }
-    else {
-      return std::make_shared<DecoderFF>(srcInfo, dstInfo);
-    }
-  }
-};
+// codecs are registered and the log level set once for the process, rather than by every driver
+// as it is set up
+inline void initFFmpeg() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    avcodec_register_all();
+    av_log_set_level(AV_LOG_INFO);
+  });
+}
 
 } // namespace streampunk
 
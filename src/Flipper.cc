@@ -21,6 +21,7 @@
 #include "Memory.h"
 #include "EssenceInfo.h"
 #include "Persist.h"
+#include "TaskScheduler.h"
 
 #include <memory>
 
@@ -28,23 +29,26 @@ using namespace v8;
 
 namespace streampunk {
 
+static const uint32_t kGrainLines = 16;
+
 class FlipProcessData : public iProcessData {
 public:
   FlipProcessData (Local<Object> srcBufObj, Local<Object> dstBufObj)
-    : mPersistentSrcBuf(new Persist(srcBufObj)), mPersistentDstBuf(new Persist(dstBufObj)),
-      mSrcBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj))),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)))
+    : mPersistentSrcBuf(srcBufObj), mPersistentDstBuf(dstBufObj),
+      mSrcBuf((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)),
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))
   {}
   ~FlipProcessData() {}
   
-  std::shared_ptr<Memory> srcBuf() const { return mSrcBuf; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> srcBuf() { return share(mSrcBuf); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
+  uint64_t numBytes() const { return mSrcBuf.numBytes() + mDstBuf.numBytes(); }
 
 private:
-  std::unique_ptr<Persist> mPersistentSrcBuf;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::shared_ptr<Memory> mSrcBuf;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentSrcBuf;
+  Persist mPersistentDstBuf;
+  Memory mSrcBuf;
+  Memory mDstBuf;
 };
 
 class FlipInfo {
@@ -85,11 +89,14 @@ uint32_t Flipper::processFrame (std::shared_ptr<iProcessData> processData) {
 
   std::shared_ptr<Memory> srcBuf = fpd->srcBuf();
   std::shared_ptr<Memory> dstBuf = fpd->dstBuf();
-  for (uint32_t dstY=0, srcY=mSrcVidInfo->height()-1; dstY != mSrcVidInfo->height(); ++dstY, --srcY) {
-    const uint8_t* srcLine = srcBuf->buf() + mPitchBytes * srcY;
-    uint8_t* dstLine = dstBuf->buf() + mPitchBytes * dstY;   
-    memcpy(dstLine, srcLine, mPitchBytes);
-  }
+  uint32_t height = mSrcVidInfo->height();
+  TaskScheduler::instance().parallelFor(0, height, kGrainLines, [&](uint32_t startLine, uint32_t endLine) {
+    for (uint32_t dstY=startLine, srcY=height-1-startLine; dstY != endLine; ++dstY, --srcY) {
+      const uint8_t* srcLine = srcBuf->buf() + mPitchBytes * srcY;
+      uint8_t* dstLine = dstBuf->buf() + mPitchBytes * dstY;   
+      memcpy(dstLine, srcLine, mPitchBytes);
+    }
+  });
 
   printDebug(eDebug, "flip : %.2fms\n", t.delta());
   return mSrcFormatBytes;
@@ -164,8 +171,9 @@ NAN_METHOD(Flipper::Flip) {
   if (obj->mSrcFormatBytes > node::Buffer::Length(dstBufObj))
     return Nan::ThrowError("Insufficient destination buffer for specified format");
 
-  std::shared_ptr<FlipProcessData> fpd = std::make_shared<FlipProcessData>(srcBufObj, dstBufObj);
-  obj->mWorker->doFrame(fpd, obj, new Nan::Callback(callback));
+  std::shared_ptr<FlipProcessData> fpd = obj->mWorker->makeProcessData<FlipProcessData>(srcBufObj, dstBufObj);
+  if (!obj->mWorker->doFrame(fpd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -184,6 +192,14 @@ NAN_METHOD(Flipper::Quit) {
   info.GetReturnValue().SetUndefined();
 }
 
+NAN_METHOD(Flipper::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<Flipper>(info.Holder())->mWorker->setOptions("Flipper", info);
+}
+
+NAN_METHOD(Flipper::Stats) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Flipper>(info.Holder())->mWorker->stats());
+}
+
 NAN_MODULE_INIT(Flipper::Init) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Flipper").ToLocalChecked());
@@ -192,6 +208,8 @@ NAN_MODULE_INIT(Flipper::Init) {
   SetPrototypeMethod(tpl, "setInfo", SetInfo);
   SetPrototypeMethod(tpl, "flip", Flip);
   SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Flipper").ToLocalChecked(),
@@ -62,6 +62,8 @@ private:
   static NAN_METHOD(SetInfo);
   static NAN_METHOD(Flip);
   static NAN_METHOD(Quit);
+  static NAN_METHOD(SetWorkerOptions);
+  static NAN_METHOD(Stats);
 
   MyWorker *mWorker;
   bool mSetInfoOK;
@@ -0,0 +1,134 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <nan.h>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include "Memory.h"
+#include "Slab.h"
+
+using namespace v8;
+
+namespace streampunk {
+
+// Recycles the intermediate frame buffers that processors allocate per frame, keyed by size.
+// Buffers return to the pool when the last reference is released, normally as the
+// ProcessData holding them is destroyed.
+class FramePool {
+public:
+  static FramePool &instance() {
+    // deliberately never destroyed - buffers may be released during process exit
+    static FramePool *pool = new FramePool;
+    return *pool;
+  }
+
+  // returns an empty pointer when a new buffer cannot be allocated
+  std::shared_ptr<Memory> acquire(uint32_t numBytes) {
+    Memory *mem = NULL;
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      std::vector<Memory *> &freeList = mFree[numBytes];
+      if (!freeList.empty()) {
+        mem = freeList.back();
+        freeList.pop_back();
+        mFreeBytes -= numBytes;
+        ++mHits;
+      } else
+        ++mMisses;
+    }
+    if (!mem) {
+      // a failed allocation returns an empty pointer, so never reaches the pool
+      try {
+        mem = new Memory(numBytes);
+      } catch (std::bad_alloc&) {
+        return std::shared_ptr<Memory>();
+      }
+    }
+    return std::shared_ptr<Memory>(mem, [this](Memory *m) { release(m); }, SlabAllocator<Memory>(mSlab));
+  }
+
+  // releases all free buffers, for example so that new ones pick up a change of allocator
+  void clear() {
+    std::map<uint32_t, std::vector<Memory *> > freeBufs;
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      freeBufs.swap(mFree);
+      mFreeBytes = 0;
+    }
+    for (auto& f : freeBufs)
+      for (auto mem : f.second)
+        delete mem;
+  }
+
+  void addStats(Local<Object> stats) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    uint32_t numFree = 0;
+    for (auto& f : mFree)
+      numFree += (uint32_t)f.second.size();
+    Nan::Set(stats, Nan::New("hits").ToLocalChecked(), Nan::New((double)mHits));
+    Nan::Set(stats, Nan::New("misses").ToLocalChecked(), Nan::New((double)mMisses));
+    Nan::Set(stats, Nan::New("free").ToLocalChecked(), Nan::New(numFree));
+    Nan::Set(stats, Nan::New("freeBytes").ToLocalChecked(), Nan::New((double)mFreeBytes));
+
+    tHugePageState &hugePages = hugePageState();
+    Local<Object> hugePageStats = Nan::New<Object>();
+    Nan::Set(hugePageStats, Nan::New("mode").ToLocalChecked(), Nan::New(hugePageModeName(hugePages.mode)).ToLocalChecked());
+    Nan::Set(hugePageStats, Nan::New("explicit").ToLocalChecked(), Nan::New((double)hugePages.explicitAllocs));
+    Nan::Set(hugePageStats, Nan::New("transparent").ToLocalChecked(), Nan::New((double)hugePages.transparentAllocs));
+    Nan::Set(hugePageStats, Nan::New("heap").ToLocalChecked(), Nan::New((double)hugePages.heapAllocs));
+    Nan::Set(hugePageStats, Nan::New("unmapFailures").ToLocalChecked(), Nan::New((double)hugePages.unmapFailures));
+#ifdef __linux__
+    Nan::Set(hugePageStats, Nan::New("explicitPageBytes").ToLocalChecked(), Nan::New((double)explicitHugePageBytes()));
+    Nan::Set(hugePageStats, Nan::New("transparentPageBytes").ToLocalChecked(), Nan::New((double)transparentHugePageBytes()));
+#endif
+    Nan::Set(stats, Nan::New("hugePages").ToLocalChecked(), hugePageStats);
+  }
+
+private:
+  FramePool() : mSlab(std::make_shared<Slab>()), mFreeBytes(0), mHits(0), mMisses(0) {}
+
+  // enough for a few frames in flight per processor at UHD without holding memory indefinitely
+  static const uint32_t kMaxFreePerSize = 8;
+  static const uint64_t kMaxFreeBytes = 512ULL * 1024 * 1024;
+
+  void release(Memory *mem) {
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      std::vector<Memory *> &freeList = mFree[mem->numBytes()];
+      if ((freeList.size() < kMaxFreePerSize) && (mFreeBytes + mem->numBytes() <= kMaxFreeBytes)) {
+        freeList.push_back(mem);
+        mFreeBytes += mem->numBytes();
+        return;
+      }
+    }
+    delete mem;
+  }
+
+  std::mutex mMtx;
+  std::shared_ptr<Slab> mSlab;
+  std::map<uint32_t, std::vector<Memory *> > mFree;
+  uint64_t mFreeBytes;
+  uint64_t mHits;
+  uint64_t mMisses;
+};
+
+} // namespace streampunk
+
+#endif
@@ -0,0 +1,102 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef GOPAGGREGATOR_H
+#define GOPAGGREGATOR_H
+
+#include <memory>
+#include <vector>
+#include <cstring>
+#include "Memory.h"
+#include "FramePool.h"
+#include "iCodecDriver.h"
+
+namespace streampunk {
+
+// Collects encoded packets into one contiguous buffer per GOP, for segmenters that package whole
+// GOPs. A GOP is closed by the next key frame, or by the end of the stream. The buffer is taken
+// from the frame pool and grows by doubling - the size reached is kept for the next GOP so that
+// the pool can supply it directly.
+class GopAggregator {
+public:
+  GopAggregator() : mNumBytes(0), mCapacity(kMinBytes) {}
+
+  // replaces the packets from one submission, the first of which may be in dstData, with any
+  // GOPs that they close. Packet offsets are set within each GOP, and gopSizes gives the
+  // number of packets in each
+  void collect(const uint8_t *dstData, uint32_t dstBytes, std::vector<std::shared_ptr<Memory> > &packets,
+               std::vector<tPacketInfo> &packetInfos, std::vector<uint32_t> &gopSizes, bool endOfStream) {
+    std::vector<std::shared_ptr<Memory> > gops;
+    std::vector<tPacketInfo> gopInfos;
+    uint32_t p = 0;
+    for (uint32_t i = 0; i < packetInfos.size(); ++i) {
+      if (packetInfos[i].keyFrame && !mPacketInfos.empty())
+        close(gops, gopInfos, gopSizes);
+      const uint8_t *data = (dstBytes && (0 == i)) ? dstData : packets[p++]->buf();
+      add(data, packetInfos[i]);
+    }
+    if (endOfStream && !mPacketInfos.empty())
+      close(gops, gopInfos, gopSizes);
+
+    packets.swap(gops);
+    packetInfos.swap(gopInfos);
+  }
+
+private:
+  // a GOP of a few seconds at typical bitrates fits without growing
+  static const uint32_t kMinBytes = 1024 * 1024;
+
+  void add(const uint8_t *data, const tPacketInfo &packetInfo) {
+    reserve(mNumBytes + packetInfo.numBytes);
+    memcpy(mBuf->buf() + mNumBytes, data, packetInfo.numBytes);
+    mPacketInfos.push_back(packetInfo);
+    mPacketInfos.back().offset = mNumBytes;
+    mNumBytes += packetInfo.numBytes;
+  }
+
+  void reserve(uint32_t numBytes) {
+    if (mBuf && (numBytes <= mBuf->numBytes()))
+      return;
+    while (mCapacity < numBytes)
+      mCapacity *= 2;
+    std::shared_ptr<Memory> buf = FramePool::instance().acquire(mCapacity);
+    if (!buf)
+      throw std::runtime_error("Failed to allocate buffer for GOP aggregation");
+    if (mNumBytes)
+      memcpy(buf->buf(), mBuf->buf(), mNumBytes);
+    mBuf = buf;
+  }
+
+  void close(std::vector<std::shared_ptr<Memory> > &gops, std::vector<tPacketInfo> &gopInfos, std::vector<uint32_t> &gopSizes) {
+    // the GOP is handed out over the pooled buffer, which returns to the pool when released
+    std::shared_ptr<Memory> buf = mBuf;
+    gops.push_back(std::shared_ptr<Memory>(new Memory(buf->buf(), mNumBytes), [buf](Memory *mem) { delete mem; }));
+    gopInfos.insert(gopInfos.end(), mPacketInfos.begin(), mPacketInfos.end());
+    gopSizes.push_back((uint32_t)mPacketInfos.size());
+
+    mBuf.reset();
+    mNumBytes = 0;
+    mPacketInfos.clear();
+  }
+
+  std::shared_ptr<Memory> mBuf;
+  uint32_t mNumBytes;
+  uint32_t mCapacity;
+  std::vector<tPacketInfo> mPacketInfos;
+};
+
+} // namespace streampunk
+
+#endif
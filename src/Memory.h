@@ -17,9 +17,172 @@
 #define MEMORY_H
 
 #include <memory>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <cstdio>
+#include <sys/mman.h>
+#endif
 
 namespace streampunk {
 
+// cache line and widest SIMD register size - sizes are padded to a whole number of units
+// so that vector loads and stores at the end of a frame stay inside the allocation
+const uint32_t kMemoryAlignment = 64;
+
+inline uint8_t *alignedAlloc(size_t numBytes) {
+  size_t allocBytes = (numBytes + kMemoryAlignment - 1) & ~(size_t)(kMemoryAlignment - 1);
+#ifdef _WIN32
+  return (uint8_t *)_aligned_malloc(allocBytes, kMemoryAlignment);
+#else
+  void *buf = NULL;
+  if (posix_memalign(&buf, kMemoryAlignment, allocBytes))
+    buf = NULL;
+  return (uint8_t *)buf;
+#endif
+}
+
+inline void alignedFree(uint8_t *buf) {
+#ifdef _WIN32
+  _aligned_free(buf);
+#else
+  free(buf);
+#endif
+}
+
+// Frames of at least one huge page can be mapped directly rather than taken from the heap:
+//   off - heap allocation only
+//   transparent - anonymous mapping aligned to the transparent huge page size and advised for
+//                 transparent huge pages
+//   explicit - MAP_HUGETLB from the reserved pool of the default huge page size, falling back to
+//              transparent when the pool is exhausted or the frame is smaller than a page
+enum eHugePageMode { eHugePagesOff = 0, eHugePagesTransparent = 1, eHugePagesExplicit = 2 };
+const size_t kDefaultHugePageBytes = 2 * 1024 * 1024;
+
+struct tHugePageState {
+  tHugePageState()
+    : mode(eHugePagesOff), explicitAllocs(0), transparentAllocs(0), heapAllocs(0), unmapFailures(0) {}
+  std::atomic<int> mode;
+  std::atomic<uint64_t> explicitAllocs;
+  std::atomic<uint64_t> transparentAllocs;
+  std::atomic<uint64_t> heapAllocs;
+  std::atomic<uint64_t> unmapFailures;
+};
+
+inline tHugePageState &hugePageState() {
+  static tHugePageState state;
+  return state;
+}
+
+inline std::string hugePageModeName(int mode) {
+  return (eHugePagesExplicit == mode) ? "explicit" : (eHugePagesTransparent == mode) ? "transparent" : "off";
+}
+
+#ifdef __linux__
+// the size of the pages MAP_HUGETLB maps, as reported by the kernel - 2MB or 1GB on x86-64,
+// other sizes on other architectures
+inline size_t explicitHugePageBytes() {
+  static const size_t pageBytes = []() {
+    size_t kB = 0;
+    FILE *meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo) {
+      char line[128];
+      while (fgets(line, sizeof(line), meminfo))
+        if (1 == sscanf(line, "Hugepagesize: %zu kB", &kB))
+          break;
+      fclose(meminfo);
+    }
+    return kB ? kB * 1024 : kDefaultHugePageBytes;
+  }();
+  return pageBytes;
+}
+
+// the size of the pages that transparent huge pages are made of
+inline size_t transparentHugePageBytes() {
+  static const size_t pageBytes = []() {
+    size_t bytes = 0;
+    FILE *pmdSize = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+    if (pmdSize) {
+      if (1 != fscanf(pmdSize, "%zu", &bytes))
+        bytes = 0;
+      fclose(pmdSize);
+    }
+    return bytes ? bytes : kDefaultHugePageBytes;
+  }();
+  return pageBytes;
+}
+
+inline void frameUnmap(void *buf, size_t bytes) {
+  if (munmap(buf, bytes))
+    ++hugePageState().unmapFailures;
+}
+#endif
+
+// Allocates a frame buffer - mapBytes is set to the size of the mapping if it was mapped
+// rather than heap allocated and must be passed back to frameFree
+inline uint8_t *frameAlloc(size_t numBytes, size_t &mapBytes) {
+  mapBytes = 0;
+  tHugePageState &state = hugePageState();
+#ifdef __linux__
+  int mode = state.mode;
+  if ((eHugePagesExplicit == mode) && (numBytes >= explicitHugePageBytes())) {
+    // a hugetlb mapping must be a whole number of its pages, both to map and to unmap
+    size_t pageBytes = explicitHugePageBytes();
+    size_t bytes = (numBytes + pageBytes - 1) & ~(pageBytes - 1);
+    void *buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != buf) {
+      ++state.explicitAllocs;
+      mapBytes = bytes;
+      return (uint8_t *)buf;
+    }
+  }
+
+  size_t pageBytes = transparentHugePageBytes();
+  if ((eHugePagesOff != mode) && (numBytes >= pageBytes)) {
+    // over-map by a page then trim so the buffer starts on a huge page boundary - the trimmed
+    // ends are whole base pages of an ordinary mapping
+    size_t bytes = (numBytes + pageBytes - 1) & ~(pageBytes - 1);
+    void *raw = mmap(NULL, bytes + pageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED != raw) {
+      uintptr_t rawStart = (uintptr_t)raw;
+      uintptr_t start = (rawStart + pageBytes - 1) & ~(uintptr_t)(pageBytes - 1);
+      bool trimmed = true;
+      if (start > rawStart)
+        trimmed = (0 == munmap(raw, start - rawStart));
+      if (trimmed && (start + bytes < rawStart + bytes + pageBytes))
+        trimmed = (0 == munmap((void *)(start + bytes), rawStart + pageBytes - start));
+      if (trimmed) {
+        madvise((void *)start, bytes, MADV_HUGEPAGE);
+        ++state.transparentAllocs;
+        mapBytes = bytes;
+        return (uint8_t *)start;
+      }
+      // unmapping a range that is already unmapped is not an error, so this releases whatever
+      // the failed trim left
+      frameUnmap(raw, bytes + pageBytes);
+    }
+  }
+#endif
+  ++state.heapAllocs;
+  return alignedAlloc(numBytes);
+}
+
+inline void frameFree(uint8_t *buf, size_t mapBytes) {
+#ifdef __linux__
+  if (mapBytes) {
+    frameUnmap(buf, mapBytes);
+    return;
+  }
+#endif
+  alignedFree(buf);
+}
+
 class Memory {
 public:
   static std::shared_ptr<Memory> makeNew(uint32_t srcBytes) {
@@ -29,11 +192,15 @@ public:
     return std::make_shared<Memory>(buf, srcBytes);
   }
 
+  // throws std::bad_alloc, as new[] did, rather than hand out a buffer that was not allocated
   Memory(uint32_t numBytes) 
-    : mOwnAlloc(true), mNumBytes(numBytes), mBuf(new uint8_t[mNumBytes]) {}
+    : mOwnAlloc(true), mNumBytes(numBytes), mMapBytes(0), mBuf(frameAlloc(mNumBytes, mMapBytes)) {
+    if (!mBuf && mNumBytes)
+      throw std::bad_alloc();
+  }
   Memory(uint8_t *buf, uint32_t numBytes) 
-    : mOwnAlloc(false), mNumBytes(numBytes), mBuf(buf) {}
-  ~Memory() { if (mOwnAlloc) delete[] mBuf; }
+    : mOwnAlloc(false), mNumBytes(numBytes), mMapBytes(0), mBuf(buf) {}
+  ~Memory() { if (mOwnAlloc) frameFree(mBuf, mMapBytes); }
 
   uint32_t numBytes() const { return mNumBytes; }
   uint8_t *buf() const { return mBuf; }
@@ -41,9 +208,14 @@ public:
 private:
   const bool mOwnAlloc;
   const uint32_t mNumBytes;
+  size_t mMapBytes;
   uint8_t *const mBuf;
 };
 
+inline uint64_t memoryBytes(const std::shared_ptr<Memory> &mem) {
+  return mem ? mem->numBytes() : 0;
+}
+
 } // namespace streampunk
 
 #endif
\ No newline at end of file
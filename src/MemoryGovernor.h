@@ -0,0 +1,86 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <nan.h>
+#include <mutex>
+
+using namespace v8;
+
+namespace streampunk {
+
+// Tracks the frame memory pinned by frames in flight across all processors - from submission
+// until the frame callback is made or, for a frame a codec still holds, until it is released,
+// even after the processor has quit - and refuses new frames that would exceed the budget.
+class MemoryGovernor {
+public:
+  static MemoryGovernor &instance() {
+    // deliberately never destroyed, as for the workers that report to it
+    static MemoryGovernor *governor = new MemoryGovernor;
+    return *governor;
+  }
+
+  // a budget of zero is unlimited
+  void setBudget(uint64_t budgetBytes) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mBudgetBytes = budgetBytes;
+  }
+
+  // returns false if the bytes cannot be reserved within the budget
+  bool reserve(uint64_t numBytes) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    if (mBudgetBytes && (mInFlightBytes + numBytes > mBudgetBytes)) {
+      ++mRefused;
+      return false;
+    }
+    mInFlightBytes += numBytes;
+    if (mInFlightBytes > mPeakBytes)
+      mPeakBytes = mInFlightBytes;
+    return true;
+  }
+
+  void release(uint64_t numBytes) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    mInFlightBytes -= numBytes;
+  }
+
+  uint64_t budgetBytes() {
+    std::lock_guard<std::mutex> lk(mMtx);
+    return mBudgetBytes;
+  }
+
+  void addStats(Local<Object> stats) {
+    std::lock_guard<std::mutex> lk(mMtx);
+    Nan::Set(stats, Nan::New("budget").ToLocalChecked(), Nan::New((double)mBudgetBytes));
+    Nan::Set(stats, Nan::New("inFlight").ToLocalChecked(), Nan::New((double)mInFlightBytes));
+    Nan::Set(stats, Nan::New("peak").ToLocalChecked(), Nan::New((double)mPeakBytes));
+    Nan::Set(stats, Nan::New("refused").ToLocalChecked(), Nan::New((double)mRefused));
+  }
+
+private:
+  MemoryGovernor() : mBudgetBytes(0), mInFlightBytes(0), mPeakBytes(0), mRefused(0) {}
+
+  std::mutex mMtx;
+  uint64_t mBudgetBytes;
+  uint64_t mInFlightBytes;
+  uint64_t mPeakBytes;
+  uint64_t mRefused;
+};
+
+} // namespace streampunk
+
+#endif
@@ -18,9 +18,18 @@
 
 #include <nan.h>
 #include <queue>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <chrono>
+#include <atomic>
+#include "WorkerOptions.h"
+#include "Autoscaler.h"
+#include "MemoryGovernor.h"
+#include "Slab.h"
+#include "iProcess.h"
+#include "Memory.h"
 
 using namespace v8;
 
@@ -34,7 +43,7 @@ public:
   
   void enqueue(T t) {
     std::lock_guard<std::mutex> lk(m);
-    qu.push(t);
+    qu.push(std::move(t));
     cv.notify_one();
   }
   
@@ -59,21 +68,134 @@ private:
   std::condition_variable cv;
 };
 
-class iProcess;
-class iProcessData;
 class MyWorker : public Nan::AsyncProgressWorker {
 public:
   MyWorker (Nan::Callback *callback)
-    : Nan::AsyncProgressWorker(callback), mActive(true) {}
-  ~MyWorker() {}
+    : Nan::AsyncProgressWorker(callback), mActive(true),
+      mOptions(std::make_shared<WorkerOptions>()), mOptionsChanged(false), mOptionsStatus("default"),
+      mSlab(std::make_shared<Slab>()), mReleaseQueue(std::make_shared<tReleaseQueue>()), mNumHeld(std::make_shared<std::atomic<uint32_t> >(0)),
+      mCallbackAllocs(0),
+      mBytesInFlight(0), mPeakBytesInFlight(0), mRefused(0) {}
+  ~MyWorker() {
+    for (auto cb : mFreeCallbacks)
+      delete cb;
+  }
+
+  // process data for this worker's frames is allocated from its slab
+  template <class T, class... Args>
+  std::shared_ptr<T> makeProcessData(Args&&... args) {
+    return std::allocate_shared<T>(SlabAllocator<T>(mSlab), std::forward<Args>(args)...);
+  }
+  std::shared_ptr<Slab> slab() const { return mSlab; }
+
+  // A reference to memory belonging to the process data, for a codec that may keep it beyond
+  // processFrame, such as an encoder holding source frames for lookahead. The reference owns the
+  // process data, with its JS handles, and on release hands it to the JS thread to be destroyed
+  // there. The frame's callback does not wait for the release.
+  std::shared_ptr<Memory> holdRef(std::shared_ptr<iProcessData> processData, Memory *mem) {
+    std::shared_ptr<tReleaseQueue> releaseQueue = mReleaseQueue;
+    std::shared_ptr<std::atomic<uint32_t> > numHeld = mNumHeld;
+    ++*numHeld;
+    ++processData->holdState().holds;
+    // the process data is moved into the queue so that the last reference is never dropped here
+    return std::shared_ptr<Memory>(mem, [processData, releaseQueue, numHeld](Memory *) mutable {
+      iProcessData::tHoldState &holdState = processData->holdState();
+      if (0 == --holdState.holds)
+        releaseReserved(holdState);
+      releaseQueue->enqueue(std::move(processData));
+      --*numHeld;
+    });
+  }
 
   uint32_t numQueued() {
     return (uint32_t)mWorkQueue.size();
   }
 
-  void doFrame(std::shared_ptr<iProcessData> processData, iProcess *process, Nan::Callback *frameCallback) {
-    mWorkQueue.enqueue (
-      std::make_shared<WorkParams>(processData, process, frameCallback));
+  // options are applied by the worker thread before it processes the next frame
+  void setOptions(std::shared_ptr<WorkerOptions> options) {
+    bool numaChanged;
+    {
+      std::lock_guard<std::mutex> lk(mOptionsMtx);
+      numaChanged = options->numaNode() != mOptions->numaNode();
+      mOptions = options;
+      mOptionsChanged = true;
+      mOptionsStatus = "pending";
+    }
+    // memory policy only places pages as they are first touched, so this worker's pooled blocks
+    // stay on their old node - they are released for new ones to be allocated on the new one. The
+    // frame pool is shared by every processor in the process, so it is left as it is
+    if (numaChanged)
+      mSlab->clear();
+  }
+
+  // setWorkerOptions(options) for the named processor - throws a JS error for invalid options
+  void setOptions(const char *processor, const Nan::FunctionCallbackInfo<Value>& info) {
+    if (info.Length() != 1)
+      return Nan::ThrowError((std::string(processor) + " setWorkerOptions expects 1 argument").c_str());
+    if (!info[0]->IsObject())
+      return Nan::ThrowError((std::string(processor) + " setWorkerOptions requires a valid options object as the parameter").c_str());
+    try {
+      setOptions(std::make_shared<WorkerOptions>(Local<Object>::Cast(info[0])));
+    } catch (std::exception& err) {
+      return Nan::ThrowError(err.what());
+    }
+    info.GetReturnValue().SetUndefined();
+  }
+
+  int32_t numaNode() {
+    std::lock_guard<std::mutex> lk(mOptionsMtx);
+    return mOptions->numaNode();
+  }
+
+  // the stats common to every processor, to which a processor adds its own
+  Local<Object> stats() {
+    Local<Object> stats = Nan::New<Object>();
+    addStats(stats);
+    return stats;
+  }
+
+  void addStats(Local<Object> stats) {
+    Nan::Set(stats, Nan::New("queued").ToLocalChecked(), Nan::New(numQueued()));
+    Nan::Set(stats, Nan::New("bytesInFlight").ToLocalChecked(), Nan::New((double)mBytesInFlight));
+    Nan::Set(stats, Nan::New("peakBytesInFlight").ToLocalChecked(), Nan::New((double)mPeakBytesInFlight));
+    Nan::Set(stats, Nan::New("refused").ToLocalChecked(), Nan::New((double)mRefused));
+    Nan::Set(stats, Nan::New("held").ToLocalChecked(), Nan::New((uint32_t)*mNumHeld));
+    Local<Object> allocStats = Nan::New<Object>();
+    // only the allocations the slab and callback recycling exist to avoid are counted - not those
+    // made by codecs, V8 or elsewhere
+    Nan::Set(allocStats, Nan::New("slabNew").ToLocalChecked(), Nan::New((double)mSlab->allocs()));
+    Nan::Set(allocStats, Nan::New("slabReused").ToLocalChecked(), Nan::New((double)mSlab->reuses()));
+    Nan::Set(allocStats, Nan::New("callbacksNew").ToLocalChecked(), Nan::New((double)mCallbackAllocs));
+    Nan::Set(stats, Nan::New("allocs").ToLocalChecked(), allocStats);
+    std::lock_guard<std::mutex> lk(mOptionsMtx);
+    Local<Object> workerStats = Nan::New<Object>();
+    mOptions->addStats(workerStats);
+    Nan::Set(workerStats, Nan::New("status").ToLocalChecked(), Nan::New(mOptionsStatus).ToLocalChecked());
+    Nan::Set(stats, Nan::New("worker").ToLocalChecked(), workerStats);
+  }
+
+  // Returns false, having thrown a JS error, if the frame would take the memory in flight over the
+  // global budget. The frame's bytes are accounted until its callback is made.
+  bool doFrame(std::shared_ptr<iProcessData> processData, iProcess *process, Local<Function> frameCallback) {
+    uint64_t numBytes = processData->numBytes();
+    MemoryGovernor &governor = MemoryGovernor::instance();
+    if (!governor.reserve(numBytes)) {
+      ++mRefused;
+      std::string err = std::string("Memory budget of ") + std::to_string(governor.budgetBytes()) + 
+        " bytes exceeded - frame of " + std::to_string(numBytes) + " bytes refused with " + 
+        std::to_string(mBytesInFlight) + " bytes in flight on this processor";
+      Nan::ThrowError(err.c_str());
+      return false;
+    }
+    mBytesInFlight += numBytes;
+    if (mBytesInFlight > mPeakBytesInFlight)
+      mPeakBytesInFlight = mBytesInFlight;
+
+    std::shared_ptr<WorkParams> wp = std::allocate_shared<WorkParams>(SlabAllocator<WorkParams>(mSlab), 
+      processData, process, acquireCallback(frameCallback));
+    wp->mNumBytes = numBytes;
+    mWorkQueue.enqueue(wp);
+    return true;
   }
 
   void quit(Nan::Callback *callback) {
@@ -85,6 +207,9 @@ private:
     // Asynchronous, non-V8 work goes here
     while (mActive) {
       std::shared_ptr<WorkParams> wp = mWorkQueue.dequeue();
+      Autoscaler::instance().recordWait(this,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wp->mQueued).count());
+      applyOptions();
       if (wp->mProcess)
         wp->mResultBytes = wp->mProcess->processFrame(wp->mProcessData);
       else
@@ -92,19 +217,71 @@ private:
       mDoneQueue.enqueue(wp);
       progress.Send(NULL, 0);
     }
+    // the thread is about to be handed back, with no status left to report a failure to
+    mThreadSettings.restore();
+    Autoscaler::instance().removeWorker(this);
 
     // wait for quit message to be passed to callback
     std::unique_lock<std::mutex> lk(mMtx);
     mCv.wait(lk);
   }
   
+  void applyOptions() {
+    std::lock_guard<std::mutex> lk(mOptionsMtx);
+    if (!mOptionsChanged)
+      return;
+    mOptionsChanged = false;
+    std::string restoreErr = mThreadSettings.restore();
+    if (!restoreErr.empty())
+      restoreErr = std::string("restore failed: ") + restoreErr;
+    if (mOptions->isDefault()) {
+      mOptionsStatus = restoreErr.empty() ? "default" : restoreErr;
+      return;
+    }
+    mThreadSettings.save();
+    std::string err = restoreErr + mOptions->apply();
+    mOptionsStatus = err.empty() ? "applied" : err;
+  }
+
   void HandleProgressCallback(const char *data, size_t size) {
     Nan::HandleScope scope;
-    while (mDoneQueue.size() != 0)
-    {
+    // process data released by a codec is destroyed here, with its JS handles
+    while (mReleaseQueue->size() != 0)
+      mReleaseQueue->dequeue();
+
+    while (mDoneQueue.size() != 0) {
       std::shared_ptr<WorkParams> wp = mDoneQueue.dequeue();
-      Local<Value> argv[] = { Nan::Null(), Nan::New(wp->mResultBytes) };
-      wp->mCallback->Call(2, argv, async_resource);
+      mBytesInFlight -= wp->mNumBytes;
+      if (wp->mProcessData) {
+        // a frame a codec still holds keeps its memory, so its bytes stay reserved until released
+        iProcessData::tHoldState &holdState = wp->mProcessData->holdState();
+        holdState.reservedBytes = wp->mNumBytes;
+        if (0 == holdState.holds)
+          releaseReserved(holdState);
+      }
+
+      // callback arguments are (err, resultBytes[, resultBufs[, resultInfo]])
+      Local<Value> argv[] = { Nan::Null(), Nan::New(wp->mResultBytes), Nan::Undefined(), Nan::Undefined() };
+      int argc = 2;
+      if (wp->mProcessData) {
+        if (!wp->mProcessData->error().empty())
+          argv[0] = Nan::Error(wp->mProcessData->error().c_str());
+        std::vector<std::shared_ptr<Memory> > resultBufs = wp->mProcessData->resultBufs();
+        if (!resultBufs.empty()) {
+          Local<Array> bufArray = Nan::New<Array>((int)resultBufs.size());
+          for (uint32_t i = 0; i < resultBufs.size(); ++i)
+            Nan::Set(bufArray, i, Nan::NewBuffer((char *)resultBufs[i]->buf(), resultBufs[i]->numBytes(), 
+              freeResultBuf, new std::shared_ptr<Memory>(resultBufs[i])).ToLocalChecked());
+          argv[2] = bufArray;
+          argc = 3;
+        }
+        argv[3] = wp->mProcessData->resultInfo();
+        if (!argv[3]->IsUndefined())
+          argc = 4;
+      }
+      wp->mCallback->Call(argc, argv, async_resource);
+      recycleCallback(wp->mCallback);
+      wp->mCallback = NULL;
 
       if (!wp->mProcess && !mActive) {
         // notify the thread to exit
@@ -112,17 +289,51 @@ private:
         mCv.notify_one();
       }
     }
+    Autoscaler::instance().evaluate(async_resource);
   }
   
+  // releases a frame's reserved bytes once its callback has been made and no codec holds it -
+  // called by whichever of the two is last, on either thread, and releases them only once
+  static void releaseReserved(iProcessData::tHoldState &holdState) {
+    uint64_t numBytes = holdState.reservedBytes.exchange(0);
+    if (numBytes)
+      MemoryGovernor::instance().release(numBytes);
+  }
+
+  // frame callbacks are reused rather than allocated for every frame - JS thread only
+  Nan::Callback *acquireCallback(Local<Function> fn) {
+    if (mFreeCallbacks.empty()) {
+      ++mCallbackAllocs;
+      return new Nan::Callback(fn);
+    }
+    Nan::Callback *cb = mFreeCallbacks.back();
+    mFreeCallbacks.pop_back();
+    cb->Reset(fn);
+    return cb;
+  }
+
+  void recycleCallback(Nan::Callback *cb) {
+    cb->Reset();
+    mFreeCallbacks.push_back(cb);
+  }
+
+  // the result memory is held until the Buffer that exposes it is garbage collected
+  static void freeResultBuf(char *data, void *hint) {
+    delete (std::shared_ptr<Memory> *)hint;
+  }
+
   void HandleOKCallback() {
     Nan::HandleScope scope;
+    while (mReleaseQueue->size() != 0)
+      mReleaseQueue->dequeue();
     callback->Call(0, NULL, async_resource);
   }
 
   bool mActive;
   struct WorkParams {
     WorkParams(std::shared_ptr<iProcessData> processData, iProcess *process, Nan::Callback *callback)
-      : mProcessData(processData), mProcess(process), mCallback(callback), mResultBytes(0) {}
+      : mProcessData(processData), mProcess(process), mCallback(callback), mResultBytes(0), mNumBytes(0),
+        mQueued(std::chrono::steady_clock::now()) {}
     ~WorkParams() { 
       delete mCallback;
     }
@@ -131,11 +342,33 @@ private:
     iProcess *mProcess;
     Nan::Callback *mCallback;
     uint32_t mResultBytes;
+    uint64_t mNumBytes;
+    std::chrono::steady_clock::time_point mQueued;
   };
   WorkQueue<std::shared_ptr<WorkParams> > mWorkQueue;
   WorkQueue<std::shared_ptr<WorkParams> > mDoneQueue;
   std::mutex mMtx;
   std::condition_variable mCv;
+
+  std::shared_ptr<WorkerOptions> mOptions;
+  bool mOptionsChanged;
+  std::string mOptionsStatus;
+  std::mutex mOptionsMtx;
+  ThreadSettings mThreadSettings;
+
+  std::shared_ptr<Slab> mSlab;
+
+  // shared with the references handed out by holdRef, which may outlive the worker
+  typedef WorkQueue<std::shared_ptr<iProcessData> > tReleaseQueue;
+  std::shared_ptr<tReleaseQueue> mReleaseQueue;
+  std::shared_ptr<std::atomic<uint32_t> > mNumHeld;
+
+  // accessed on the JS thread only
+  std::vector<Nan::Callback *> mFreeCallbacks;
+  uint64_t mCallbackAllocs;
+  uint64_t mBytesInFlight;
+  uint64_t mPeakBytesInFlight;
+  uint64_t mRefused;
 };
 
 } // namespace streampunk
@@ -31,21 +31,21 @@ namespace streampunk {
 class PackerProcessData : public iProcessData {
 public:
   PackerProcessData (Local<Object> srcBufObj, Local<Object> dstBufObj)
-    : mPersistentSrcBuf(new Persist(srcBufObj)),
-      mPersistentDstBuf(new Persist(dstBufObj)),
-      mSrcBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj))),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)))
+    : mPersistentSrcBuf(srcBufObj), mPersistentDstBuf(dstBufObj),
+      mSrcBuf((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)),
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))
   { }
   ~PackerProcessData() { }
   
-  std::shared_ptr<Memory> srcBuf() const { return mSrcBuf; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> srcBuf() { return share(mSrcBuf); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
+  uint64_t numBytes() const { return mSrcBuf.numBytes() + mDstBuf.numBytes(); }
 
 private:
-  std::unique_ptr<Persist> mPersistentSrcBuf;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::shared_ptr<Memory> mSrcBuf;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentSrcBuf;
+  Persist mPersistentDstBuf;
+  Memory mSrcBuf;
+  Memory mDstBuf;
 };
 
 Packer::Packer(Nan::Callback *callback) 
@@ -153,8 +153,9 @@ NAN_METHOD(Packer::Pack) {
     return Nan::ThrowError("Insufficient destination buffer for specified format");
 
   std::shared_ptr<iProcessData> ppd = 
-    std::make_shared<PackerProcessData>(srcBufObj, dstBufObj);
-  obj->mWorker->doFrame(ppd, obj, new Nan::Callback(callback));
+    obj->mWorker->makeProcessData<PackerProcessData>(srcBufObj, dstBufObj);
+  if (!obj->mWorker->doFrame(ppd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -173,6 +174,14 @@ NAN_METHOD(Packer::Quit) {
   info.GetReturnValue().SetUndefined();
 }
 
+NAN_METHOD(Packer::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<Packer>(info.Holder())->mWorker->setOptions("Packer", info);
+}
+
+NAN_METHOD(Packer::Stats) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Packer>(info.Holder())->mWorker->stats());
+}
+
 NAN_MODULE_INIT(Packer::Init) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Packer").ToLocalChecked());
@@ -181,6 +190,8 @@ NAN_MODULE_INIT(Packer::Init) {
   SetPrototypeMethod(tpl, "setInfo", SetInfo);
   SetPrototypeMethod(tpl, "pack", Pack);
   SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Packer").ToLocalChecked(),
@@ -16,6 +16,7 @@
 #include <nan.h>
 #include "Packers.h"
 #include "Memory.h"
+#include "TaskScheduler.h"
 
 // V210: https://developer.apple.com/library/mac/technotes/tn2162/_index.html#//apple_ref/doc/uid/DTS40013070-CH1-TNTAG8-V210__4_2_2_COMPRESSION_TYPE
 // 420P: https://en.wikipedia.org/wiki/YUV
@@ -28,6 +29,8 @@
 
 namespace streampunk {
 
+static const uint32_t kGrainLines = 16;
+
 uint32_t getFormatBytes(const std::string& fmtCode, uint32_t width, uint32_t height, bool hasAlpha) {
   uint32_t fmtBytes = 0;
   if (0 == fmtCode.compare("420P")) {
@@ -194,11 +197,14 @@ Packers::Packers(uint32_t srcWidth, uint32_t srcHeight, const std::string& srcFm
 }
 
 void Packers::convert(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf) const {
-  mConvertFn(*this, srcBuf->buf(), dstBuf->buf());
+  // slices start on an even line so that 420P chroma line pairs are never split
+  TaskScheduler::instance().parallelFor(0, mSrcHeight, kGrainLines, [&](uint32_t startLine, uint32_t endLine) {
+    mConvertFn(*this, srcBuf->buf(), dstBuf->buf(), startLine, endLine);
+  });
 }
 
 // private
-void Packers::convertYUV422P10toUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertYUV422P10toUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcLumaPitchBytes = mSrcWidth * 2;
   uint32_t srcChromaPitchBytes = mSrcWidth;
   uint32_t srcLumaPlaneBytes = srcLumaPitchBytes * mSrcHeight;
@@ -209,7 +215,12 @@ void Packers::convertYUV422P10toUYVY10 (const uint8_t *const srcBuf, uint8_t *co
   const uint8_t *srcVLine = srcBuf + srcLumaPlaneBytes + srcLumaPlaneBytes / 2;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcYLine += startLine * srcLumaPitchBytes;
+  srcULine += startLine * srcChromaPitchBytes;
+  srcVLine += startLine * srcChromaPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcYInts = (uint32_t *)srcYLine;
     const uint32_t *srcUInts = (uint32_t *)srcULine;
     const uint32_t *srcVInts = (uint32_t *)srcVLine;
@@ -238,14 +249,17 @@ void Packers::convertYUV422P10toUYVY10 (const uint8_t *const srcBuf, uint8_t *co
   }  
 }
 
-void Packers::convertPGrouptoUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertPGrouptoUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = mSrcWidth * 5 / 2;
   uint32_t dstPitchBytes = mSrcWidth * 4;
 
   const uint8_t *srcLine = srcBuf;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint8_t *srcBytes = srcLine;
     uint32_t *dstInts = (uint32_t *)dstLine;
 
@@ -267,7 +281,7 @@ void Packers::convertPGrouptoUYVY10 (const uint8_t *const srcBuf, uint8_t *const
   }  
 }
 
-void Packers::convertPGrouptoYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertPGrouptoYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = mSrcWidth * 5 / 2;
   uint32_t dstLumaPitchBytes = mSrcWidth * 2;
   uint32_t dstChromaPitchBytes = mSrcWidth;
@@ -278,7 +292,12 @@ void Packers::convertPGrouptoYUV422P10 (const uint8_t *const srcBuf, uint8_t *co
   uint8_t *dstULine = dstBuf + dstLumaPlaneBytes;
   uint8_t *dstVLine = dstBuf + dstLumaPlaneBytes + dstLumaPlaneBytes / 2;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstYLine += startLine * dstLumaPitchBytes;
+  dstULine += startLine * dstChromaPitchBytes;
+  dstVLine += startLine * dstChromaPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint8_t *srcBytes = srcLine;
     uint16_t *dstYShorts = (uint16_t *)dstYLine;
     uint16_t *dstUShorts = (uint16_t *)dstULine;
@@ -311,7 +330,7 @@ void Packers::convertPGrouptoYUV422P10 (const uint8_t *const srcBuf, uint8_t *co
   }
 }
 
-void Packers::convertV210toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertV210toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = ((mSrcWidth + 47) / 48) * 48 * 8 / 3;
   uint32_t dstLumaPitchBytes = mSrcWidth * 2;
   uint32_t dstChromaPitchBytes = mSrcWidth;
@@ -322,7 +341,12 @@ void Packers::convertV210toYUV422P10 (const uint8_t *const srcBuf, uint8_t *cons
   uint8_t *dstULine = dstBuf + dstLumaPlaneBytes;
   uint8_t *dstVLine = dstBuf + dstLumaPlaneBytes + dstLumaPlaneBytes / 2;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstYLine += startLine * dstLumaPitchBytes;
+  dstULine += startLine * dstChromaPitchBytes;
+  dstVLine += startLine * dstChromaPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     uint32_t *srcInts = (uint32_t *)srcLine;
     uint32_t *dstYInts = (uint32_t *)dstYLine;
     uint16_t *dstUShorts = (uint16_t *)dstULine;
@@ -380,7 +404,7 @@ void Packers::convertV210toYUV422P10 (const uint8_t *const srcBuf, uint8_t *cons
   }
 }
 
-void Packers::convertPGroupto420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertPGroupto420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = mSrcWidth * 5 / 2;
   uint32_t dstLumaPitchBytes = mSrcWidth;
   uint32_t dstChromaPitchBytes = mSrcWidth / 2;
@@ -391,7 +415,12 @@ void Packers::convertPGroupto420P (const uint8_t *const srcBuf, uint8_t *const d
   uint8_t *dstULine = dstBuf + dstLumaPlaneBytes;
   uint8_t *dstVLine = dstBuf + dstLumaPlaneBytes + dstLumaPlaneBytes / 4;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstYLine += startLine * dstLumaPitchBytes;
+  dstULine += (startLine / 2) * dstChromaPitchBytes;
+  dstVLine += (startLine / 2) * dstChromaPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint8_t *srcBytes = srcLine;
     uint8_t *dstYBytes = dstYLine;
     uint8_t *dstUBytes = dstULine;
@@ -428,7 +457,7 @@ void Packers::convertPGroupto420P (const uint8_t *const srcBuf, uint8_t *const d
   }
 }
 
-void Packers::convertV210to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertV210to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = ((mSrcWidth + 47) / 48) * 48 * 8 / 3;
   uint32_t dstLumaPitchBytes = mSrcWidth;
   uint32_t dstChromaPitchBytes = mSrcWidth / 2;
@@ -439,7 +468,12 @@ void Packers::convertV210to420P (const uint8_t *const srcBuf, uint8_t *const dst
   uint8_t *dstULine = dstBuf + dstLumaPlaneBytes;
   uint8_t *dstVLine = dstBuf + dstLumaPlaneBytes + dstLumaPlaneBytes / 4;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstYLine += startLine * dstLumaPitchBytes;
+  dstULine += (startLine / 2) * dstChromaPitchBytes;
+  dstVLine += (startLine / 2) * dstChromaPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     uint32_t *srcInts = (uint32_t *)srcLine;
     uint8_t *dstYBytes = dstYLine;
     uint8_t *dstUBytes = dstULine;
@@ -506,14 +540,17 @@ void Packers::convertV210to420P (const uint8_t *const srcBuf, uint8_t *const dst
   }
 }
 
-void Packers::convertUYVY10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertUYVY10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = mSrcWidth * 4;
   uint32_t dstPitchBytes = mSrcWidth * 5 / 2;
 
   const uint8_t *srcLine = srcBuf;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcInts = (uint32_t *)srcLine;
     uint8_t *dstBytes = dstLine;
 
@@ -535,7 +572,7 @@ void Packers::convertUYVY10toPGroup (const uint8_t *const srcBuf, uint8_t *const
   }  
 }
 
-void Packers::convertUYVY10toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertUYVY10toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = mSrcWidth * 4;
   uint32_t dstLumaPitchBytes = mSrcWidth * 2;
   uint32_t dstChromaPitchBytes = mSrcWidth;
@@ -546,7 +583,12 @@ void Packers::convertUYVY10toYUV422P10 (const uint8_t *const srcBuf, uint8_t *co
   uint8_t *dstULine = dstBuf + dstLumaPlaneBytes;
   uint8_t *dstVLine = dstBuf + dstLumaPlaneBytes + dstLumaPlaneBytes / 2;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstYLine += startLine * dstLumaPitchBytes;
+  dstULine += startLine * dstChromaPitchBytes;
+  dstVLine += startLine * dstChromaPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcInts = (uint32_t *)srcLine;
     uint32_t *dstYInts = (uint32_t *)dstYLine;
     uint32_t *dstUInts = (uint32_t *)dstULine;
@@ -575,7 +617,7 @@ void Packers::convertUYVY10toYUV422P10 (const uint8_t *const srcBuf, uint8_t *co
   }  
 }
 
-void Packers::convertUYVY10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertUYVY10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = mSrcWidth * 4;
   uint32_t dstLumaPitchBytes = mSrcWidth;
   uint32_t dstChromaPitchBytes = mSrcWidth / 2;
@@ -586,7 +628,12 @@ void Packers::convertUYVY10to420P (const uint8_t *const srcBuf, uint8_t *const d
   uint8_t *dstULine = dstBuf + dstLumaPlaneBytes;
   uint8_t *dstVLine = dstBuf + dstLumaPlaneBytes + dstLumaPlaneBytes / 4;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstYLine += startLine * dstLumaPitchBytes;
+  dstULine += (startLine / 2) * dstChromaPitchBytes;
+  dstVLine += (startLine / 2) * dstChromaPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcInts = (uint32_t *)srcLine;
     uint8_t *dstYBytes = dstYLine;
     uint8_t *dstUBytes = dstULine;
@@ -617,7 +664,7 @@ void Packers::convertUYVY10to420P (const uint8_t *const srcBuf, uint8_t *const d
   }  
 }
 
-void Packers::convertYUV422P10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertYUV422P10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcLumaPitchBytes = mSrcWidth * 2;
   uint32_t srcChromaPitchBytes = mSrcWidth;
   uint32_t srcLumaPlaneBytes = srcLumaPitchBytes * mSrcHeight;
@@ -639,7 +686,12 @@ void Packers::convertYUV422P10to420P (const uint8_t *const srcBuf, uint8_t *cons
   dstLine[2] = dstBuf + dstLumaPlaneBytes + dstChromaPlaneBytes;
 
   for (uint32_t p=0; p<3; ++p) {
-    for (uint32_t y=0; y<mSrcHeight; ++y) {
+    srcLine[p] += startLine * ((0==p) ? srcLumaPitchBytes : srcChromaPitchBytes);
+    dstLine[p] += ((0==p) ? startLine : startLine / 2) * ((0==p) ? dstLumaPitchBytes : dstChromaPitchBytes);
+  }
+
+  for (uint32_t p=0; p<3; ++p) {
+    for (uint32_t y=startLine; y<endLine; ++y) {
       bool evenLine = (y & 1) == 0;
       const uint32_t *srcL = (const uint32_t *)srcLine[p];
       const uint16_t *srcC = (const uint16_t *)srcLine[p];
@@ -668,7 +720,7 @@ void Packers::convertYUV422P10to420P (const uint8_t *const srcBuf, uint8_t *cons
   }
 }
 
-void Packers::convertYUV422P10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertYUV422P10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcLumaPitchBytes = mSrcWidth * 2;
   uint32_t srcChromaPitchBytes = mSrcWidth;
   uint32_t srcLumaPlaneBytes = srcLumaPitchBytes * mSrcHeight;
@@ -679,7 +731,12 @@ void Packers::convertYUV422P10toPGroup (const uint8_t *const srcBuf, uint8_t *co
   const uint8_t *srcVLine = srcBuf + srcLumaPlaneBytes + srcLumaPlaneBytes / 2;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcYLine += startLine * srcLumaPitchBytes;
+  srcULine += startLine * srcChromaPitchBytes;
+  srcVLine += startLine * srcChromaPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcYInts = (uint32_t *)srcYLine;
     const uint16_t *srcUShorts = (uint16_t *)srcULine;
     const uint16_t *srcVShorts = (uint16_t *)srcVLine;
@@ -708,7 +765,7 @@ void Packers::convertYUV422P10toPGroup (const uint8_t *const srcBuf, uint8_t *co
   }  
 }
 
-void Packers::convert420PtoPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convert420PtoPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcLumaPitchBytes = mSrcWidth;
   uint32_t srcChromaPitchBytes = mSrcWidth / 2;
   uint32_t srcLumaPlaneBytes = srcLumaPitchBytes * mSrcHeight;
@@ -719,7 +776,12 @@ void Packers::convert420PtoPGroup (const uint8_t *const srcBuf, uint8_t *const d
   const uint8_t *srcVLine = srcBuf + srcLumaPlaneBytes + srcLumaPlaneBytes / 4;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcYLine += startLine * srcLumaPitchBytes;
+  srcULine += (startLine / 2) * srcChromaPitchBytes;
+  srcVLine += (startLine / 2) * srcChromaPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint8_t *srcYBytes = srcYLine;
     const uint8_t *srcUBytes = srcULine;
     const uint8_t *srcVBytes = srcVLine;
@@ -752,7 +814,7 @@ void Packers::convert420PtoPGroup (const uint8_t *const srcBuf, uint8_t *const d
   }  
 }
 
-void Packers::convertYUV422P10toV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertYUV422P10toV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcLumaPitchBytes = mSrcWidth * 2;
   uint32_t srcChromaPitchBytes = mSrcWidth;
   uint32_t srcLumaPlaneBytes = srcLumaPitchBytes * mSrcHeight;
@@ -763,7 +825,12 @@ void Packers::convertYUV422P10toV210 (const uint8_t *const srcBuf, uint8_t *cons
   const uint8_t *srcVLine = srcBuf + srcLumaPlaneBytes + srcLumaPlaneBytes / 2;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcYLine += startLine * srcLumaPitchBytes;
+  srcULine += startLine * srcChromaPitchBytes;
+  srcVLine += startLine * srcChromaPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcYInts = (uint32_t *)srcYLine;
     const uint16_t *srcUShorts = (uint16_t *)srcULine;
     const uint16_t *srcVShorts = (uint16_t *)srcVLine;
@@ -820,7 +887,7 @@ void Packers::convertYUV422P10toV210 (const uint8_t *const srcBuf, uint8_t *cons
   }  
 }
 
-void Packers::convert420PtoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convert420PtoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcLumaPitchBytes = mSrcWidth;
   uint32_t srcChromaPitchBytes = mSrcWidth / 2;
   uint32_t srcLumaPlaneBytes = srcLumaPitchBytes * mSrcHeight;
@@ -831,7 +898,12 @@ void Packers::convert420PtoV210 (const uint8_t *const srcBuf, uint8_t *const dst
   const uint8_t *srcVLine = srcBuf + srcLumaPlaneBytes + srcLumaPlaneBytes / 4;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcYLine += startLine * srcLumaPitchBytes;
+  srcULine += (startLine / 2) * srcChromaPitchBytes;
+  srcVLine += (startLine / 2) * srcChromaPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint8_t *srcYBytes = srcYLine;
     const uint8_t *srcUBytes = srcULine;
     const uint8_t *srcVBytes = srcVLine;
@@ -897,14 +969,17 @@ void Packers::convert420PtoV210 (const uint8_t *const srcBuf, uint8_t *const dst
   }  
 }
 
-void Packers::convertPGrouptoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertPGrouptoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = mSrcWidth * 5 / 2;
   uint32_t dstPitchBytes = ((mSrcWidth + 47) / 48) * 48 * 8 / 3;
 
   const uint8_t *srcLine = srcBuf;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint8_t *srcBytes = srcLine;
     uint32_t *dstInts = (uint32_t *)dstLine;
 
@@ -971,14 +1046,17 @@ void Packers::convertPGrouptoV210 (const uint8_t *const srcBuf, uint8_t *const d
   }
 }
 
-void Packers::convertV210toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertV210toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   uint32_t srcPitchBytes = ((mSrcWidth + 47) / 48) * 48 * 8 / 3;
   uint32_t dstPitchBytes = mSrcWidth * 5 / 2;
 
   const uint8_t *srcLine = srcBuf;
   uint8_t *dstLine = dstBuf;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcInts = (uint32_t *)srcLine;
     uint8_t *dstBytes = dstLine;
 
@@ -1037,7 +1115,7 @@ void Packers::convertV210toPGroup (const uint8_t *const srcBuf, uint8_t *const d
   }
 }
 
-void Packers::convertBGR10AtoGBRP16 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {
+void Packers::convertBGR10AtoGBRP16 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {
   bool doByteSwap = (mSrcFmtCode.find("BS") != std::string::npos);
   uint32_t srcPitchBytes = mSrcWidth * 4;
   uint32_t dstPitchBytes = mSrcWidth * 2;
@@ -1048,7 +1126,12 @@ void Packers::convertBGR10AtoGBRP16 (const uint8_t *const srcBuf, uint8_t *const
   uint8_t *dstBLine = dstBuf + dstPlaneBytes;
   uint8_t *dstRLine = dstBuf + dstPlaneBytes * 2;
 
-  for (uint32_t y=0; y<mSrcHeight; ++y) {
+  srcLine += startLine * srcPitchBytes;
+  dstGLine += startLine * dstPitchBytes;
+  dstBLine += startLine * dstPitchBytes;
+  dstRLine += startLine * dstPitchBytes;
+
+  for (uint32_t y=startLine; y<endLine; ++y) {
     const uint32_t *srcInts = (uint32_t *)srcLine;
     uint16_t *dstGShorts = (uint16_t *)dstGLine;
     uint16_t *dstBShorts = (uint16_t *)dstBLine;
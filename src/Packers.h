@@ -30,29 +30,29 @@ public:
   void convert(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf) const;
 
 private:
-  typedef std::function<void(const Packers&, const uint8_t *const, uint8_t *const)> tConvertFn;
-  void convertNotSupported (const uint8_t *const srcBuf, uint8_t *const dstBuf) const {}
-
-  void convertPGrouptoUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertYUV422P10toUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertPGrouptoYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertV210toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertPGroupto420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertV210to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-
-  void convertUYVY10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertUYVY10toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertUYVY10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertYUV422P10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertYUV422P10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convert420PtoPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertYUV422P10toV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convert420PtoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-
-  void convertPGrouptoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-  void convertV210toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
-
-  void convertBGR10AtoGBRP16 (const uint8_t *const srcBuf, uint8_t *const dstBuf) const;
+  typedef std::function<void(const Packers&, const uint8_t *const, uint8_t *const, uint32_t, uint32_t)> tConvertFn;
+  void convertNotSupported (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const {}
+
+  void convertPGrouptoUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertYUV422P10toUYVY10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertPGrouptoYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertV210toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertPGroupto420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertV210to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+
+  void convertUYVY10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertUYVY10toYUV422P10 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertUYVY10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertYUV422P10to420P (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertYUV422P10toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convert420PtoPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertYUV422P10toV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convert420PtoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+
+  void convertPGrouptoV210 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+  void convertV210toPGroup (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
+
+  void convertBGR10AtoGBRP16 (const uint8_t *const srcBuf, uint8_t *const dstBuf, uint32_t startLine, uint32_t endLine) const;
 
   const uint32_t mSrcWidth;
   const uint32_t mSrcHeight;
@@ -17,6 +17,8 @@
 #define PARAMS_H
 
 #include <nan.h>
+#include <string>
+#include <stdexcept>
 
 using namespace v8;
 
@@ -64,7 +66,11 @@ protected:
     if (Nan::Null() != val) {
       if (val->IsArray()) {
         std::string valStr = unpackValue(val);
-        result = valStr.empty()?dflt:std::stoi(valStr);
+        try {
+          result = valStr.empty()?dflt:std::stoi(valStr);
+        } catch (std::exception&) {
+          throw std::runtime_error(std::string("Parameter \'") + key + "\' must be a number - received \'" + valStr + "\'");
+        }
       } else
         result = Nan::To<uint32_t>(val).FromJust();
     }
@@ -0,0 +1,138 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef PCMCONVERT_H
+#define PCMCONVERT_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PCMCONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace streampunk {
+
+// Converts interleaved big-endian L16, L20 and L24 samples to planar floats in the range -1.0 to 1.0,
+// as the AAC encoder takes them. Samples are converted a block at a time into a buffer that stays in
+// cache, then split out to the channel planes.
+class PcmConvert {
+public:
+  // L20 samples are carried in three bytes, the same as L24, and scaled by their own range
+  PcmConvert(uint32_t bitsPerSample)
+    : mBytesPerSample((bitsPerSample + 7) / 8),
+      mScale(1.0f / (float)((1 << (bitsPerSample - 1)) - 1)) {}
+
+  // the planes of dst are planeSamples apart, which may be more than numSamples for a short frame
+  void toPlanarFloat(const uint8_t *src, float *dst, uint32_t numSamples, uint32_t numChannels, uint32_t planeSamples) {
+    uint32_t samplesPerBlock = kBlockValues / numChannels;
+    for (uint32_t s = 0; s < numSamples; s += samplesPerBlock) {
+      uint32_t blockSamples = (numSamples - s < samplesPerBlock) ? numSamples - s : samplesPerBlock;
+      uint32_t numValues = blockSamples * numChannels;
+      const uint8_t *blockSrc = src + s * numChannels * mBytesPerSample;
+      float *blockDst = (1 == numChannels) ? dst + s : mBlock;
+      if (2 == mBytesPerSample)
+        convertL16(blockSrc, blockDst, numValues, mScale);
+      else
+        convertL24(blockSrc, blockDst, numValues, mScale);
+      if (1 != numChannels)
+        deinterleave(mBlock, dst + s, blockSamples, numChannels, planeSamples);
+    }
+  }
+
+private:
+  // a multiple of the SSE2 width, and small enough to stay in L1 cache
+  static const uint32_t kBlockValues = 1024;
+
+  static void convertL16(const uint8_t *src, float *dst, uint32_t numValues, float scale) {
+    uint32_t i = 0;
+#ifdef PCMCONVERT_SSE2
+    const __m128 vScale = _mm_set1_ps(scale);
+    for (; i + 8 <= numValues; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+      // the shift right sign extends each sample from the top half of its 32 bits
+      __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vScale));
+      _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vScale));
+    }
+#endif
+    for (; i < numValues; ++i)
+      dst[i] = (float)(int16_t)((src[i * 2] << 8) | src[i * 2 + 1]) * scale;
+  }
+
+  static void convertL24(const uint8_t *src, float *dst, uint32_t numValues, float scale) {
+    uint32_t i = 0;
+#ifdef PCMCONVERT_SSE2
+    // the four byte loads read one byte beyond each group of four samples, so the last group is
+    // left to the scalar loop
+    const __m128 vScale = _mm_set1_ps(scale);
+    for (; i + 5 <= numValues; i += 4) {
+      const uint8_t *p = src + i * 3;
+      __m128i v = _mm_set_epi32((int32_t)load24(p + 9), (int32_t)load24(p + 6), (int32_t)load24(p + 3), (int32_t)load24(p));
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 8)), vScale));
+    }
+#endif
+    for (; i < numValues; ++i) {
+      const uint8_t *p = src + i * 3;
+      int32_t sample = (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8)) >> 8;
+      dst[i] = (float)sample * scale;
+    }
+  }
+
+#ifdef PCMCONVERT_SSE2
+  // the three sample bytes in the top of a 32 bit value, ready for an arithmetic shift right
+  static uint32_t load24(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if defined(_MSC_VER)
+    return _byteswap_ulong(v) & 0xFFFFFF00;
+#else
+    return __builtin_bswap32(v) & 0xFFFFFF00;
+#endif
+  }
+#endif
+
+  static void deinterleave(const float *src, float *dst, uint32_t numSamples, uint32_t numChannels, uint32_t planeSamples) {
+    uint32_t i = 0;
+#ifdef PCMCONVERT_SSE2
+    if (2 == numChannels) {
+      float *dstL = dst;
+      float *dstR = dst + planeSamples;
+      for (; i + 4 <= numSamples; i += 4) {
+        __m128 a = _mm_loadu_ps(src + i * 2);
+        __m128 b = _mm_loadu_ps(src + i * 2 + 4);
+        _mm_storeu_ps(dstL + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(dstR + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+      }
+    }
+#endif
+    for (uint32_t c = 0; c < numChannels; ++c) {
+      float *plane = dst + c * planeSamples;
+      for (uint32_t s = i; s < numSamples; ++s)
+        plane[s] = src[s * numChannels + c];
+    }
+  }
+
+  const uint32_t mBytesPerSample;
+  const float mScale;
+  float mBlock[kBlockValues];
+};
+
+} // namespace streampunk
+
+#endif
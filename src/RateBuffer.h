@@ -0,0 +1,50 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef RATEBUFFER_H
+#define RATEBUFFER_H
+
+#include <cstdint>
+#include <algorithm>
+
+namespace streampunk {
+
+// Models the output of an encoder as a leaky bucket, filled by each packet and drained at the
+// target bitrate over the packet's duration, so that rate adaptation can see how far the stream
+// runs ahead of the rate whatever the encoder itself reports. The buffer holds one second at
+// the bitrate.
+class RateBuffer {
+public:
+  RateBuffer(uint32_t bitrate) : mBitrate(std::max(1U, bitrate)), mBits(0.0) {}
+
+  void setBitrate(uint32_t bitrate) { mBitrate = std::max(1U, bitrate); }
+
+  // returns the fullness once the packet is added, as a fraction of the buffer size - above 1.0
+  // when the buffer has overflowed
+  float add(uint32_t numBytes, double seconds) {
+    mBits += numBytes * 8.0;
+    float fullness = (float)(mBits / mBitrate);
+    mBits = std::max(0.0, mBits - mBitrate * seconds);
+    return fullness;
+  }
+
+private:
+  uint32_t mBitrate;
+  double mBits;
+};
+
+} // namespace streampunk
+
+#endif
@@ -19,6 +19,7 @@
 #include "Timer.h"
 #include "Packers.h"
 #include "Memory.h"
+#include "FramePool.h"
 #include "Primitives.h"
 #include "ScaleConverterFF.h"
 #include "EssenceInfo.h"
@@ -32,28 +33,28 @@ namespace streampunk {
 
 class ScaleConvertProcessData : public iProcessData {
 public:
-  ScaleConvertProcessData (Local<Object> srcBufObj, Local<Object> dstBufObj, 
-                           std::shared_ptr<Memory> convertDstBuf, std::shared_ptr<Memory> scaleSrcBuf)
-    : mPersistentSrcBuf(new Persist(srcBufObj)),
-      mPersistentDstBuf(new Persist(dstBufObj)),
-      mSrcBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj))),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))),
-      mConvertDstBuf(convertDstBuf), mScaleSrcBuf(scaleSrcBuf)
+  // the intermediate buffer is only needed when both conversion and scaling are done
+  ScaleConvertProcessData (Local<Object> srcBufObj, Local<Object> dstBufObj, std::shared_ptr<Memory> intermediateBuf)
+    : mPersistentSrcBuf(srcBufObj),
+      mPersistentDstBuf(dstBufObj),
+      mSrcBuf((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)),
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)),
+      mIntermediateBuf(intermediateBuf)
   { }
   ~ScaleConvertProcessData() { }
   
-  std::shared_ptr<Memory> srcBuf() const { return mSrcBuf; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
-  std::shared_ptr<Memory> convertDstBuf() const { return mConvertDstBuf; }
-  std::shared_ptr<Memory> scaleSrcBuf() const { return mScaleSrcBuf; }
+  std::shared_ptr<Memory> srcBuf() { return share(mSrcBuf); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
+  std::shared_ptr<Memory> convertDstBuf() { return mIntermediateBuf ? mIntermediateBuf : dstBuf(); }
+  std::shared_ptr<Memory> scaleSrcBuf() { return mIntermediateBuf ? mIntermediateBuf : srcBuf(); }
+  uint64_t numBytes() const { return mSrcBuf.numBytes() + mDstBuf.numBytes() + memoryBytes(mIntermediateBuf); }
 
 private:
-  std::unique_ptr<Persist> mPersistentSrcBuf;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::shared_ptr<Memory> mSrcBuf;
-  std::shared_ptr<Memory> mDstBuf;
-  std::shared_ptr<Memory> mConvertDstBuf;
-  std::shared_ptr<Memory> mScaleSrcBuf;
+  Persist mPersistentSrcBuf;
+  Persist mPersistentDstBuf;
+  Memory mSrcBuf;
+  Memory mDstBuf;
+  std::shared_ptr<Memory> mIntermediateBuf;
 };
 
 ScaleConverter::ScaleConverter(Nan::Callback *callback) 
@@ -200,20 +201,18 @@ NAN_METHOD(ScaleConverter::ScaleConvert) {
   if (obj->mDstBytesReq > node::Buffer::Length(dstBufObj))
     return Nan::ThrowError("Insufficient destination buffer for specified format");
 
-  std::shared_ptr<Memory> srcBuf = Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj));
-  std::shared_ptr<Memory> dstBuf = Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj));
-  std::shared_ptr<Memory> convertDstBuf = dstBuf;
-  std::shared_ptr<Memory> scaleSrcBuf = srcBuf;
+  std::shared_ptr<Memory> intermediateBuf;
   if (!obj->mUnityPacking && !obj->mUnityScale) {
-    convertDstBuf = Memory::makeNew(getFormatBytes(obj->mScaleConverterFF->packingRequired(), obj->mSrcVidInfo->width(), obj->mSrcVidInfo->height()));
-    scaleSrcBuf = convertDstBuf;
-    if (!convertDstBuf->buf())
+    intermediateBuf = FramePool::instance().acquire(getFormatBytes(obj->mScaleConverterFF->packingRequired(), obj->mSrcVidInfo->width(), obj->mSrcVidInfo->height()));
+    if (!intermediateBuf)
       return Nan::ThrowError("Failed to allocate buffer for packer result");
+    numaBind(intermediateBuf->buf(), intermediateBuf->numBytes(), obj->mWorker->numaNode());
   }
 
   std::shared_ptr<iProcessData> scpd = 
-    std::make_shared<ScaleConvertProcessData>(srcBufObj, dstBufObj, convertDstBuf, scaleSrcBuf);
-  obj->mWorker->doFrame(scpd, obj, new Nan::Callback(callback));
+    obj->mWorker->makeProcessData<ScaleConvertProcessData>(srcBufObj, dstBufObj, intermediateBuf);
+  if (!obj->mWorker->doFrame(scpd, obj, callback))
+    return;
   
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -232,6 +231,14 @@ NAN_METHOD(ScaleConverter::Quit) {
   info.GetReturnValue().SetUndefined();
 }
 
+NAN_METHOD(ScaleConverter::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<ScaleConverter>(info.Holder())->mWorker->setOptions("ScaleConverter", info);
+}
+
+NAN_METHOD(ScaleConverter::Stats) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<ScaleConverter>(info.Holder())->mWorker->stats());
+}
+
 NAN_MODULE_INIT(ScaleConverter::Init) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("ScaleConverter").ToLocalChecked());
@@ -240,6 +247,8 @@ NAN_MODULE_INIT(ScaleConverter::Init) {
   SetPrototypeMethod(tpl, "setInfo", SetInfo);
   SetPrototypeMethod(tpl, "scaleConvert", ScaleConvert);
   SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("ScaleConverter").ToLocalChecked(),
@@ -17,6 +17,9 @@
 #include "ScaleConverterFF.h"
 #include "Memory.h"
 #include "EssenceInfo.h"
+#include "ContextPool.h"
+#include "TaskScheduler.h"
+#include <vector>
 
 extern "C" {
   #include <libavutil/imgutils.h>
@@ -27,7 +30,7 @@ namespace streampunk {
 
 ScaleConverterFF::ScaleConverterFF(std::shared_ptr<EssenceInfo> srcVidInfo, std::shared_ptr<EssenceInfo> dstVidInfo,
                                    const fXY &userScale, const fXY &userDstOffset, eDebugLevel debugLevel)
-  : iDebug(debugLevel), mSwsContext(NULL),
+  : iDebug(debugLevel),
     mSrcWidth(srcVidInfo->width()), mSrcHeight(srcVidInfo->height()), mSrcIlace(srcVidInfo->interlace()),
     mSrcPixFmt((0==srcVidInfo->packing().compare("RGBA8"))?AV_PIX_FMT_RGBA
                :(0==srcVidInfo->packing().compare("BGRA8"))?AV_PIX_FMT_BGRA
@@ -71,10 +74,24 @@ ScaleConverterFF::ScaleConverterFF(std::shared_ptr<EssenceInfo> srcVidInfo, std:
 
   uint32_t srcIshift = mSrcIlace.compare("prog")?1:0;
   uint32_t dstIshift = mDstIlace.compare("prog")?1:0;
-  mSwsContext = sws_getContext(mSrcWidth, mSrcHeight>>srcIshift, (AVPixelFormat)mSrcPixFmt,
-                               dstWidth, dstHeight>>dstIshift, (AVPixelFormat)mDstPixFmt,
-                               SWS_BILINEAR, NULL, NULL, NULL);
-  if (!mSwsContext) {
+  mSwsKey = std::to_string(mSrcWidth) + "x" + std::to_string(mSrcHeight>>srcIshift) + ":" + std::to_string(mSrcPixFmt) + "->" +
+            std::to_string(dstWidth) + "x" + std::to_string(dstHeight>>dstIshift) + ":" + std::to_string(mDstPixFmt);
+  auto takeContext = [&]() {
+    std::shared_ptr<SwsContext> context = ContextPool<SwsContext>::instance().take(mSwsKey);
+    if (!context) {
+      SwsContext *swsContext = sws_getContext(mSrcWidth, mSrcHeight>>srcIshift, (AVPixelFormat)mSrcPixFmt,
+                                              dstWidth, dstHeight>>dstIshift, (AVPixelFormat)mDstPixFmt,
+                                              SWS_BILINEAR, NULL, NULL, NULL);
+      if (swsContext)
+        context = std::shared_ptr<SwsContext>(swsContext, sws_freeContext);
+    }
+    return context;
+  };
+  mSwsContext = takeContext();
+  // the fields of an interlaced frame are scaled at the same time, each with its own context
+  if (mSwsContext && (srcIshift || dstIshift))
+    mFieldSwsContext = takeContext();
+  if (!mSwsContext || ((srcIshift || dstIshift) && !mFieldSwsContext)) {
     fprintf(stderr,
       "Impossible to create scale context for the conversion "
       "fmt:%s s:%dx%d -> fmt:%s s:%dx%d\n",
@@ -85,7 +102,10 @@ ScaleConverterFF::ScaleConverterFF(std::shared_ptr<EssenceInfo> srcVidInfo, std:
   }
 
   const int *hdTable = sws_getCoefficients((0==srcVidInfo->colorimetry().compare("BT709-2"))?SWS_CS_ITU709:SWS_CS_ITU601);
-  sws_setColorspaceDetails(mSwsContext, hdTable, 0, hdTable, 0, 0, 1 << 16, 1 << 16);
+  // set every time, as a context from the pool may have been used for other colorimetry
+  sws_setColorspaceDetails(mSwsContext.get(), hdTable, 0, hdTable, 0, 0, 1 << 16, 1 << 16);
+  if (mFieldSwsContext)
+    sws_setColorspaceDetails(mFieldSwsContext.get(), hdTable, 0, hdTable, 0, 0, 1 << 16, 1 << 16);
 
   if ((AV_PIX_FMT_RGBA==mSrcPixFmt) || (AV_PIX_FMT_BGRA==mSrcPixFmt)) {
     mSrcLinesize[0] = mSrcWidth * 4;
@@ -112,7 +132,29 @@ ScaleConverterFF::ScaleConverterFF(std::shared_ptr<EssenceInfo> srcVidInfo, std:
 }
 
 ScaleConverterFF::~ScaleConverterFF() {
-  sws_freeContext(mSwsContext);
+  if (mSwsContext)
+    ContextPool<SwsContext>::instance().give(mSwsKey, mSwsContext);
+  if (mFieldSwsContext)
+    ContextPool<SwsContext>::instance().give(mSwsKey, mFieldSwsContext);
+}
+
+uint32_t ScaleConverterFF::prewarm(std::shared_ptr<EssenceInfo> srcVidInfo, std::shared_ptr<EssenceInfo> dstVidInfo, uint32_t count) {
+  // the scalers are all set up before any is destroyed, so that each holds its own context
+  std::vector<std::shared_ptr<ScaleConverterFF> > scalers;
+  for (uint32_t i = 0; i < count; ++i) {
+    Nan::TryCatch try_catch;
+    std::shared_ptr<ScaleConverterFF> scaler = std::make_shared<ScaleConverterFF>(srcVidInfo, dstVidInfo, fXY(1.0f, 1.0f), fXY(0.0f, 0.0f), eWarn);
+    if (try_catch.HasCaught()) {
+      try_catch.ReThrow();
+      return 0;
+    }
+    scalers.push_back(scaler);
+  }
+  if (scalers.empty())
+    return 0;
+  std::string key = scalers[0]->mSwsKey;
+  scalers.clear();
+  return ContextPool<SwsContext>::instance().numIdle(key);
 }
 
 std::string ScaleConverterFF::packingRequired() const {
@@ -123,7 +165,7 @@ std::string ScaleConverterFF::packingRequired() const {
       : "YUV422P10";
 }
 
-void ScaleConverterFF::scaleConvertField (uint8_t **srcData, uint8_t **dstData, uint32_t srcField, uint32_t dstField) {
+void ScaleConverterFF::scaleConvertField (SwsContext *swsContext, uint8_t **srcData, uint8_t **dstData, uint32_t srcField, uint32_t dstField) {
   const uint8_t *srcBuf[4];
   uint8_t *dstBuf[4];
   uint32_t srcStride[4], dstStride[4];
@@ -135,7 +177,7 @@ void ScaleConverterFF::scaleConvertField (uint8_t **srcData, uint8_t **dstData,
     dstBuf[i] = dstData[i] + dstField * mDstLinesize[i];
   }
 
-  sws_scale(mSwsContext, srcBuf, (const int *)srcStride, 0, mSrcHeight/2, dstBuf, (const int *)dstStride);
+  sws_scale(swsContext, srcBuf, (const int *)srcStride, 0, mSrcHeight/2, dstBuf, (const int *)dstStride);
 }
 
 void ScaleConverterFF::scaleConvertFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf) {
@@ -201,15 +243,20 @@ void ScaleConverterFF::scaleConvertFrame (std::shared_ptr<Memory> srcBuf, std::s
   bool srcProgressive = (0 == mSrcIlace.compare("prog"));
   bool dstProgressive = (0 == mDstIlace.compare("prog"));
   if (srcProgressive && dstProgressive) {
-    sws_scale(mSwsContext, (const uint8_t * const*)srcData,
+    sws_scale(mSwsContext.get(), (const uint8_t * const*)srcData,
               (const int *)mSrcLinesize, 0, mSrcHeight, dstData, (const int *)mDstLinesize);
   } else {
     bool srcTff = (0 == mSrcIlace.compare("tff"));
     bool dstTff = (0 == mDstIlace.compare("tff"));
-    // first field
-    scaleConvertField (srcData, dstData, srcTff?0:1, dstTff?0:1);
-    // second field
-    scaleConvertField (srcData, dstData, srcTff?1:0, dstTff?1:0);
+    // the two fields write alternate lines of the frame, so are scaled in parallel
+    TaskScheduler::instance().parallelFor(0, 2, 1, [&](uint32_t begin, uint32_t end) {
+      for (uint32_t f = begin; f < end; ++f) {
+        if (0 == f) // first field
+          scaleConvertField (mSwsContext.get(), srcData, dstData, srcTff?0:1, dstTff?0:1);
+        else // second field
+          scaleConvertField (mFieldSwsContext.get(), srcData, dstData, srcTff?1:0, dstTff?1:0);
+      }
+    });
   }
 }
 
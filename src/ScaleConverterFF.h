@@ -17,6 +17,7 @@
 #define SCALECONVERTERFF_H
 
 #include <memory>
+#include <string>
 #include "iDebug.h"
 #include "iProcess.h"
 #include "Primitives.h"
@@ -35,8 +36,16 @@ public:
   std::string packingRequired() const;
   void scaleConvertFrame(std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf); 
 
+  // sets up count scalers at unity user scale and gives their contexts to the pool, returning the
+  // number then idle - a JS error is thrown if one cannot be set up
+  static uint32_t prewarm(std::shared_ptr<EssenceInfo> srcVidInfo, std::shared_ptr<EssenceInfo> dstVidInfo, uint32_t count);
+
 private:
-  SwsContext *mSwsContext;
+  // scale contexts are kept in a pool by their sizes and formats when the scaler is destroyed, as
+  // setting one up calculates its filters
+  std::shared_ptr<SwsContext> mSwsContext;
+  std::shared_ptr<SwsContext> mFieldSwsContext;
+  std::string mSwsKey;
   const uint32_t mSrcWidth;
   const uint32_t mSrcHeight;
   const std::string mSrcIlace;
@@ -52,7 +61,7 @@ private:
   bool mDoWipe;
   uint32_t mSrcLinesize[4], mDstLinesize[4];
 
-  void scaleConvertField (uint8_t **srcData, uint8_t **dstData, uint32_t srcField, uint32_t dstField);
+  void scaleConvertField (SwsContext *swsContext, uint8_t **srcData, uint8_t **dstData, uint32_t srcField, uint32_t dstField);
 };
 
 } // namespace streampunk
@@ -0,0 +1,127 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <new>
+
+namespace streampunk {
+
+// Recycles the small blocks allocated for every frame - process data, work params and shared
+// pointer control blocks - with a free list per block size. Blocks may be returned from any thread.
+class Slab {
+public:
+  Slab() : mAllocs(0), mReuses(0) {}
+  ~Slab() {
+    for (auto& f : mFree)
+      for (auto block : f.second)
+        ::operator delete(block);
+  }
+
+  void *allocate(size_t numBytes) {
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      std::vector<void *> &freeList = mFree[numBytes];
+      if (!freeList.empty()) {
+        void *block = freeList.back();
+        freeList.pop_back();
+        ++mReuses;
+        return block;
+      }
+      ++mAllocs;
+    }
+    return ::operator new(numBytes);
+  }
+
+  void deallocate(void *block, size_t numBytes) {
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      std::vector<void *> &freeList = mFree[numBytes];
+      if (freeList.size() < kMaxFreePerSize) {
+        freeList.push_back(block);
+        return;
+      }
+    }
+    ::operator delete(block);
+  }
+
+  // releases the free blocks, for example so that new ones are allocated on a new NUMA node
+  void clear() {
+    std::map<size_t, std::vector<void *> > freeBlocks;
+    {
+      std::lock_guard<std::mutex> lk(mMtx);
+      freeBlocks.swap(mFree);
+    }
+    for (auto& f : freeBlocks)
+      for (auto block : f.second)
+        ::operator delete(block);
+  }
+
+  // blocks taken from the heap and blocks reused from the free lists
+  uint64_t allocs() {
+    std::lock_guard<std::mutex> lk(mMtx);
+    return mAllocs;
+  }
+  uint64_t reuses() {
+    std::lock_guard<std::mutex> lk(mMtx);
+    return mReuses;
+  }
+
+private:
+  Slab(const Slab &);
+  Slab &operator=(const Slab &);
+
+  // more than enough for the frames a processor has in flight
+  static const size_t kMaxFreePerSize = 64;
+
+  std::mutex mMtx;
+  std::map<size_t, std::vector<void *> > mFree;
+  uint64_t mAllocs;
+  uint64_t mReuses;
+};
+
+// Standard allocator over a slab, for std::allocate_shared and containers. Each allocator holds
+// the slab so that it outlives the last block handed out.
+template <class T>
+class SlabAllocator {
+public:
+  typedef T value_type;
+
+  explicit SlabAllocator(std::shared_ptr<Slab> slab) : mSlab(slab) {}
+  template <class U>
+  SlabAllocator(const SlabAllocator<U> &other) : mSlab(other.slab()) {}
+
+  T *allocate(size_t n) { return (T *)mSlab->allocate(n * sizeof(T)); }
+  void deallocate(T *p, size_t n) { mSlab->deallocate(p, n * sizeof(T)); }
+
+  std::shared_ptr<Slab> slab() const { return mSlab; }
+
+private:
+  std::shared_ptr<Slab> mSlab;
+};
+
+template <class T, class U>
+bool operator==(const SlabAllocator<T> &a, const SlabAllocator<U> &b) { return a.slab() == b.slab(); }
+template <class T, class U>
+bool operator!=(const SlabAllocator<T> &a, const SlabAllocator<U> &b) { return a.slab() != b.slab(); }
+
+} // namespace streampunk
+
+#endif
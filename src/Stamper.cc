@@ -22,6 +22,7 @@
 #include "Packers.h"
 #include "Primitives.h"
 #include "Persist.h"
+#include "TaskScheduler.h"
 
 #include <memory>
 
@@ -29,22 +30,33 @@ using namespace v8;
 
 namespace streampunk {
 
+static const uint32_t kGrainLines = 16;
+
+// mix and stamp take two source buffers
+static const uint32_t kNumSrcBufs = 2;
+
+static Memory srcMemory(Local<Array> srcBufArray, uint32_t index) {
+  Local<Object> srcBufObj = Local<Object>::Cast(srcBufArray->Get(index));
+  return Memory((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj));
+}
+
 class WipeProcessData : public iProcessData {
 public:
   WipeProcessData (Local<Object> dstBufObj, const iRect &wipeRect, const fCol &wipeCol)
-    : mPersistentDstBuf(new Persist(dstBufObj)),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))),
+    : mPersistentDstBuf(dstBufObj),
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)),
       mWipeRect(wipeRect), mWipeCol(wipeCol)
   { }
   ~WipeProcessData() { }
   
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
   iRect wipeRect() const { return mWipeRect; }
   fCol wipeCol() const { return mWipeCol; }
+  uint64_t numBytes() const { return mDstBuf.numBytes(); }
 
 private:
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentDstBuf;
+  Memory mDstBuf;
   iRect mWipeRect;
   fCol mWipeCol;
 };
@@ -52,75 +64,71 @@ private:
 class CopyProcessData : public iProcessData {
 public:
   CopyProcessData (Local<Object> srcBufObj, Local<Object> dstBufObj, const iXY &dstOrg)
-    : mPersistentSrcBuf(new Persist(srcBufObj)),
-      mPersistentDstBuf(new Persist(dstBufObj)),
-      mSrcBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj))),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))),
+    : mPersistentSrcBuf(srcBufObj),
+      mPersistentDstBuf(dstBufObj),
+      mSrcBuf((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)),
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)),
       mDstOrg(dstOrg)
   { }
   ~CopyProcessData() { }
   
-  std::shared_ptr<Memory> srcBuf() const { return mSrcBuf; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> srcBuf() { return share(mSrcBuf); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
   iXY dstOrg() const { return mDstOrg; }
+  uint64_t numBytes() const { return mSrcBuf.numBytes() + mDstBuf.numBytes(); }
 
 private:
-  std::unique_ptr<Persist> mPersistentSrcBuf;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::shared_ptr<Memory> mSrcBuf;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentSrcBuf;
+  Persist mPersistentDstBuf;
+  Memory mSrcBuf;
+  Memory mDstBuf;
   iXY mDstOrg;
 };
 
 class MixProcessData : public iProcessData {
 public:
+  // persisting the source array keeps the source buffers it holds alive
   MixProcessData (Local<Array> srcBufArray, Local<Object> dstBufObj, float pressure)
-    : mPersistentDstBuf(new Persist(dstBufObj)),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))),
+    : mPersistentSrcBufs(srcBufArray),
+      mPersistentDstBuf(dstBufObj),
+      mSrcBufs{ srcMemory(srcBufArray, 0), srcMemory(srcBufArray, 1) },
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)),
       mPressure(pressure)
-  { 
-    for (uint32_t i=0; i<srcBufArray->Length(); ++i) {
-      Local<Object> srcBufObj = Local<Object>::Cast(srcBufArray->Get(i));
-      mPersistentSrcBufs.push_back(std::shared_ptr<Persist>(new Persist(srcBufObj)));
-      mSrcBufs.push_back(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)));
-    }
-  }
+  { }
   ~MixProcessData() { }
   
-  std::vector<std::shared_ptr<Memory> > srcBufs() const { return mSrcBufs; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> srcBuf(uint32_t index) { return share(mSrcBufs[index]); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
   float pressure() const { return mPressure; }
+  uint64_t numBytes() const { return mSrcBufs[0].numBytes() + mSrcBufs[1].numBytes() + mDstBuf.numBytes(); }
 
 private:
-  std::vector<std::shared_ptr<Persist> > mPersistentSrcBufs;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::vector<std::shared_ptr<Memory> > mSrcBufs;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentSrcBufs;
+  Persist mPersistentDstBuf;
+  Memory mSrcBufs[kNumSrcBufs];
+  Memory mDstBuf;
   float mPressure;
 };
 
 class StampProcessData : public iProcessData {
 public:
   StampProcessData (Local<Array> srcBufArray, Local<Object> dstBufObj)
-    : mPersistentDstBuf(new Persist(dstBufObj)),
-      mDstBuf(Memory::makeNew((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj)))
-  { 
-    for (uint32_t i=0; i<srcBufArray->Length(); ++i) {
-      Local<Object> srcBufObj = Local<Object>::Cast(srcBufArray->Get(i));
-      mPersistentSrcBufs.push_back(std::shared_ptr<Persist>(new Persist(srcBufObj)));
-      mSrcBufs.push_back(Memory::makeNew((uint8_t *)node::Buffer::Data(srcBufObj), (uint32_t)node::Buffer::Length(srcBufObj)));
-    }
-  }
+    : mPersistentSrcBufs(srcBufArray),
+      mPersistentDstBuf(dstBufObj),
+      mSrcBufs{ srcMemory(srcBufArray, 0), srcMemory(srcBufArray, 1) },
+      mDstBuf((uint8_t *)node::Buffer::Data(dstBufObj), (uint32_t)node::Buffer::Length(dstBufObj))
+  { }
   ~StampProcessData() { }
   
-  std::vector<std::shared_ptr<Memory> > srcBufs() const { return mSrcBufs; }
-  std::shared_ptr<Memory> dstBuf() const { return mDstBuf; }
+  std::shared_ptr<Memory> srcBuf(uint32_t index) { return share(mSrcBufs[index]); }
+  std::shared_ptr<Memory> dstBuf() { return share(mDstBuf); }
+  uint64_t numBytes() const { return mSrcBufs[0].numBytes() + mSrcBufs[1].numBytes() + mDstBuf.numBytes(); }
 
 private:
-  std::vector<std::shared_ptr<Persist> > mPersistentSrcBufs;
-  std::unique_ptr<Persist> mPersistentDstBuf;
-  std::vector<std::shared_ptr<Memory> > mSrcBufs;
-  std::shared_ptr<Memory> mDstBuf;
+  Persist mPersistentSrcBufs;
+  Persist mPersistentDstBuf;
+  Memory mSrcBufs[kNumSrcBufs];
+  Memory mDstBuf;
 };
 
 Stamper::Stamper(Nan::Callback *callback) 
@@ -317,49 +325,47 @@ void Stamper::doMix(std::shared_ptr<MixProcessData> mpd) {
   uint32_t dstLumaPlaneBytes = dstLumaPitchBytes * mDstVidInfo->height();
   uint32_t dstChromaPlaneBytes = dstChromaPitchBytes * mDstVidInfo->height() / lumaLinesPerChromaLine;
 
-  const uint8_t *srcLine[2][3];
+  const uint8_t *srcPlane[2][3];
   for (uint32_t s=0; s<2; ++s) { 
-    srcLine[s][0] = mpd->srcBufs()[s]->buf();
-    srcLine[s][1] = srcLine[s][0] + srcLumaPlaneBytes;
-    srcLine[s][2] = srcLine[s][1] + srcChromaPlaneBytes;
+    srcPlane[s][0] = mpd->srcBuf(s)->buf();
+    srcPlane[s][1] = srcPlane[s][0] + srcLumaPlaneBytes;
+    srcPlane[s][2] = srcPlane[s][1] + srcChromaPlaneBytes;
   }
 
-  uint8_t *dstLine[3];
-  dstLine[0] = mpd->dstBuf()->buf();
-  dstLine[1] = dstLine[0] + dstLumaPlaneBytes;
-  dstLine[2] = dstLine[1] + dstChromaPlaneBytes;
+  uint8_t *dstPlane[3];
+  dstPlane[0] = mpd->dstBuf()->buf();
+  dstPlane[1] = dstPlane[0] + dstLumaPlaneBytes;
+  dstPlane[2] = dstPlane[1] + dstChromaPlaneBytes;
   
   float pressure = mpd->pressure();
-        
-  for (uint32_t p=0; p<3; ++p) {
-    uint32_t numPixels = (0==p) ? mSrcVidInfo->width() : mSrcVidInfo->width() / 2;
-    for (uint32_t y=0; y<mSrcVidInfo->height(); ++y) {
-      bool evenLine = (y & 1) == 0;
-      if (1==bytesPerPixel) {
-        const uint8_t *srcA = srcLine[0][p];
-        const uint8_t *srcB = srcLine[1][p];
-        uint8_t *dst = dstLine[p];
-
-        if ((0==p) || evenLine) {
+
+  // slices start on an even line so 420P chroma lines are only written by one slice
+  TaskScheduler::instance().parallelFor(0, mSrcVidInfo->height(), kGrainLines, [&](uint32_t startLine, uint32_t endLine) {
+    for (uint32_t p=0; p<3; ++p) {
+      uint32_t numPixels = (0==p) ? mSrcVidInfo->width() : mSrcVidInfo->width() / 2;
+      uint32_t linesPerPlaneLine = (0==p) ? 1 : lumaLinesPerChromaLine;
+      uint32_t srcPitchBytes = (0==p) ? srcLumaPitchBytes : srcChromaPitchBytes;
+      uint32_t dstPitchBytes = (0==p) ? dstLumaPitchBytes : dstChromaPitchBytes;
+      for (uint32_t y=startLine; y<endLine; y+=linesPerPlaneLine) {
+        uint32_t planeLine = y / linesPerPlaneLine;
+        if (1==bytesPerPixel) {
+          const uint8_t *srcA = srcPlane[0][p] + planeLine * srcPitchBytes;
+          const uint8_t *srcB = srcPlane[1][p] + planeLine * srcPitchBytes;
+          uint8_t *dst = dstPlane[p] + planeLine * dstPitchBytes;
+
           for (uint32_t x=0; x < numPixels; ++x)
             *dst++ = uint8_t((float)*srcA++ * pressure + (float)*srcB++ * (1.0f - pressure));
-        }
-      } else {
-        const uint16_t *srcA = (const uint16_t *)srcLine[0][p];
-        const uint16_t *srcB = (const uint16_t *)srcLine[1][p];
-        uint16_t *dst = (uint16_t *)dstLine[p];
-
-        for (uint32_t x=0; x < numPixels; ++x)
-          *dst++ = uint16_t((float)*srcA++ * pressure + (float)*srcB++ * (1.0f - pressure));
-      }
+        } else {
+          const uint16_t *srcA = (const uint16_t *)(srcPlane[0][p] + planeLine * srcPitchBytes);
+          const uint16_t *srcB = (const uint16_t *)(srcPlane[1][p] + planeLine * srcPitchBytes);
+          uint16_t *dst = (uint16_t *)(dstPlane[p] + planeLine * dstPitchBytes);
 
-      if ((0==p) || (1 == lumaLinesPerChromaLine) || !evenLine) {
-        for (uint32_t s=0; s<2; ++s)
-          srcLine[s][p] += (0==p) ? srcLumaPitchBytes : srcChromaPitchBytes;
-        dstLine[p] += (0==p) ? dstLumaPitchBytes : dstChromaPitchBytes;
+          for (uint32_t x=0; x < numPixels; ++x)
+            *dst++ = uint16_t((float)*srcA++ * pressure + (float)*srcB++ * (1.0f - pressure));
+        }
       }
     }
-  }
+  });
 }
 
 void Stamper::doStamp(std::shared_ptr<StampProcessData> spd) {
@@ -382,7 +388,7 @@ void Stamper::doStamp(std::shared_ptr<StampProcessData> spd) {
 
   const uint8_t *srcLine[2][4];
   for (uint32_t s=0; s<2; ++s) { 
-    srcLine[s][0] = spd->srcBufs()[s]->buf();
+    srcLine[s][0] = spd->srcBuf(s)->buf();
     srcLine[s][1] = srcLine[s][0] + srcLumaPlaneBytes;
     srcLine[s][2] = srcLine[s][1] + srcChromaPlaneBytes;
     srcLine[s][3] = srcLine[s][2] + srcChromaPlaneBytes;
@@ -532,8 +538,9 @@ NAN_METHOD(Stamper::Wipe) {
                Nan::To<double>(wipeColArr->Get(2)).FromJust());
 
   std::shared_ptr<iProcessData> wpd = 
-    std::make_shared<WipeProcessData>(dstBufObj, wipeRect, wipeCol);
-  obj->mWorker->doFrame(wpd, obj, new Nan::Callback(callback));
+    obj->mWorker->makeProcessData<WipeProcessData>(dstBufObj, wipeRect, wipeCol);
+  if (!obj->mWorker->doFrame(wpd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -576,8 +583,9 @@ NAN_METHOD(Stamper::Copy) {
   iXY dstOrg(Nan::To<uint32_t>(dstOrgXY->Get(0)).FromJust(), Nan::To<uint32_t>(dstOrgXY->Get(1)).FromJust());
 
   std::shared_ptr<iProcessData> cpd = 
-    std::make_shared<CopyProcessData>(srcBufObj, dstBufObj, dstOrg);
-  obj->mWorker->doFrame(cpd, obj, new Nan::Callback(callback));
+    obj->mWorker->makeProcessData<CopyProcessData>(srcBufObj, dstBufObj, dstOrg);
+  if (!obj->mWorker->doFrame(cpd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -604,6 +612,8 @@ NAN_METHOD(Stamper::Mix) {
   if (!obj->mSetInfoOK)
     return Nan::ThrowError("Mix called with incorrect setup parameters");
 
+  if (srcBufArray->Length() < kNumSrcBufs)
+    return Nan::ThrowError("Mix requires two source buffers");
   uint32_t srcFormatBytes = getFormatBytes(obj->mSrcVidInfo->packing(), obj->mSrcVidInfo->width(), obj->mSrcVidInfo->height());
   for (uint32_t i=0; i<srcBufArray->Length(); ++i) {
     Local<Object> srcBufObj = Local<Object>::Cast(srcBufArray->Get(i));
@@ -621,8 +631,9 @@ NAN_METHOD(Stamper::Mix) {
   float pressure = (float)Nan::To<double>(pressureObj).FromJust();
 
   std::shared_ptr<iProcessData> mpd = 
-    std::make_shared<MixProcessData>(srcBufArray, dstBufObj, pressure);
-  obj->mWorker->doFrame(mpd, obj, new Nan::Callback(callback));
+    obj->mWorker->makeProcessData<MixProcessData>(srcBufArray, dstBufObj, pressure);
+  if (!obj->mWorker->doFrame(mpd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -652,6 +663,8 @@ NAN_METHOD(Stamper::Stamp) {
   if (!obj->mSrcVidInfo->hasAlpha())
     return Nan::ThrowError("Stamp called with source buffer having no alpha channel");
 
+  if (srcBufArray->Length() < kNumSrcBufs)
+    return Nan::ThrowError("Stamp requires two source buffers");
   for (uint32_t i=0; i<srcBufArray->Length(); ++i) {
     uint32_t srcFormatBytes = getFormatBytes(obj->mSrcVidInfo->packing(), obj->mSrcVidInfo->width(), obj->mSrcVidInfo->height(), 0==i);
     Local<Object> srcBufObj = Local<Object>::Cast(srcBufArray->Get(i));
@@ -663,8 +676,9 @@ NAN_METHOD(Stamper::Stamp) {
     return Nan::ThrowError("Insufficient destination buffer for specified format");
 
   std::shared_ptr<iProcessData> spd = 
-    std::make_shared<StampProcessData>(srcBufArray, dstBufObj);
-  obj->mWorker->doFrame(spd, obj, new Nan::Callback(callback));
+    obj->mWorker->makeProcessData<StampProcessData>(srcBufArray, dstBufObj);
+  if (!obj->mWorker->doFrame(spd, obj, callback))
+    return;
 
   info.GetReturnValue().Set(Nan::New(obj->mWorker->numQueued()));
 }
@@ -683,6 +697,14 @@ NAN_METHOD(Stamper::Quit) {
   info.GetReturnValue().SetUndefined();
 }
 
+NAN_METHOD(Stamper::SetWorkerOptions) {
+  Nan::ObjectWrap::Unwrap<Stamper>(info.Holder())->mWorker->setOptions("Stamper", info);
+}
+
+NAN_METHOD(Stamper::Stats) {
+  info.GetReturnValue().Set(Nan::ObjectWrap::Unwrap<Stamper>(info.Holder())->mWorker->stats());
+}
+
 NAN_MODULE_INIT(Stamper::Init) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->SetClassName(Nan::New("Copy").ToLocalChecked());
@@ -694,6 +716,8 @@ NAN_MODULE_INIT(Stamper::Init) {
   SetPrototypeMethod(tpl, "mix", Mix);
   SetPrototypeMethod(tpl, "stamp", Stamp);
   SetPrototypeMethod(tpl, "quit", Quit);
+  SetPrototypeMethod(tpl, "setWorkerOptions", SetWorkerOptions);
+  SetPrototypeMethod(tpl, "stats", Stats);
 
   constructor().Reset(Nan::GetFunction(tpl).ToLocalChecked());
   Nan::Set(target, Nan::New("Stamper").ToLocalChecked(),
@@ -73,6 +73,8 @@ private:
   static NAN_METHOD(Mix);
   static NAN_METHOD(Stamp);
   static NAN_METHOD(Quit);
+  static NAN_METHOD(SetWorkerOptions);
+  static NAN_METHOD(Stats);
 
   MyWorker *mWorker;
   bool mSetInfoOK;
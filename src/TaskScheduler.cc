@@ -0,0 +1,165 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <exception>
+
+namespace streampunk {
+
+// aim for a few tasks per thread so that uneven progress can be balanced by stealing
+static const uint32_t kTasksPerThread = 4;
+
+// index of the pool thread's own deque, or -1 for threads from outside the pool
+static thread_local int32_t tThreadIndex = -1;
+
+struct TaskScheduler::Job {
+  Job(const tRangeFn &fn, uint32_t numTasks) : fn(fn), remaining(numTasks) {}
+  const tRangeFn &fn;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::atomic<uint32_t> remaining;
+  std::exception_ptr error;
+};
+
+TaskScheduler &TaskScheduler::instance() {
+  // deliberately never destroyed - libuv threads may still be running kernels during process exit
+  static TaskScheduler *scheduler = new TaskScheduler(std::max(1U, std::thread::hardware_concurrency()) - 1);
+  return *scheduler;
+}
+
+TaskScheduler::TaskScheduler(uint32_t numThreads)
+  : mPending(0), mActiveThreads(numThreads), mTasksRun(0), mTasksStolen(0) {
+  // one deque per pool thread plus one shared by callers from outside the pool
+  for (uint32_t i = 0; i <= numThreads; ++i)
+    mQueues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue));
+  for (uint32_t i = 0; i < numThreads; ++i)
+    mThreads.push_back(std::thread(&TaskScheduler::threadLoop, this, i));
+  for (auto& t : mThreads)
+    t.detach();
+}
+
+void TaskScheduler::parallelFor(uint32_t begin, uint32_t end, uint32_t grain, const tRangeFn &fn) {
+  if (end <= begin)
+    return;
+  if (0 == grain)
+    grain = 1;
+
+  uint32_t numLines = end - begin;
+  uint32_t targetTasks = (numThreads() + 1) * kTasksPerThread;
+  uint32_t taskLines = (numLines + targetTasks - 1) / targetTasks;
+  taskLines = ((taskLines + grain - 1) / grain) * grain;
+  uint32_t numTasks = (numLines + taskLines - 1) / taskLines;
+  if ((numTasks < 2) || (0 == numThreads())) {
+    fn(begin, end);
+    return;
+  }
+
+  Job job(fn, numTasks);
+  uint32_t home = (tThreadIndex < 0) ? numThreads() : (uint32_t)tThreadIndex;
+  {
+    // count before queueing so that a thief can never take the count below zero
+    std::lock_guard<std::mutex> lk(mSleepMtx);
+    mPending += numTasks - 1;
+  }
+  {
+    // the first range is run directly by this thread
+    std::lock_guard<std::mutex> lk(mQueues[home]->mtx);
+    for (uint32_t b = begin + taskLines; b < end; b += taskLines)
+      mQueues[home]->tasks.push_back(Task{&job, b, std::min(b + taskLines, end)});
+  }
+  mSleepCv.notify_all();
+
+  runTask(Task{&job, begin, begin + taskLines});
+
+  // help with outstanding work until this job's tasks have all been taken
+  Task task;
+  while ((job.remaining > 0) && takeTask(home, task))
+    runTask(task);
+
+  // wait for tasks still running on other threads - the job must not be released until the
+  // last of them has finished signalling it
+  std::unique_lock<std::mutex> lk(job.mtx);
+  job.cv.wait(lk, [&job]{ return 0 == job.remaining; });
+  if (job.error)
+    std::rethrow_exception(job.error);
+}
+
+void TaskScheduler::setActiveThreads(uint32_t activeThreads) {
+  {
+    std::lock_guard<std::mutex> lk(mSleepMtx);
+    mActiveThreads = std::min(activeThreads, numThreads());
+  }
+  mSleepCv.notify_all();
+}
+
+// private
+void TaskScheduler::threadLoop(uint32_t index) {
+  tThreadIndex = (int32_t)index;
+  Task task;
+  while (true) {
+    if ((index < mActiveThreads) && takeTask(index, task)) {
+      runTask(task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(mSleepMtx);
+    mSleepCv.wait(lk, [this, index]{ return (index < mActiveThreads) && (mPending > 0); });
+  }
+}
+
+bool TaskScheduler::takeTask(uint32_t home, Task &task) {
+  {
+    std::lock_guard<std::mutex> lk(mQueues[home]->mtx);
+    std::deque<Task> &tasks = mQueues[home]->tasks;
+    if (!tasks.empty()) {
+      task = tasks.back();
+      tasks.pop_back();
+      --mPending;
+      return true;
+    }
+  }
+
+  uint32_t numQueues = (uint32_t)mQueues.size();
+  for (uint32_t i = 1; i < numQueues; ++i) {
+    TaskQueue &victim = *mQueues[(home + i) % numQueues];
+    std::lock_guard<std::mutex> lk(victim.mtx);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+      --mPending;
+      ++mTasksStolen;
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskScheduler::runTask(const Task &task) {
+  Job &job = *task.job;
+  try {
+    job.fn(task.begin, task.end);
+  } catch (...) {
+    std::lock_guard<std::mutex> lk(job.mtx);
+    if (!job.error)
+      job.error = std::current_exception();
+  }
+  ++mTasksRun;
+
+  std::lock_guard<std::mutex> lk(job.mtx);
+  if (0 == --job.remaining)
+    job.cv.notify_all();
+}
+
+} // namespace streampunk
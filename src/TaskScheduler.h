@@ -0,0 +1,88 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace streampunk {
+
+// Pool of threads shared by all kernels for splitting a frame into tasks over ranges of lines.
+// Each pool thread owns a deque - it takes its own tasks from the back and steals from the
+// front of the others. Threads calling parallelFor from outside the pool share one extra deque
+// and help run tasks until their own have completed, so calls from several processors at once
+// (or nested calls from inside a task) cannot deadlock.
+class TaskScheduler {
+public:
+  typedef std::function<void(uint32_t, uint32_t)> tRangeFn;
+
+  static TaskScheduler &instance();
+
+  // Runs fn over the line range [begin, end), split into ranges that start on a multiple of
+  // grain lines from begin. Returns when all ranges are complete, rethrowing the first
+  // exception thrown by fn.
+  void parallelFor(uint32_t begin, uint32_t end, uint32_t grain, const tRangeFn &fn);
+
+  uint32_t numThreads() const  { return (uint32_t)mThreads.size(); }
+
+  // Threads beyond the active count sleep rather than take tasks. Callers of parallelFor always
+  // run their own tasks so work completes even with no active threads.
+  uint32_t activeThreads() const  { return mActiveThreads; }
+  void setActiveThreads(uint32_t activeThreads);
+
+  uint64_t tasksRun() const  { return mTasksRun; }
+  uint64_t tasksStolen() const  { return mTasksStolen; }
+
+private:
+  struct Job;
+  struct Task {
+    Job *job;
+    uint32_t begin;
+    uint32_t end;
+  };
+  struct TaskQueue {
+    std::mutex mtx;
+    std::deque<Task> tasks;
+  };
+
+  TaskScheduler(uint32_t numThreads);
+  TaskScheduler(const TaskScheduler &);
+  TaskScheduler &operator=(const TaskScheduler &);
+
+  void threadLoop(uint32_t index);
+  bool takeTask(uint32_t home, Task &task);
+  void runTask(const Task &task);
+
+  std::vector<std::thread> mThreads;
+  std::vector<std::unique_ptr<TaskQueue> > mQueues;
+  std::mutex mSleepMtx;
+  std::condition_variable mSleepCv;
+  std::atomic<uint32_t> mPending;
+  std::atomic<uint32_t> mActiveThreads;
+  std::atomic<uint64_t> mTasksRun;
+  std::atomic<uint64_t> mTasksStolen;
+};
+
+} // namespace streampunk
+
+#endif
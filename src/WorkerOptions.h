@@ -0,0 +1,238 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef WORKEROPTIONS_H
+#define WORKEROPTIONS_H
+
+#include <nan.h>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include "Params.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace v8;
+
+namespace streampunk {
+
+// values from linux/mempolicy.h - libnuma is not a dependency
+enum eMemPolicy { eMPolDefault = 0, eMPolPreferred = 1, eMPolBind = 2 };
+
+const int32_t kNoNumaNode = -1;
+const int32_t kNoNice = 0x7fffffff;
+
+// parse a cpu list of the form "0-3,8,10-11" as used by taskset and sysfs
+inline std::vector<uint32_t> parseCpuList(const std::string& cpuList) {
+  std::vector<uint32_t> cpus;
+  std::stringstream ss(cpuList);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty())
+      continue;
+    size_t dash = range.find('-');
+    try {
+      uint32_t first = std::stoi(range.substr(0, dash));
+      uint32_t last = (std::string::npos == dash) ? first : std::stoi(range.substr(dash + 1));
+      if (last < first)
+        throw std::runtime_error("");
+      for (uint32_t c = first; c <= last; ++c)
+        cpus.push_back(c);
+    } catch (std::exception&) {
+      throw std::runtime_error(std::string("Invalid cpu list \'") + cpuList + "\'");
+    }
+  }
+  return cpus;
+}
+
+inline std::vector<uint32_t> numaNodeCpus(int32_t numaNode) {
+  std::string cpuList;
+  std::ifstream f(std::string("/sys/devices/system/node/node") + std::to_string(numaNode) + "/cpulist");
+  if (f.is_open())
+    std::getline(f, cpuList);
+  return parseCpuList(cpuList);
+}
+
+// Request that pages of the given buffer are allocated on the given node.
+// Must be called before the pages are first touched to have any effect.
+inline void numaBind(uint8_t *buf, size_t numBytes, int32_t numaNode) {
+#ifdef __linux__
+  if ((kNoNumaNode == numaNode) || (numaNode >= 64) || !buf || !numBytes)
+    return;
+  uintptr_t pageBytes = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)buf & ~(pageBytes - 1);
+  uintptr_t end = (uintptr_t)buf + numBytes;
+  unsigned long nodeMask = 1UL << numaNode;
+  syscall(SYS_mbind, start, end - start, eMPolPreferred, &nodeMask, sizeof(nodeMask) * 8, 0);
+#endif
+}
+
+class WorkerOptions : public Params {
+public:
+  WorkerOptions()
+    : mNumaNode(kNoNumaNode), mSchedPolicy("other"), mPriority(0), mNice(kNoNice) {}
+  WorkerOptions(Local<Object> tags)
+    : mCpuList(unpackStr(tags, "cpus", "")),
+      mCpus(parseCpuList(mCpuList)),
+      mNumaNode((int32_t)unpackNum(tags, "numaNode", (uint32_t)kNoNumaNode)),
+      mSchedPolicy(unpackStr(tags, "schedPolicy", "other")),
+      mPriority(unpackNum(tags, "priority", 0)),
+      mNice((int32_t)unpackNum(tags, "nice", (uint32_t)kNoNice)) {
+    if (mSchedPolicy.compare("other") && mSchedPolicy.compare("fifo") && mSchedPolicy.compare("rr"))
+      throw std::runtime_error(std::string("Unsupported scheduling policy \'") + mSchedPolicy + "\'");
+    if (mSchedPolicy.compare("other") && ((mPriority < 1) || (mPriority > 99)))
+      throw std::runtime_error(std::string("Real-time priority must be in the range 1-99 - received ") + std::to_string(mPriority));
+    if ((kNoNice != mNice) && ((mNice < -20) || (mNice > 19)))
+      throw std::runtime_error(std::string("Nice level must be in the range -20 to 19 - received ") + std::to_string(mNice));
+    if ((kNoNumaNode != mNumaNode) && ((mNumaNode < 0) || (mNumaNode >= 64)))
+      throw std::runtime_error(std::string("Unsupported NUMA node ") + std::to_string(mNumaNode));
+  }
+  ~WorkerOptions() {}
+
+  std::string cpuList() const  { return mCpuList; }
+  int32_t numaNode() const  { return mNumaNode; }
+  std::string schedPolicy() const  { return mSchedPolicy; }
+  int32_t priority() const  { return mPriority; }
+  int32_t nice() const  { return mNice; }
+
+  bool isDefault() const  {
+    return mCpus.empty() && (kNoNumaNode == mNumaNode) && (0 == mSchedPolicy.compare("other")) && (kNoNice == mNice);
+  }
+
+  std::string toString() const  {
+    std::stringstream ss;
+    ss << "cpus " << (mCpuList.empty()?"any":mCpuList) << ", NUMA node ";
+    if (kNoNumaNode == mNumaNode) ss << "any"; else ss << mNumaNode;
+    ss << ", policy " << mSchedPolicy;
+    if (mSchedPolicy.compare("other")) ss << " priority " << mPriority;
+    if (kNoNice != mNice) ss << ", nice " << mNice;
+    return ss.str();
+  }
+
+  void addStats(Local<Object> stats) const {
+    Nan::Set(stats, Nan::New("cpus").ToLocalChecked(), Nan::New(mCpuList).ToLocalChecked());
+    Nan::Set(stats, Nan::New("numaNode").ToLocalChecked(), Nan::New(mNumaNode));
+    Nan::Set(stats, Nan::New("schedPolicy").ToLocalChecked(), Nan::New(mSchedPolicy).ToLocalChecked());
+    Nan::Set(stats, Nan::New("priority").ToLocalChecked(), Nan::New(mPriority));
+    if (kNoNice != mNice)
+      Nan::Set(stats, Nan::New("nice").ToLocalChecked(), Nan::New(mNice));
+  }
+
+  // Applies the options to the calling thread - returns an empty string on success
+  std::string apply() const {
+    std::string err;
+#ifdef __linux__
+    std::vector<uint32_t> cpus = mCpus;
+    if (cpus.empty() && (kNoNumaNode != mNumaNode))
+      cpus = numaNodeCpus(mNumaNode);
+    if (!cpus.empty()) {
+      cpu_set_t cpuSet;
+      CPU_ZERO(&cpuSet);
+      for (uint32_t c : cpus)
+        if (c < CPU_SETSIZE)
+          CPU_SET(c, &cpuSet);
+      if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet))
+        err += "failed to set cpu affinity; ";
+    }
+
+    if (kNoNumaNode != mNumaNode) {
+      unsigned long nodeMask = 1UL << mNumaNode;
+      if (syscall(SYS_set_mempolicy, eMPolPreferred, &nodeMask, sizeof(nodeMask) * 8))
+        err += "failed to set NUMA memory policy; ";
+    }
+
+    if (mSchedPolicy.compare("other")) {
+      sched_param sp;
+      sp.sched_priority = mPriority;
+      if (pthread_setschedparam(pthread_self(), mSchedPolicy.compare("fifo")?SCHED_RR:SCHED_FIFO, &sp))
+        err += "failed to set real-time scheduling policy (requires CAP_SYS_NICE); ";
+    }
+
+    if (kNoNice != mNice) {
+      if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), mNice))
+        err += "failed to set nice level; ";
+    }
+#else
+    if (!isDefault())
+      err = "worker thread options are not supported on this platform";
+#endif
+    return err;
+  }
+
+private:
+  std::string mCpuList;
+  std::vector<uint32_t> mCpus;
+  int32_t mNumaNode;
+  std::string mSchedPolicy;
+  int32_t mPriority;
+  int32_t mNice;
+};
+
+// Worker threads are borrowed from the libuv threadpool so the original settings
+// must be restored before the thread is handed back
+class ThreadSettings {
+public:
+  ThreadSettings() : mSaved(false) {}
+
+  void save() {
+#ifdef __linux__
+    if (mSaved)
+      return;
+    pthread_getaffinity_np(pthread_self(), sizeof(mCpuSet), &mCpuSet);
+    pthread_getschedparam(pthread_self(), &mPolicy, &mSchedParam);
+    mNice = getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+#endif
+    mSaved = true;
+  }
+
+  // returns an empty string on success - lowering the nice level back to its saved value, or
+  // leaving a real-time policy, fails without CAP_SYS_NICE
+  std::string restore() {
+    std::string err;
+#ifdef __linux__
+    if (!mSaved)
+      return err;
+    if (pthread_setaffinity_np(pthread_self(), sizeof(mCpuSet), &mCpuSet))
+      err += "failed to restore cpu affinity; ";
+    if (pthread_setschedparam(pthread_self(), mPolicy, &mSchedParam))
+      err += "failed to restore scheduling policy; ";
+    if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), mNice))
+      err += "failed to restore nice level (requires CAP_SYS_NICE); ";
+    if (syscall(SYS_set_mempolicy, eMPolDefault, NULL, 0))
+      err += "failed to restore NUMA memory policy; ";
+#endif
+    mSaved = false;
+    return err;
+  }
+
+private:
+  bool mSaved;
+#ifdef __linux__
+  cpu_set_t mCpuSet;
+  int mPolicy;
+  sched_param mSchedParam;
+  int mNice;
+#endif
+};
+
+} // namespace streampunk
+
+#endif
@@ -20,10 +20,189 @@
 #include "ScaleConverter.h"
 #include "Decoder.h"
 #include "Encoder.h"
+#include "AbrEncoder.h"
 #include "Stamper.h"
+#include "BufferPool.h"
+#include "TaskScheduler.h"
+#include "Autoscaler.h"
+#include "FramePool.h"
+#include "MemoryGovernor.h"
+#include "Memory.h"
+#include "Packers.h"
+#include "DriverRegistry.h"
+#include "ContextPool.h"
+#include "ScaleConverterFF.h"
+#include <cstring>
 
 using namespace v8;
 
+namespace streampunk {
+
+NAN_METHOD(SetAutoscale) {
+  if ((info.Length() < 1) || !info[0]->IsObject())
+    return Nan::ThrowError("setAutoscale expects an options object");
+  if ((info.Length() > 1) && !info[1]->IsFunction())
+    return Nan::ThrowError("setAutoscale expects a valid event function as the second parameter");
+
+  try {
+    AutoscaleParams params(Local<Object>::Cast(info[0]));
+    Local<Function> eventFn;
+    if (info.Length() > 1)
+      eventFn = Local<Function>::Cast(info[1]);
+    Autoscaler::instance().configure(params, eventFn);
+  } catch (std::exception& err) {
+    return Nan::ThrowError(err.what());
+  }
+  info.GetReturnValue().SetUndefined();
+}
+
+NAN_METHOD(SchedulerStats) {
+  TaskScheduler &scheduler = TaskScheduler::instance();
+  Local<Object> stats = Nan::New<Object>();
+  Nan::Set(stats, Nan::New("threads").ToLocalChecked(), Nan::New(scheduler.numThreads()));
+  Nan::Set(stats, Nan::New("activeThreads").ToLocalChecked(), Nan::New(scheduler.activeThreads()));
+  Nan::Set(stats, Nan::New("tasksRun").ToLocalChecked(), Nan::New((double)scheduler.tasksRun()));
+  Nan::Set(stats, Nan::New("tasksStolen").ToLocalChecked(), Nan::New((double)scheduler.tasksStolen()));
+  Local<Object> autoscaleStats = Nan::New<Object>();
+  Autoscaler::instance().addStats(autoscaleStats);
+  Nan::Set(stats, Nan::New("autoscale").ToLocalChecked(), autoscaleStats);
+  info.GetReturnValue().Set(stats);
+}
+
+NAN_METHOD(FramePoolStats) {
+  Local<Object> stats = Nan::New<Object>();
+  FramePool::instance().addStats(stats);
+  info.GetReturnValue().Set(stats);
+}
+
+NAN_METHOD(AllocFrame) {
+  if (info.Length() < 3)
+    return Nan::ThrowError("allocFrame expects format, width and height arguments");
+  std::string format = *Nan::Utf8String(info[0]);
+  uint32_t width = Nan::To<uint32_t>(info[1]).FromJust();
+  uint32_t height = Nan::To<uint32_t>(info[2]).FromJust();
+  bool hasAlpha = (info.Length() > 3) ? Nan::To<bool>(info[3]).FromJust() : false;
+  if (!width || !height)
+    return Nan::ThrowError("allocFrame requires non-zero width and height");
+
+  uint32_t numBytes = getFormatBytes(format, width, height, hasAlpha);
+  if (!numBytes)
+    return; // unsupported format error already thrown
+
+  size_t mapBytes = 0;
+  uint8_t *buf = frameAlloc(numBytes, mapBytes);
+  if (!buf)
+    return Nan::ThrowError("allocFrame failed to allocate buffer");
+  // zero-fill as Buffer.alloc does, also faulting in the pages before the first frame
+  memset(buf, 0, numBytes);
+  info.GetReturnValue().Set(Nan::NewBuffer((char *)buf, numBytes,
+    [](char *data, void *hint) { frameFree((uint8_t *)data, (size_t)(uintptr_t)hint); }, (void *)(uintptr_t)mapBytes).ToLocalChecked());
+}
+
+NAN_METHOD(SetHugePages) {
+  if (info.Length() != 1)
+    return Nan::ThrowError("setHugePages expects 1 argument");
+  std::string modeStr = *Nan::Utf8String(info[0]);
+  int mode = eHugePagesOff;
+  if (0 == modeStr.compare("transparent"))
+    mode = eHugePagesTransparent;
+  else if (0 == modeStr.compare("explicit"))
+    mode = eHugePagesExplicit;
+  else if (modeStr.compare("off")) {
+    std::string err = std::string("Unsupported huge page mode \'") + modeStr + "\'";
+    return Nan::ThrowError(err.c_str());
+  }
+#ifndef __linux__
+  if (eHugePagesOff != mode)
+    return Nan::ThrowError("Huge pages are not supported on this platform");
+#endif
+
+  hugePageState().mode = mode;
+  FramePool::instance().clear();
+  info.GetReturnValue().SetUndefined();
+}
+
+NAN_METHOD(SetMemoryBudget) {
+  if ((info.Length() != 1) || !info[0]->IsNumber())
+    return Nan::ThrowError("setMemoryBudget expects a number of bytes");
+  double budgetBytes = Nan::To<double>(info[0]).FromJust();
+  if (budgetBytes < 0.0)
+    return Nan::ThrowError("setMemoryBudget requires a budget of zero (unlimited) or more bytes");
+  MemoryGovernor::instance().setBudget((uint64_t)budgetBytes);
+  info.GetReturnValue().SetUndefined();
+}
+
+NAN_METHOD(MemoryStats) {
+  Local<Object> stats = Nan::New<Object>();
+  MemoryGovernor::instance().addStats(stats);
+  info.GetReturnValue().Set(stats);
+}
+
+NAN_METHOD(LoadDriver) {
+  if ((info.Length() != 1) || !info[0]->IsString())
+    return Nan::ThrowError("loadDriver expects the path of a driver library");
+  try {
+    uint32_t numDrivers = DriverRegistry::instance().loadLibrary(*Nan::Utf8String(info[0]));
+    info.GetReturnValue().Set(Nan::New(numDrivers));
+  } catch (std::exception& err) {
+    return Nan::ThrowError(err.what());
+  }
+}
+
+uint32_t beToLe32 (uint32_t be);
+
+// opens contexts ahead of the processors that will take them - arguments are the type, 'encoder',
+// 'decoder' or 'scaler', the source and destination tags, the number to keep idle, and for
+// encoders the duration and encode parameters
+NAN_METHOD(Prewarm) {
+  if ((info.Length() < 4) || !info[0]->IsString() || !info[1]->IsObject() || !info[2]->IsObject() || !info[3]->IsNumber())
+    return Nan::ThrowError("prewarm expects a type, source and destination tags and a count");
+  std::string type = *Nan::Utf8String(info[0]);
+  Local<Object> srcTags = Local<Object>::Cast(info[1]);
+  Local<Object> dstTags = Local<Object>::Cast(info[2]);
+  uint32_t count = Nan::To<uint32_t>(info[3]).FromJust();
+
+  uint32_t numIdle = 0;
+  if (0 == type.compare("encoder")) {
+    if ((info.Length() != 6) || !node::Buffer::HasInstance(info[4]) || (node::Buffer::Length(info[4]) < 8) || !info[5]->IsObject())
+      return Nan::ThrowError("prewarm of an encoder requires a duration buffer and encode parameters");
+    uint32_t *pDur = (uint32_t *)node::Buffer::Data(info[4]);
+    uint32_t durNum = beToLe32(*pDur++);
+    uint32_t durDen = beToLe32(*pDur);
+    numIdle = Encoder::prewarm(srcTags, dstTags, Duration(durNum, durDen), Local<Object>::Cast(info[5]), count);
+  } else if (0 == type.compare("decoder"))
+    numIdle = Decoder::prewarm(srcTags, dstTags, count);
+  else if (0 == type.compare("scaler"))
+    numIdle = ScaleConverterFF::prewarm(std::make_shared<EssenceInfo>(srcTags), std::make_shared<EssenceInfo>(dstTags), count);
+  else {
+    std::string err = std::string("Unsupported prewarm type \'") + type + "\'";
+    return Nan::ThrowError(err.c_str());
+  }
+  info.GetReturnValue().Set(Nan::New(numIdle));
+}
+
+NAN_METHOD(ContextPoolStats) {
+  Local<Object> stats = Nan::New<Object>();
+  Local<Object> encoderStats = Nan::New<Object>();
+  ContextPool<tWarmEncoder>::instance().addStats(encoderStats);
+  Nan::Set(stats, Nan::New("encoders").ToLocalChecked(), encoderStats);
+  Local<Object> decoderStats = Nan::New<Object>();
+  ContextPool<tWarmDecoder>::instance().addStats(decoderStats);
+  Nan::Set(stats, Nan::New("decoders").ToLocalChecked(), decoderStats);
+  Local<Object> scalerStats = Nan::New<Object>();
+  ContextPool<SwsContext>::instance().addStats(scalerStats);
+  Nan::Set(stats, Nan::New("scalers").ToLocalChecked(), scalerStats);
+  info.GetReturnValue().Set(stats);
+}
+
+NAN_METHOD(Drivers) {
+  Local<Array> drivers = Nan::New<Array>();
+  DriverRegistry::instance().addDrivers(drivers);
+  info.GetReturnValue().Set(drivers);
+}
+
+} // namespace streampunk
+
 NAN_MODULE_INIT(Init) {
   streampunk::Concater::Init(target);
   streampunk::Flipper::Init(target);
@@ -31,7 +210,32 @@ NAN_MODULE_INIT(Init) {
   streampunk::ScaleConverter::Init(target);
   streampunk::Decoder::Init(target);
   streampunk::Encoder::Init(target);
+  streampunk::AbrEncoder::Init(target);
   streampunk::Stamper::Init(target);
+  streampunk::BufferPool::Init(target);
+
+  Nan::Set(target, Nan::New("setAutoscale").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::SetAutoscale)).ToLocalChecked());
+  Nan::Set(target, Nan::New("schedulerStats").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::SchedulerStats)).ToLocalChecked());
+  Nan::Set(target, Nan::New("framePoolStats").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::FramePoolStats)).ToLocalChecked());
+  Nan::Set(target, Nan::New("allocFrame").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::AllocFrame)).ToLocalChecked());
+  Nan::Set(target, Nan::New("setHugePages").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::SetHugePages)).ToLocalChecked());
+  Nan::Set(target, Nan::New("setMemoryBudget").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::SetMemoryBudget)).ToLocalChecked());
+  Nan::Set(target, Nan::New("memoryStats").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::MemoryStats)).ToLocalChecked());
+  Nan::Set(target, Nan::New("loadDriver").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::LoadDriver)).ToLocalChecked());
+  Nan::Set(target, Nan::New("drivers").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::Drivers)).ToLocalChecked());
+  Nan::Set(target, Nan::New("prewarm").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::Prewarm)).ToLocalChecked());
+  Nan::Set(target, Nan::New("contextPoolStats").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(streampunk::ContextPoolStats)).ToLocalChecked());
 }
 
 NODE_MODULE(codecadon, Init)
@@ -17,18 +17,52 @@
 #define CODECDRIVER_H
 
 #include <memory>
+#include <vector>
+#include <cstdint>
 
 namespace streampunk {
 
 class Memory;
 
+// Describes an encoded packet so that packaging does not need to parse the bitstream -
+// timestamps and duration are in units of the encoder time base, and offset is the position of
+// the packet in the buffer that holds it, which is non-zero when packets are aggregated. qp is set
+// by encoders that report it, and fullness by the Encoder's model of its output buffer - each is
+// negative when not known
+struct tPacketInfo {
+  tPacketInfo() : numBytes(0), offset(0), pts(0), dts(0), duration(0), keyFrame(false), pictureType('?'), numSamples(0),
+                  qp(-1), fullness(-1.0f) {}
+  uint32_t numBytes;
+  uint32_t offset;
+  int64_t pts;
+  int64_t dts;
+  int64_t duration;
+  bool keyFrame;
+  char pictureType;
+  uint32_t numSamples;
+  int32_t qp;
+  float fullness;
+};
+
 class iEncoderDriver {
 public:
   virtual ~iEncoderDriver() {}
 
   virtual uint32_t bytesReq() const = 0;
   virtual std::string packingRequired() const = 0;
-  virtual void encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes) = 0;
+  // an encoder may return no packets for a frame, or several - the first is written into dstBuf
+  // when it fits, setting *pDstBytes, and the rest are appended to the empty dstBufs. dstBuf is
+  // empty when every packet is to be handed out in a buffer of its own. packetInfos describes
+  // every packet in output order, starting with any in dstBuf
+  virtual void encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                            std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) = 0;
+  // end of stream - appends the packets held back by the encoder, after which no more frames can be encoded
+  virtual void flush (std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) = 0;
+  // applies a new bitrate and GOP length between frames, returning false when the running encoder
+  // takes the change. An encoder that has to be restarted appends the packets it held back and
+  // returns true - the next frame then starts a new GOP
+  virtual bool reconfigure (uint32_t bitrate, uint32_t gopFrames,
+                            std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) = 0;
 };
 
 class iDecoderDriver {
@@ -36,7 +70,12 @@ public:
   virtual ~iDecoderDriver() {}
 
   virtual uint32_t bytesReq() const = 0;
-  virtual void decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes) = 0;
+  // a packet may decode to no pictures, or several - the first is copied into dstBuf, setting *pDstBytes,
+  // unless it can be handed out without a copy. Pictures not in dstBuf are appended to frameBufs in output order
+  virtual void decodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                            std::vector<std::shared_ptr<Memory> > &frameBufs) = 0;
+  // end of stream - appends the pictures held back by the decoder, which is then ready for a new stream
+  virtual void flush (std::vector<std::shared_ptr<Memory> > &dstBufs) = 0;
 };
 
 } // namespace streampunk
@@ -16,15 +16,70 @@
 #ifndef IPROCESS_H
 #define IPROCESS_H
 
+#include <nan.h>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <string>
+#include "Slab.h"
 
 namespace streampunk {
 
-typedef std::vector<std::pair<const uint8_t*, uint32_t> > tBufVec;
+class Memory;
 
-class iProcessData {
+typedef std::pair<const uint8_t*, uint32_t> tBuf;
+typedef std::vector<tBuf, SlabAllocator<tBuf> > tBufVec;
+
+// Process data is allocated from the processor's slab, with the Memory objects and persistent
+// handles it needs embedded so that a frame submission does not allocate from the heap.
+class iProcessData : public std::enable_shared_from_this<iProcessData> {
 public:
+  iProcessData() {}
   virtual ~iProcessData() {}
+
+  // references to the process data held by codecs through MyWorker::holdRef, and the bytes still
+  // reserved for the frame with the memory governor - shared by the JS and worker threads
+  struct tHoldState {
+    tHoldState() : holds(0), reservedBytes(0) {}
+    std::atomic<uint32_t> holds;
+    std::atomic<uint64_t> reservedBytes;
+  };
+  tHoldState &holdState() { return mHoldState; }
+
+  // bytes of frame memory kept alive by the process data while it is in flight
+  virtual uint64_t numBytes() const = 0;
+
+  // memory holding the results when a process hands out its own buffers rather than writing
+  // into the destination buffer - passed back to JS as an array of external Buffers
+  virtual std::vector<std::shared_ptr<Memory> > resultBufs() const { return std::vector<std::shared_ptr<Memory> >(); }
+
+  // description of the result passed back to JS alongside it - called on the JS thread
+  virtual v8::Local<v8::Value> resultInfo() const { return Nan::Undefined(); }
+
+  // an error processing the frame, set on the worker thread and passed back to JS as the
+  // callback's err, alongside any results made before it
+  void setError(const std::string &err) { mError = err; }
+  const std::string &error() const { return mError; }
+
+protected:
+  // a pointer to embedded memory that shares ownership of the process data
+  std::shared_ptr<Memory> share(Memory &mem) { return std::shared_ptr<Memory>(shared_from_this(), &mem); }
+
+private:
+  tHoldState mHoldState;
+  std::string mError;
+};
+
+// Queued behind the frames already submitted to drain the output a processor holds back at
+// the end of a stream
+class FlushProcessData : public iProcessData {
+public:
+  uint64_t numBytes() const { return 0; }
+  std::vector<std::shared_ptr<Memory> > resultBufs() const { return mBufs; }
+  std::vector<std::shared_ptr<Memory> > &bufs() { return mBufs; }
+
+private:
+  std::vector<std::shared_ptr<Memory> > mBufs;
 };
 
 class iProcess {
@@ -0,0 +1,91 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+var tap = require('tap');
+var codecadon = require('../../codecadon');
+const logLevel = 2;
+
+function make420PBuf(width, height) {
+  var buf = Buffer.alloc(width * height * 3 / 2);
+  buf.fill(0x10, 0, width * height);
+  buf.fill(0x80, width * height);
+  return buf;
+}
+
+function makeTags(width, height, packing, encodingName, interlace) {
+  let tags = {};
+  tags.format = 'video';
+  tags.width = width;
+  tags.height = height;
+  tags.packing = packing;
+  tags.encodingName = encodingName;
+  tags.interlace = interlace;
+  return tags;
+}
+
+var duration = Buffer.alloc(8);
+duration.writeUIntBE(1, 0, 4);
+duration.writeUIntBE(25, 4, 4);
+
+function abrEncodeTest(description, numTests, onErr, fn) {
+  tap.test(description, t => {
+    t.plan(numTests + 1);
+    var encoder = new codecadon.AbrEncoder(() => {});
+    encoder.on('error', err => {
+      onErr(t, err);
+    });
+
+    fn(t, encoder, () => {
+      encoder.quit(() => {
+        t.pass(`${description} exited`);
+        t.end();
+      });
+    });
+  });
+}
+
+tap.plan(2, 'AbrEncoder addon tests');
+
+abrEncodeTest('Handling a bad rendition codec', 1,
+  (t, err) => t.ok(err, 'emits error'), 
+  (t, encoder, done) => {
+    var srcTags = makeTags(1280, 720, '420P', 'raw', 0);
+    var renditions = [ { width: 640, height: 360, encodingName: 'mpeg2' } ];
+    encoder.setInfo(srcTags, renditions, duration, {}, logLevel);
+    done();
+  });
+
+abrEncodeTest('Encoding a ladder from a single source', 5,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcTags = makeTags(1280, 720, '420P', 'raw', 0);
+    var renditions = [
+      { width: 320, height: 180, encodingName: 'h264', bitrate: 400000 },
+      { width: 1280, height: 720, encodingName: 'h264', bitrate: 3000000 },
+      { width: 640, height: 360, encodingName: 'h264', bitrate: 1000000 }
+    ];
+    var numRenditions = encoder.setInfo(srcTags, renditions, duration, { gopFrames: 25 }, logLevel);
+    t.equal(numRenditions, 3, 'returns the number of renditions');
+
+    var stats = encoder.stats().renditions;
+    t.deepEqual(stats.map(r => r.scaleFrom), [ 2, -1, 1 ], 'each rendition is scaled from the next larger');
+
+    encoder.encode([make420PBuf(1280, 720)], (err, packets, packetInfos) => {
+      t.notOk(err, 'no error expected');
+      t.equal(packetInfos.length, packets.length, 'returns info for each packet');
+      t.ok(packetInfos.every((info, i) => info.bytes === packets[i].length), 'packet info matches each packet');
+      done();
+    });
+  });
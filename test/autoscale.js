@@ -0,0 +1,102 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+var tap = require('tap');
+var codecadon = require('../../codecadon');
+const logLevel = 2;
+
+function makeTags(width, height, packing, interlace) {
+  let tags = {};
+  tags.format = 'video';
+  tags.width = width;
+  tags.height = height;
+  tags.packing = packing;
+  tags.interlace = interlace;
+  return tags;
+}
+
+function makePacker(width, height) {
+  var packer = new codecadon.Packer(() => {});
+  var dstBufLen = packer.setInfo(makeTags(width, height, 'pgroup', 0), makeTags(width, height, '420P', 0), logLevel);
+  packer.srcBuf = Buffer.alloc(width * height * 5 / 2);
+  packer.dstBuf = Buffer.alloc(dstBufLen);
+  return packer;
+}
+
+var scheduler = codecadon.scheduler;
+var numThreads = scheduler.stats().threads;
+
+tap.test('Scaling down when frames do not wait', { skip: numThreads < 1 }, (t) => {
+  var events = [];
+  var onScale = evt => events.push(evt);
+  scheduler.on('scale', onScale);
+  // all threads are active while autoscaling is off
+  scheduler.setAutoscale({ enabled: false });
+  scheduler.setAutoscale({ min: 0, lowWaitMs: 2, highWaitMs: 10, maxCpu: 100, intervalMs: 1 });
+  t.equal(scheduler.stats().activeThreads, numThreads, 'starts with all threads active');
+
+  // each frame is sent once the last has completed, so none waits in the queue
+  var packer = makePacker(1280, 720);
+  var sendFrame = count => {
+    packer.pack([packer.srcBuf], packer.dstBuf, err => {
+      t.notOk(err, 'no error expected');
+      if ((count > 1) && (0 === events.length))
+        return setTimeout(() => sendFrame(count - 1), 5);
+
+      t.ok(events.length > 0, 'a scale event is emitted');
+      if (events.length > 0) {
+        t.equal(events[0].reason, 'idle', 'scaled for idle threads');
+        t.equal(events[0].to, events[0].from - 1, 'one thread is deactivated');
+        t.equal(scheduler.stats().activeThreads, events[0].to, 'active thread count is changed');
+      }
+      scheduler.removeListener('scale', onScale);
+      scheduler.setAutoscale({ enabled: false });
+      packer.quit(() => t.end());
+    });
+  };
+  sendFrame(20);
+});
+
+tap.test('Scaling up when frames wait in the queue', { skip: numThreads < 2 }, (t) => {
+  var events = [];
+  var onScale = evt => events.push(evt);
+  scheduler.on('scale', onScale);
+  // start from a single active thread, then allow all of them
+  scheduler.setAutoscale({ min: 0, max: 1, lowWaitMs: 0, highWaitMs: 1, maxCpu: 100, intervalMs: 1 });
+  scheduler.setAutoscale({ min: 0, lowWaitMs: 0, highWaitMs: 1, maxCpu: 100, intervalMs: 1 });
+  t.equal(scheduler.stats().activeThreads, 1, 'starts with one thread active');
+
+  // frames sent all at once queue behind each other
+  var packer = makePacker(1920, 1080);
+  var numFrames = 30;
+  var numDone = 0;
+  for (var i = 0; i < numFrames; ++i) {
+    packer.pack([packer.srcBuf], packer.dstBuf, err => {
+      t.notOk(err, 'no error expected');
+      if (++numDone < numFrames)
+        return;
+
+      t.ok(events.length > 0, 'a scale event is emitted');
+      if (events.length > 0) {
+        t.equal(events[0].reason, 'queueWait', 'scaled for queue wait');
+        t.equal(events[0].to, events[0].from + 1, 'one thread is activated');
+        t.ok(events[0].queueWaitMs > 1, 'queue wait exceeds the high threshold');
+      }
+      scheduler.removeListener('scale', onScale);
+      scheduler.setAutoscale({ enabled: false });
+      packer.quit(() => t.end());
+    });
+  }
+});
@@ -0,0 +1,49 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+var tap = require('tap');
+var codecadon = require('../../codecadon');
+
+tap.test('Creating a buffer pool with an unsupported format', (t) => {
+  t.throws(() => new codecadon.BufferPool('fred', 1920, 1080, 2), 'throws an error');
+  t.end();
+});
+
+tap.test('Acquiring and releasing pool buffers', (t) => {
+  var width = 1920;
+  var height = 1080;
+  var pool = new codecadon.BufferPool('420P', width, height, 2);
+  var bufA = pool.acquire();
+  var bufB = pool.acquire();
+  t.equal(bufA.length, width * height * 3 / 2, 'buffer size matches the format');
+  t.equal(pool.stats().outstanding, 2, 'two buffers outstanding');
+
+  var bufC = pool.acquire();
+  t.equal(pool.stats().size, 3, 'pool grows when empty');
+  t.equal(pool.stats().grown, 1, 'growth is counted');
+
+  pool.release(bufA);
+  t.equal(bufA.length, 0, 'a released buffer no longer aliases its slot');
+  pool.release(bufB);
+  t.throws(() => pool.release(bufB), 'releasing a buffer twice throws an error');
+  t.throws(() => pool.release(Buffer.alloc(16)), 'releasing a foreign buffer throws an error');
+
+  var stats = pool.stats();
+  t.equal(stats.outstanding, 1, 'one buffer outstanding');
+  t.equal(stats.peak, 3, 'peak outstanding is recorded');
+  t.equal(stats.released, 2, 'releases are counted');
+  pool.release(bufC);
+  t.end();
+});
@@ -0,0 +1,104 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+var tap = require('tap');
+var codecadon = require('../../codecadon');
+const logLevel = 2;
+
+function make420PBuf(width, height) {
+  var buf = Buffer.alloc(width * height * 3 / 2, 0x80);
+  buf.fill(0x10, 0, width * height);
+  return buf;
+}
+
+function makeTags(width, height, packing, encodingName) {
+  return { format: 'video', width: width, height: height, packing: packing, encodingName: encodingName, interlace: 0 };
+}
+
+var duration = Buffer.alloc(8);
+duration.writeUIntBE(1, 0, 4);
+duration.writeUIntBE(25, 4, 4);
+
+// h264 packets for the decoders to decode
+function encodePackets(width, height, numFrames, cb) {
+  var encoder = new codecadon.Encoder(() => {});
+  var dstBufLen = encoder.setInfo(makeTags(width, height, '420P', 'raw'), makeTags(width, height, 'h264', 'h264'),
+                                  duration, {}, logLevel);
+  var packets = [];
+  for (var f = 0; f < numFrames; ++f)
+    encoder.encode([make420PBuf(width, height)], Buffer.alloc(dstBufLen), (err, result, packetInfo, p) => {
+      packets = packets.concat(p ? p : []);
+    });
+  encoder.flush((err, p) => {
+    packets = packets.concat(p);
+    encoder.quit(() => cb(err, packets));
+  });
+}
+
+// decodes the packets, then flushes if asked, and quits
+function decodeAndQuit(t, width, height, packets, flush, cb) {
+  var decoder = new codecadon.Decoder(() => {});
+  decoder.on('error', err => t.notOk(err, 'no error expected'));
+  var dstBufLen = decoder.setInfo(makeTags(width, height, 'h264', 'h264'), makeTags(width, height, '420P', 'raw'), logLevel);
+  packets.forEach(packet => decoder.decode([packet], Buffer.alloc(dstBufLen), () => {}));
+  if (flush)
+    decoder.flush(() => decoder.quit(cb));
+  else
+    decoder.quit(cb);
+}
+
+// sets up a decoder like the one before, reporting whether it took that one's decoder
+function takeDecoder(width, height, cb) {
+  var hits = codecadon.contextPoolStats().decoders.hits;
+  var decoder = new codecadon.Decoder(() => {});
+  decoder.setInfo(makeTags(width, height, 'h264', 'h264'), makeTags(width, height, '420P', 'raw'), logLevel);
+  var warmStart = decoder.stats().warmStart;
+  var took = codecadon.contextPoolStats().decoders.hits === hits + 1;
+  decoder.quit(() => cb(warmStart, took));
+}
+
+tap.test('Giving back a decoder after flush and quit', t => {
+  encodePackets(320, 240, 5, (err, packets) => {
+    t.notOk(err, 'no error expected');
+    t.ok(packets.length > 0, 'packets to decode');
+    decodeAndQuit(t, 320, 240, packets, true, () => {
+      takeDecoder(320, 240, (warmStart, took) => {
+        t.ok(warmStart, 'next decoder reports a warm start');
+        t.ok(took, 'next decoder takes the one given back');
+        t.end();
+      });
+    });
+  });
+});
+
+tap.test('Giving back an unused decoder on quit', t => {
+  decodeAndQuit(t, 352, 288, [], false, () => {
+    takeDecoder(352, 288, (warmStart, took) => {
+      t.ok(warmStart && took, 'next decoder takes the one given back');
+      t.end();
+    });
+  });
+});
+
+tap.test('Keeping a decoder quit part way through a stream', t => {
+  encodePackets(640, 360, 5, (err, packets) => {
+    t.notOk(err, 'no error expected');
+    decodeAndQuit(t, 640, 360, packets, false, () => {
+      takeDecoder(640, 360, (warmStart, took) => {
+        t.notOk(warmStart || took, 'next decoder opens its own');
+        t.end();
+      });
+    });
+  });
+});
@@ -0,0 +1,89 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// A minimal driver library for the driver tests, built against the codecadon headers as an
+// in-house driver would be. It registers an encoder for the codec 'testcodec' whose packet for
+// each frame is the frame number followed by the first bytes of the picture.
+
+#include <cstring>
+#include <algorithm>
+#include "DriverRegistry.h"
+#include "Memory.h"
+
+#ifdef _WIN32
+#define DRIVER_EXPORT extern "C" __declspec(dllexport)
+#else
+#define DRIVER_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace streampunk {
+
+class EncoderTest : public iEncoderDriver {
+public:
+  static const uint32_t kPacketBytes = 16;
+
+  uint32_t bytesReq() const  { return kPacketBytes; }
+  std::string packingRequired() const  { return "420P"; }
+
+  void encodeFrame (std::shared_ptr<Memory> srcBuf, std::shared_ptr<Memory> dstBuf, uint32_t frameNum, uint32_t *pDstBytes,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+    uint8_t packet[kPacketBytes];
+    memset(packet, 0, kPacketBytes);
+    for (uint32_t i = 0; i < 4; ++i)
+      packet[i] = (uint8_t)(frameNum >> (i * 8));
+    memcpy(packet + 4, srcBuf->buf(), std::min<uint32_t>(kPacketBytes - 4, srcBuf->numBytes()));
+
+    if (dstBuf && (dstBuf->numBytes() >= kPacketBytes)) {
+      memcpy(dstBuf->buf(), packet, kPacketBytes);
+      *pDstBytes = kPacketBytes;
+    } else {
+      std::shared_ptr<Memory> packetBuf = Memory::makeNew(kPacketBytes);
+      memcpy(packetBuf->buf(), packet, kPacketBytes);
+      dstBufs.push_back(packetBuf);
+    }
+
+    tPacketInfo packetInfo;
+    packetInfo.numBytes = kPacketBytes;
+    packetInfo.pts = frameNum;
+    packetInfo.dts = frameNum;
+    packetInfo.duration = 1;
+    packetInfo.keyFrame = true;
+    packetInfo.pictureType = 'I';
+    packetInfos.push_back(packetInfo);
+  }
+
+  void flush (std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {}
+
+  bool reconfigure (uint32_t bitrate, uint32_t gopFrames,
+                    std::vector<std::shared_ptr<Memory> > &dstBufs, std::vector<tPacketInfo> &packetInfos) {
+    return false;
+  }
+};
+
+} // namespace streampunk
+
+using namespace streampunk;
+
+DRIVER_EXPORT uint32_t codecadonDriverApiVersion() {
+  return CODECADON_DRIVER_API_VERSION;
+}
+
+DRIVER_EXPORT void codecadonRegisterDrivers(DriverRegistry *registry) {
+  registry->registerEncoder("test", "testcodec", 0,
+    [](std::shared_ptr<EssenceInfo> srcInfo, std::shared_ptr<EssenceInfo> dstInfo, const Duration& duration,
+       std::shared_ptr<EncodeParams> encodeParams) {
+      return std::make_shared<EncoderTest>();
+    });
+}
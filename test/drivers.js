@@ -0,0 +1,64 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+var tap = require('tap');
+var codecadon = require('../../codecadon');
+
+tap.test('Listing the built in drivers', (t) => {
+  var drivers = codecadon.drivers();
+  var find = (type, codec) => drivers.find(d => (d.type === type) && (d.codec === codec));
+  t.ok(find('encoder', 'h264') && (find('encoder', 'h264').name === 'ffmpeg'), 'ffmpeg h264 encoder is registered');
+  t.ok(find('decoder', 'vp8'), 'vp8 decoder is registered');
+  t.notOk(find('encoder', 'AVCi50'), 'no AVCi encoder is registered');
+  t.end();
+});
+
+tap.test('Loading an invalid driver library', (t) => {
+  var numDrivers = codecadon.drivers().length;
+  t.throws(() => codecadon.loadDriver('/no/such/driver.so'), 'throws an error');
+  t.throws(() => codecadon.loadDriver(), 'throws an error without a path');
+  t.equal(codecadon.drivers().length, numDrivers, 'no drivers are registered');
+  t.end();
+});
+
+var testDriverPath = require('path').join(__dirname, '../build/Release/testDriver.node');
+
+tap.test('Encoding through a loaded driver library', (t) => {
+  t.equal(codecadon.loadDriver(testDriverPath), 1, 'registers one driver');
+  var driver = codecadon.drivers().find(d => (d.type === 'encoder') && (d.codec === 'testcodec'));
+  t.ok(driver && (driver.name === 'test') && (driver.library === testDriverPath), 'lists the driver with its library');
+  t.throws(() => codecadon.loadDriver(testDriverPath), 'throws an error when loaded again');
+
+  var width = 64;
+  var height = 32;
+  var tags = (packing, encodingName) => ({ format: 'video', width: width, height: height, packing: packing, encodingName: encodingName, interlace: 0 });
+  var duration = Buffer.alloc(8);
+  duration.writeUIntBE(1, 0, 4);
+  duration.writeUIntBE(25, 4, 4);
+
+  var encoder = new codecadon.Encoder(() => {});
+  encoder.on('error', err => t.notOk(err, 'no error expected'));
+  var dstBufLen = encoder.setInfo(tags('420P', 'raw'), tags('testcodec', 'testcodec'), duration, {}, 2);
+  t.equal(dstBufLen, 16, 'uses the driver\'s packet size');
+  t.equal(encoder.stats().driver, 'test', 'encodes with the loaded driver');
+
+  var srcBuf = Buffer.alloc(width * height * 3 / 2, 0x10);
+  encoder.encode([ srcBuf ], Buffer.alloc(dstBufLen), (err, result, packetInfo) => {
+    t.notOk(err, 'no error expected');
+    t.ok(result && (result.length === 16), 'returns the driver\'s packet');
+    t.ok(result && (result.readUInt32LE(0) === 0) && (result[4] === 0x10), 'packet holds the frame number and picture bytes');
+    t.ok(packetInfo && packetInfo.key, 'packet is a key frame');
+    encoder.quit(() => t.end());
+  });
+});
@@ -141,7 +141,7 @@ function encodeTest(description, numTests, onErr, fn) {
   });
 }
 
-tap.plan(7, 'Encoder addon tests');
+tap.plan(18, 'Encoder addon tests');
 
 encodeTest('Handling bad image dimensions', 1,
   (t, err) => t.ok(err, 'emits error'), 
@@ -163,6 +163,16 @@ encodeTest('Handling bad image format', 1,
     done();
   });
 
+encodeTest('Handling a bad encode thread type', 1,
+  (t, err) => t.ok(err, 'emits error'), 
+  (t, encoder, done) => {
+    var srcTags = makeTags(1280, 720, '420P', 'raw', 0);
+    var dstTags = makeTags(1280, 720, 'h264', 'h264', 0);
+    var encodeTags = { threadType: 'pipeline' };
+    encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    done();
+  });
+
 encodeTest('Starting up an encoder', 1,
   (t, err) => t.notOk(err, 'no error expected'), 
   (t, encoder, done) => {
@@ -177,7 +187,7 @@ encodeTest('Starting up an encoder', 1,
     done();
   });
 
-encodeTest('Performing h264 encoding', 1,
+encodeTest('Performing h264 encoding', 3,
   (t, err) => t.notOk(err, 'no error expected'), 
   (t, encoder, done) => {
     var srcWidth = 1920;
@@ -193,8 +203,13 @@ encodeTest('Performing h264 encoding', 1,
     bufArray[0] = make420PBuf(srcWidth, srcHeight);
     var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
     var dstBuf = Buffer.alloc(dstBufLen);
-    encoder.encode(bufArray, dstBuf, (err/*, result*/) => {
+    encoder.encode(bufArray, dstBuf, (err, result, packetInfo, packets, packetInfos) => {
       t.notOk(err, 'no error expected');
+      t.equal(packetInfos.length, packets.length, 'encode returns info for each packet');
+      if (result)
+        t.ok(packetInfo.key && ('I' === packetInfo.pictureType), 'first packet is a key frame');
+      else
+        t.equal(packetInfo, null, 'no packet info without a packet');
       // todo: check for valid bitstream...
       done();
     });
@@ -289,3 +304,246 @@ encodeTest('Handling an undefined destination buffer', 1,
       done();
     });
   });
+
+encodeTest('Flushing an h264 encoder', 4,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 1280;
+    var srcHeight = 720;
+    var srcTags = makeTags(srcWidth, srcHeight, '420P', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'h264', 'h264', 0);
+    var encodeTags = {};
+    var bufArray = new Array(1); 
+    bufArray[0] = make420PBuf(srcWidth, srcHeight);
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    var dstBuf = Buffer.alloc(dstBufLen);
+    encoder.encode(bufArray, dstBuf, (/*err, result*/) => {});
+    encoder.flush((err, packets, packetInfos) => {
+      t.notOk(err, 'no error expected');
+      t.ok(Array.isArray(packets), 'flush returns an array of packets');
+      t.equal(packetInfos.length, packets.length, 'flush returns info for each packet');
+      encoder.encode(bufArray, dstBuf, err => {
+        t.ok(err, 'encode after flush should return error');
+        done();
+      });
+    });
+  });
+
+encodeTest('Aggregating h264 packets into GOPs', 3,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 1280;
+    var srcHeight = 720;
+    var srcTags = makeTags(srcWidth, srcHeight, '420P', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'h264', 'h264', 0);
+    var encodeTags = { gopFrames: 2, output: 'gop' };
+    var bufArray = new Array(1); 
+    bufArray[0] = make420PBuf(srcWidth, srcHeight);
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    var dstBuf = Buffer.alloc(dstBufLen);
+    var gops = [];
+    var gopInfos = [];
+    var collect = (g, i) => { gops = gops.concat(g); gopInfos = gopInfos.concat(i); };
+    for (var f = 0; f < 5; ++f)
+      encoder.encode(bufArray, dstBuf, (err, g, i) => collect(g, i));
+    encoder.flush((err, g, i) => {
+      t.notOk(err, 'no error expected');
+      collect(g, i);
+      t.ok(gops.every((gop, n) => gop.length === gopInfos[n].reduce((bytes, info) => {
+        return (info.offset === bytes) ? bytes + info.bytes : -1;
+      }, 0)), 'packets are contiguous in each GOP');
+      t.ok(gopInfos.every(infos => infos[0].key), 'each GOP starts with a key frame');
+      done();
+    });
+  });
+
+encodeTest('Re-framing 1ms L16 packets for AAC encoding', 3,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcTags = { format: 'audio', encodingName: 'L16', clockRate: 48000, channels: 2 };
+    var dstTags = { format: 'audio', encodingName: 'AAC', clockRate: 48000, channels: 2 };
+    var encodeTags = {};
+    var bufArray = [ Buffer.alloc(48 * 2 * 2) ];
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    var dstBuf = Buffer.alloc(dstBufLen);
+    var packetInfos = [];
+    var numSamples = 0;
+    for (var p = 0; p < 100; ++p) {
+      numSamples += 48;
+      encoder.encode(bufArray, dstBuf, (err, result, packetInfo, packets, infos) => {
+        packetInfos = packetInfos.concat(infos ? infos : []);
+      });
+    }
+    encoder.flush((err, packets, infos) => {
+      t.notOk(err, 'no error expected');
+      packetInfos = packetInfos.concat(infos);
+      t.ok(packetInfos.reduce((samples, info) => samples + info.samples, 0) >= numSamples, 'every sample is encoded');
+      t.ok(packetInfos.every((info, n) => !n || (info.pts > packetInfos[n-1].pts)), 'packet timestamps increase');
+      done();
+    });
+  });
+
+encodeTest('Handling audio that is not a whole number of samples', 1,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcTags = { format: 'audio', encodingName: 'L16', clockRate: 48000, channels: 2 };
+    var dstTags = { format: 'audio', encodingName: 'AAC', clockRate: 48000, channels: 2 };
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, {}, logLevel);
+    // an odd number of bytes is not a whole number of 16 bit stereo samples
+    encoder.encode([ Buffer.alloc(48 * 2 * 2 + 1) ], Buffer.alloc(dstBufLen), err => {
+      t.ok(err, 'returns an encode error');
+      done();
+    });
+  });
+
+encodeTest('Reconfiguring a running h264 encoder', 5,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 1280;
+    var srcHeight = 720;
+    var srcTags = makeTags(srcWidth, srcHeight, '420P', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'h264', 'h264', 0);
+    var encodeTags = { bitrate: 4000000 };
+    var bufArray = new Array(1); 
+    bufArray[0] = make420PBuf(srcWidth, srcHeight);
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    var dstBuf = Buffer.alloc(dstBufLen);
+    encoder.encode(bufArray, dstBuf, () => {});
+    encoder.reconfigure({ bitrate: 1000000, gopFrames: 25 }, err => {
+      t.notOk(err, 'no error expected');
+    });
+    encoder.encode(bufArray, dstBuf, (err, result, packetInfo, packets, packetInfos) => {
+      t.notOk(err, 'no error expected');
+      t.ok(packetInfos.every(info => typeof info.fullness === 'number'), 'packets report buffer fullness');
+      var stats = encoder.stats();
+      t.equal(stats.encode.bitrate, 1000000, 'new bitrate is reported');
+      t.equal(stats.reconfigures + stats.restarts, 1, 'reconfiguration is counted');
+      done();
+    });
+  });
+
+encodeTest('Handling a failed reconfigure', 3,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 640;
+    var srcHeight = 360;
+    var srcTags = makeTags(srcWidth, srcHeight, '420P', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'vp8', 'vp8', 0);
+    var bufArray = new Array(1); 
+    bufArray[0] = make420PBuf(srcWidth, srcHeight);
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, { mode: 'file', pass: 1, gopFrames: 50 }, logLevel);
+    var dstBuf = Buffer.alloc(dstBufLen);
+    encoder.reconfigure({ bitrate: [ 'fast' ] }, err => {
+      t.ok(err, 'a bitrate that is not a number is an error');
+    });
+    encoder.encode(bufArray, dstBuf, () => {});
+    // a two-pass encode cannot restart for a new GOP length
+    encoder.reconfigure({ gopFrames: 25 }, err => {
+      t.ok(err, 'returns the encoder error');
+      t.equal(encoder.stats().encode.gopFrames, 50, 'GOP length is unchanged');
+      done();
+    });
+  });
+
+encodeTest('Returning h264 packets in external buffers', 3,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 1280;
+    var srcHeight = 720;
+    var srcTags = makeTags(srcWidth, srcHeight, '420P', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'h264', 'h264', 0);
+    var encodeTags = { output: 'external' };
+    var bufArray = new Array(1); 
+    bufArray[0] = make420PBuf(srcWidth, srcHeight);
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    t.equal(dstBufLen, 0, 'no destination buffer is required');
+    var packets = [];
+    var packetInfos = [];
+    for (var f = 0; f < 3; ++f)
+      encoder.encode(bufArray, null, (err, result, packetInfo, p, i) => {
+        packets = packets.concat(p);
+        packetInfos = packetInfos.concat(i);
+      });
+    encoder.flush((err, p, i) => {
+      t.notOk(err, 'no error expected');
+      packets = packets.concat(p);
+      packetInfos = packetInfos.concat(i);
+      t.ok((packets.length > 0) && packets.every((packet, n) => packet.length === packetInfos[n].bytes),
+        'each packet is sized to its data');
+      done();
+    });
+  });
+
+encodeTest('Two-pass vp8 file encoding', 4,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 640;
+    var srcHeight = 360;
+    var srcTags = makeTags(srcWidth, srcHeight, '420P', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'vp8', 'vp8', 0);
+    var bufArray = new Array(1); 
+    bufArray[0] = make420PBuf(srcWidth, srcHeight);
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, { mode: 'file', pass: 1 }, logLevel);
+    var dstBuf = Buffer.alloc(dstBufLen);
+    for (var f = 0; f < 5; ++f)
+      encoder.encode(bufArray, dstBuf, () => {});
+    encoder.flush(err => {
+      t.notOk(err, 'no error expected');
+      var passStats = encoder.firstPassStats();
+      t.ok(passStats && (passStats.length > 0), 'first pass returns its analysis');
+      var encoder2 = new codecadon.Encoder(() => {});
+      encoder2.setInfo(srcTags, dstTags, duration, { mode: 'file', pass: 2, passStats: passStats }, logLevel);
+      var packets = [];
+      for (var f = 0; f < 5; ++f)
+        encoder2.encode(bufArray, dstBuf, (err, result, packetInfo, p) => { packets = packets.concat(p); });
+      encoder2.flush((err, p) => {
+        t.notOk(err, 'no error expected');
+        packets = packets.concat(p);
+        t.ok(packets.length > 0, 'second pass returns packets');
+        encoder2.quit(done);
+      });
+    });
+  });
+
+encodeTest('Taking a prewarmed h264 encoder', 4,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 1280;
+    var srcHeight = 720;
+    var srcTags = makeTags(srcWidth, srcHeight, '420P', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'h264', 'h264', 0);
+    var encodeTags = { bitrate: 3000000, gopFrames: 30 };
+    var bufArray = new Array(1); 
+    bufArray[0] = make420PBuf(srcWidth, srcHeight);
+    t.ok(codecadon.prewarm('encoder', srcTags, dstTags, 1, duration, encodeTags) >= 1, 'an encoder is idle');
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    t.ok(encoder.stats().warmStart, 'setInfo takes the prewarmed encoder');
+    var dstBuf = Buffer.alloc(dstBufLen);
+    encoder.encode(bufArray, dstBuf, (err, result) => {
+      t.notOk(err, 'no error expected');
+      t.ok(result && (result.length > 0), 'prewarmed encoder returns a packet');
+      done();
+    });
+  });
+
+encodeTest('Performing VC-2 encoding from a YUV422P10 source', 3,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, encoder, done) => {
+    var srcWidth = 1920;
+    var srcHeight = 1080;
+    var srcTags = makeTags(srcWidth, srcHeight, 'YUV422P10', 'raw', 0);
+    var dstTags = makeTags(srcWidth, srcHeight, 'vc2', 'vc2', 0);
+    var encodeTags = { bitrate: 500000000 };
+    var lumaBytes = srcWidth * srcHeight * 2;
+    var bufArray = [ Buffer.alloc(lumaBytes * 2) ];
+    bufArray[0].fill(Buffer.from([0x40, 0x00]), 0, lumaBytes);
+    bufArray[0].fill(Buffer.from([0x00, 0x02]), lumaBytes);
+    var dstBufLen = encoder.setInfo(srcTags, dstTags, duration, encodeTags, logLevel);
+    var dstBuf = Buffer.alloc(dstBufLen);
+    encoder.encode(bufArray, dstBuf, (err, result, packetInfo) => {
+      t.notOk(err, 'no error expected');
+      t.ok(result && (result.length > 0), 'each frame returns a packet');
+      t.equal(encoder.stats().driver, 'ffmpeg-vc2', 'VC-2 driver is chosen');
+      done();
+    });
+  });
@@ -0,0 +1,58 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+var tap = require('tap');
+var codecadon = require('../../codecadon');
+const logLevel = 2;
+
+function makeTags(width, height, packing, interlace) {
+  let tags = {};
+  tags.format = 'video';
+  tags.width = width;
+  tags.height = height;
+  tags.packing = packing;
+  tags.interlace = interlace;
+  return tags;
+}
+
+tap.test('Setting an invalid memory budget', (t) => {
+  t.throws(() => codecadon.setMemoryBudget(-1), 'throws an error');
+  t.throws(() => codecadon.setMemoryBudget('fred'), 'throws an error');
+  t.end();
+});
+
+tap.test('Refusing frames over the memory budget', (t) => {
+  var width = 1280;
+  var height = 720;
+  var packer = new codecadon.Packer(() => {});
+  var dstBufLen = packer.setInfo(makeTags(width, height, 'pgroup', 0), makeTags(width, height, '420P', 0), logLevel);
+  var srcBuf = Buffer.alloc(width * height * 5 / 2);
+  var dstBuf = Buffer.alloc(dstBufLen);
+
+  codecadon.setMemoryBudget(srcBuf.length + dstBuf.length + 1);
+  packer.pack([srcBuf], dstBuf, (err) => {
+    t.notOk(err, 'frame within budget is processed');
+    t.equal(packer.stats().bytesInFlight, 0, 'bytes are released once the frame completes');
+    t.equal(codecadon.memoryStats().inFlight, 0, 'global bytes are released once the frame completes');
+    codecadon.setMemoryBudget(0);
+    packer.quit(() => t.end());
+  });
+  t.equal(packer.stats().bytesInFlight, srcBuf.length + dstBuf.length, 'frame bytes are in flight');
+
+  packer.pack([srcBuf], Buffer.alloc(dstBufLen), (err) => {
+    t.ok(err, 'frame over budget is refused');
+    t.equal(packer.stats().refused, 1, 'refusal is counted');
+  });
+});
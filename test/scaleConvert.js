@@ -125,7 +125,7 @@ function scaleConvertTest(description, numTests, onErr, fn) {
   });
 }
 
-tap.plan(7, 'ScaleConverter addon tests');
+tap.plan(8, 'ScaleConverter addon tests');
 const paramTags = { scale:[1.0, 1.0], dstOffset:[0.0, 0.0] };
 
 scaleConvertTest('Handling bad image dimensions', 1,
@@ -247,3 +247,20 @@ scaleConvertTest('Handling insufficient destination bytes', 1,
       done();
     });
   });
+
+scaleConvertTest('Reusing a scaler context', 2,
+  (t, err) => t.notOk(err, 'no error expected'), 
+  (t, scaleConverter, done) => {
+    var srcTags = makeTags(640, 360, 'pgroup', 0);
+    var dstTags = makeTags(320, 180, 'YUV422P10', 0);
+    scaleConverter.setInfo(srcTags, dstTags, paramTags, logLevel);
+    var idle = codecadon.contextPoolStats().scalers.idle;
+    // setting up another conversion gives back the context of the first
+    scaleConverter.setInfo(srcTags, makeTags(640, 360, 'YUV422P10', 0), paramTags, logLevel);
+    t.equal(codecadon.contextPoolStats().scalers.idle, idle + 1, 'context is given back');
+    var hits = codecadon.contextPoolStats().scalers.hits;
+    var scaleConverter2 = new codecadon.ScaleConverter(() => {});
+    scaleConverter2.setInfo(srcTags, dstTags, paramTags, logLevel);
+    t.equal(codecadon.contextPoolStats().scalers.hits, hits + 1, 'a second scaler takes the context');
+    scaleConverter2.quit(done);
+  });
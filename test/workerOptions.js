@@ -0,0 +1,84 @@
+/* Copyright 2017 Streampunk Media Ltd.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+var tap = require('tap');
+var codecadon = require('../../codecadon');
+const logLevel = 2;
+
+function makeTags(width, height, packing, interlace) {
+  let tags = {};
+  tags.format = 'video';
+  tags.width = width;
+  tags.height = height;
+  tags.packing = packing;
+  tags.interlace = interlace;
+  return tags;
+}
+
+function makePacker() {
+  var width = 1280;
+  var height = 720;
+  var packer = new codecadon.Packer(() => {});
+  var dstBufLen = packer.setInfo(makeTags(width, height, 'pgroup', 0), makeTags(width, height, '420P', 0), logLevel);
+  packer.srcBuf = Buffer.alloc(width * height * 5 / 2);
+  packer.dstBuf = Buffer.alloc(dstBufLen);
+  return packer;
+}
+
+tap.test('Rejecting invalid worker options', (t) => {
+  var packer = makePacker();
+  var errors = [];
+  packer.on('error', err => errors.push(err));
+  packer.setWorkerOptions({ schedPolicy: 'fred' });
+  packer.setWorkerOptions({ schedPolicy: 'fifo', priority: 0 });
+  packer.setWorkerOptions({ nice: 40 });
+  packer.setWorkerOptions({ cpus: '3-1' });
+  packer.setWorkerOptions({ numaNode: 64 });
+  t.equal(errors.length, 5, 'each invalid option is an error');
+  t.equal(packer.stats().worker.status, 'default', 'options are unchanged');
+  packer.quit(() => t.end());
+});
+
+tap.test('Applying worker options before the next frame', (t) => {
+  var packer = makePacker();
+  packer.on('error', err => t.notOk(err, 'no error expected'));
+  packer.setWorkerOptions({ cpus: '0' });
+  t.equal(packer.stats().worker.status, 'pending', 'options wait for the next frame');
+  packer.pack([packer.srcBuf], packer.dstBuf, err => {
+    t.notOk(err, 'no error expected');
+    var worker = packer.stats().worker;
+    t.equal(worker.cpus, '0', 'cpu list is reported');
+    if (process.platform === 'linux')
+      t.equal(worker.status, 'applied', 'options are applied');
+    else
+      t.ok(worker.status.length > 0, 'status is reported');
+
+    packer.setWorkerOptions({});
+    packer.pack([packer.srcBuf], packer.dstBuf, err => {
+      t.notOk(err, 'no error expected');
+      t.equal(packer.stats().worker.status, 'default', 'default options restore the thread');
+      packer.quit(() => t.end());
+    });
+  });
+});
+
+tap.test('Releasing pooled memory when the NUMA node changes', (t) => {
+  var packer = makePacker();
+  packer.on('error', err => t.notOk(err, 'no error expected'));
+  packer.setWorkerOptions({ numaNode: 0 });
+  t.equal(codecadon.framePoolStats().free, 0, 'free frame buffers are released');
+  packer.setWorkerOptions({});
+  packer.quit(() => t.end());
+});